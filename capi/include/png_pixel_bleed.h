@@ -0,0 +1,118 @@
+#ifndef PNG_PIXEL_BLEED_H
+#define PNG_PIXEL_BLEED_H
+
+/*
+ * C ABI for embedding the bleeder in another process, e.g. an engine texture importer.
+ * The image is bled in place in caller memory, the library never copies it. The only extra memory is a scratch
+ * buffer of ppb_scratch_size bytes, which the caller may provide to keep the call free of allocations.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#    if defined(PPB_BUILDING_LIBRARY)
+#        define PPB_API __declspec(dllexport)
+#    else
+#        define PPB_API __declspec(dllimport)
+#    endif
+#else
+#    define PPB_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Raised with every addition to the ABI, ppb_version tells what the loaded library honors. Older libraries ignore
+ * flags they don't know and the fields past the struct_size they were built with, so check it before relying on one.
+ *   1  ppb_options up to flags, PPB_FLAG_OPTIMIZE_FOR_BLOCK_COMPRESSION
+ *   2  ppb_options.connectivity and ppb_options.tie_break
+ *   3  PPB_FLAG_TILED_TRAVERSAL
+ *   4  PPB_FLAG_FRONTIER_TRAVERSAL
+ *   5  PPB_FLAG_JUMP_FLOOD_TRAVERSAL, ppb_options_scratch_size
+ */
+#define PPB_VERSION 5u
+
+typedef enum ppb_pixel_format {
+    PPB_PIXEL_FORMAT_BGRA8 = 0, /* 4 x uint8_t, b g r a */
+    PPB_PIXEL_FORMAT_RGBA16 = 1, /* 4 x uint16_t, r g b a */
+    PPB_PIXEL_FORMAT_RGBA32F = 2, /* 4 x float, r g b a */
+} ppb_pixel_format;
+
+typedef enum ppb_result {
+    PPB_OK = 0,
+    PPB_ERROR_INVALID_ARGUMENT = 1,
+    PPB_ERROR_SCRATCH_TOO_SMALL = 2,
+    PPB_ERROR_OUT_OF_MEMORY = 3,
+} ppb_result;
+
+#define PPB_FLAG_OPTIMIZE_FOR_BLOCK_COMPRESSION 0x1u
+/* cache-blocked traversal, same result, faster on images whose rows don't fit in cache */
+#define PPB_FLAG_TILED_TRAVERSAL 0x2u
+/* visits only pixels next to the bled area, same result, much faster on mostly empty images but slower on dense ones,
+ * allocates memory in proportion to the opaque boundary even if scratch is given, wins over PPB_FLAG_TILED_TRAVERSAL */
+#define PPB_FLAG_FRONTIER_TRAVERSAL 0x4u
+/* approximate, colors every pixel from a nearby opaque pixel found by jump flooding with one correction pass, in a few
+ * parallel passes however wide the gaps, tie_break does not apply. Needs 8 bytes of scratch per pixel, allocated
+ * unless scratch holds ppb_options_scratch_size bytes, falls back to PPB_FLAG_FRONTIER_TRAVERSAL on images over 32767
+ * pixels wide or tall, wins over both */
+#define PPB_FLAG_JUMP_FLOOD_TRAVERSAL 0x8u
+
+typedef enum ppb_connectivity {
+    PPB_CONNECTIVITY_8 = 0, /* edge and corner neighbors */
+    PPB_CONNECTIVITY_4 = 1, /* edge neighbors only */
+} ppb_connectivity;
+
+/* how a pixel picks its color when several neighbors are sources in the same pass */
+typedef enum ppb_tie_break {
+    PPB_TIE_BREAK_FIRST_HIT = 0,
+    PPB_TIE_BREAK_AVERAGE = 1,
+    PPB_TIE_BREAK_MAX_ALPHA = 2,
+} ppb_tie_break;
+
+typedef struct ppb_image {
+    void* pixels;
+    uint32_t width;
+    uint32_t height;
+    size_t stride; /* bytes between rows, at least width * pixel size and a multiple of the channel size */
+    ppb_pixel_format format;
+} ppb_image;
+
+typedef struct ppb_options {
+    uint32_t struct_size; /* sizeof(ppb_options), lets later versions append fields */
+    float alpha_threshold; /* normalized to [0, 1], pixels at or below it take the color of the nearest opaque pixel */
+    uint32_t flags; /* PPB_FLAG_* */
+    ppb_connectivity connectivity;
+    ppb_tie_break tie_break;
+} ppb_options;
+
+/* PPB_VERSION of the loaded library, which may be older or newer than the header the caller was built with */
+PPB_API uint32_t ppb_version(void);
+
+PPB_API void ppb_default_options(ppb_options* options);
+
+/* bytes of scratch memory ppb_bleed needs for an image of this size with any options, aligned to 8 bytes,
+ * with PPB_FLAG_JUMP_FLOOD_TRAVERSAL it allocates the rest of ppb_options_scratch_size, 0 if the size overflows */
+PPB_API size_t ppb_scratch_size(uint32_t width, uint32_t height);
+
+/* bytes of scratch memory that keep ppb_bleed with these options (NULL for the defaults) free of allocations,
+ * at least ppb_scratch_size, 0 if the size overflows or options is invalid */
+PPB_API size_t ppb_options_scratch_size(uint32_t width, uint32_t height, ppb_options const* options);
+
+/*
+ * Bleeds image in place. options may be NULL for the defaults.
+ * scratch must be 8 byte aligned and hold ppb_scratch_size bytes, pass NULL to let the library allocate it.
+ * The whole scratch_size is used, ppb_options_scratch_size bytes avoid any allocation but the frontier's.
+ * Safe to call from several threads at once as long as images and scratch buffers don't overlap.
+ */
+PPB_API ppb_result ppb_bleed(ppb_image const* image, ppb_options const* options, void* scratch, size_t scratch_size);
+
+PPB_API char const* ppb_result_string(ppb_result result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,199 @@
+#include "png_pixel_bleed.h"
+#include <new>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include "image/Pixel.hpp"
+#include "image/ImageView.hpp"
+#include "image/PixelBleeding.hpp"
+#include "image/BlockCompression.hpp"
+
+namespace {
+    // PPB_FLAG_JUMP_FLOOD_TRAVERSAL wins over PPB_FLAG_FRONTIER_TRAVERSAL, which wins over PPB_FLAG_TILED_TRAVERSAL
+    image::BleedingTraversal traversalOf(uint32_t const flags) noexcept {
+        return (flags & PPB_FLAG_JUMP_FLOOD_TRAVERSAL) ? image::BleedingTraversal::JumpFlood
+            : (flags & PPB_FLAG_FRONTIER_TRAVERSAL) ? image::BleedingTraversal::Frontier
+            : (flags & PPB_FLAG_TILED_TRAVERSAL) ? image::BleedingTraversal::Tiled
+            : image::BleedingTraversal::RowMajor;
+    }
+
+    // options may be NULL for the defaults, callers built against an older header pass a shorter struct whose
+    // missing fields keep their defaults, returns false if options is too short to be any version of it
+    bool resolveOptions(ppb_options const* const options, ppb_options& resolved) noexcept {
+        ppb_default_options(&resolved);
+        if (!options) {
+            return true;
+        }
+        if (options->struct_size < offsetof(ppb_options, connectivity)) {
+            return false;
+        }
+        resolved.alpha_threshold = options->alpha_threshold;
+        resolved.flags = options->flags;
+        if (options->struct_size >= offsetof(ppb_options, tie_break) + sizeof(ppb_tie_break)) {
+            resolved.connectivity = options->connectivity;
+            resolved.tie_break = options->tie_break;
+        }
+        return true;
+    }
+
+    template <typename Pixel>
+    ppb_result bleed(ppb_image const& image, ppb_options const& options, std::span<uint64_t> const scratch) {
+        if (image.stride < static_cast<size_t>(image.width) * sizeof(Pixel)
+            || image.stride % alignof(Pixel) != 0
+            || reinterpret_cast<uintptr_t>(image.pixels) % alignof(Pixel) != 0) {
+            return PPB_ERROR_INVALID_ARGUMENT;
+        }
+        image::ImageView<Pixel> const view{image.pixels, image.width, image.height, image.stride};
+        image::BleedingKernel const kernel{
+            options.connectivity == PPB_CONNECTIVITY_4 ? image::BleedingConnectivity::Four : image::BleedingConnectivity::Eight,
+            options.tie_break == PPB_TIE_BREAK_AVERAGE ? image::BleedingTieBreak::Average
+                : options.tie_break == PPB_TIE_BREAK_MAX_ALPHA ? image::BleedingTieBreak::MaxAlpha
+                : image::BleedingTieBreak::FirstHit,
+            traversalOf(options.flags),
+        };
+        // ppb_scratch_size leaves out the seeds of the jump flood, which would multiply it for every other caller,
+        // they are only allocated if the caller's scratch is smaller than ppb_options_scratch_size
+        std::vector<uint64_t> seeds;
+        auto kernel_scratch = scratch;
+        if (auto const word_count = image::bleedingScratchWordCount(image.width, image.height, kernel.traversal); word_count > scratch.size()) {
+            seeds.resize(word_count);
+            kernel_scratch = seeds;
+        }
+        image::bleedPixels(view, options.alpha_threshold, kernel, kernel_scratch, std::stop_token{}, [](image::Rect const&, float) -> void {});
+        if (options.flags & PPB_FLAG_OPTIMIZE_FOR_BLOCK_COMPRESSION) {
+            image::optimizeForBlockCompression(view, options.alpha_threshold, nullptr);
+        }
+        return PPB_OK;
+    }
+
+    ppb_result bleed(ppb_image const& image, ppb_options const& options, std::span<uint64_t> const scratch) {
+        switch (image.format) {
+            case PPB_PIXEL_FORMAT_BGRA8:
+                return bleed<image::PixelBGRA8>(image, options, scratch);
+            case PPB_PIXEL_FORMAT_RGBA16:
+                return bleed<image::PixelRGBA16>(image, options, scratch);
+            case PPB_PIXEL_FORMAT_RGBA32F:
+                return bleed<image::PixelRGBA32F>(image, options, scratch);
+        }
+        return PPB_ERROR_INVALID_ARGUMENT;
+    }
+
+    // an image without an opaque pixel has nothing to bleed from, it is left as it is without needing scratch
+    template <typename Pixel>
+    bool hasOpaquePixel(ppb_image const& image, float const alpha_threshold) noexcept {
+        auto const cutoff = image::PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        image::ImageView<Pixel> const view{image.pixels, image.width, image.height, image.stride};
+        for (uint32_t y = 0; y < image.height; ++y) {
+            auto const row = view.row(y);
+            for (uint32_t x = 0; x < image.width; ++x) {
+                if (image::isOpaque(row[x], cutoff)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool hasOpaquePixel(ppb_image const& image, float const alpha_threshold) noexcept {
+        switch (image.format) {
+            case PPB_PIXEL_FORMAT_BGRA8:
+                return hasOpaquePixel<image::PixelBGRA8>(image, alpha_threshold);
+            case PPB_PIXEL_FORMAT_RGBA16:
+                return hasOpaquePixel<image::PixelRGBA16>(image, alpha_threshold);
+            case PPB_PIXEL_FORMAT_RGBA32F:
+                return hasOpaquePixel<image::PixelRGBA32F>(image, alpha_threshold);
+        }
+        return false;
+    }
+}
+
+extern "C" {
+    uint32_t ppb_version(void) {
+        return PPB_VERSION;
+    }
+
+    void ppb_default_options(ppb_options* const options) {
+        if (!options) {
+            return;
+        }
+        *options = ppb_options{};
+        options->struct_size = sizeof(ppb_options);
+    }
+
+    size_t ppb_scratch_size(uint32_t const width, uint32_t const height) {
+        auto const word_count = std::max(
+            image::bleedingScratchWordCount(width, height, image::BleedingTraversal::RowMajor),
+            image::bleedingScratchWordCount(width, height, image::BleedingTraversal::Tiled)
+        );
+        if (word_count > std::numeric_limits<size_t>::max() / sizeof(uint64_t)) {
+            return 0;
+        }
+        return word_count * sizeof(uint64_t);
+    }
+
+    size_t ppb_options_scratch_size(uint32_t const width, uint32_t const height, ppb_options const* const options) {
+        ppb_options resolved;
+        if (!resolveOptions(options, resolved)) {
+            return 0;
+        }
+        auto const word_count = image::bleedingScratchWordCount(width, height, traversalOf(resolved.flags));
+        auto const size = ppb_scratch_size(width, height);
+        if (size == 0 || word_count > std::numeric_limits<size_t>::max() / sizeof(uint64_t)) {
+            return 0;
+        }
+        return std::max(size, word_count * sizeof(uint64_t));
+    }
+
+    ppb_result ppb_bleed(ppb_image const* const image, ppb_options const* const options, void* const scratch, size_t const scratch_size) {
+        if (!image || (!image->pixels && image->width > 0 && image->height > 0)) {
+            return PPB_ERROR_INVALID_ARGUMENT;
+        }
+        ppb_options resolved;
+        if (!resolveOptions(options, resolved)) {
+            return PPB_ERROR_INVALID_ARGUMENT;
+        }
+        if (image->width == 0 || image->height == 0) {
+            return PPB_OK;
+        }
+        try {
+            if (!hasOpaquePixel(*image, resolved.alpha_threshold)) {
+                return PPB_OK;
+            }
+            auto const required = ppb_scratch_size(image->width, image->height);
+            if (required == 0) {
+                return PPB_ERROR_INVALID_ARGUMENT;
+            }
+            if (scratch) {
+                if (scratch_size < required || reinterpret_cast<uintptr_t>(scratch) % alignof(uint64_t) != 0) {
+                    return PPB_ERROR_SCRATCH_TOO_SMALL;
+                }
+                // all of it, a buffer of ppb_options_scratch_size bytes also holds the seeds of the jump flood
+                return bleed(*image, resolved, std::span{static_cast<uint64_t*>(scratch), scratch_size / sizeof(uint64_t)});
+            }
+            std::vector<uint64_t> owned(ppb_options_scratch_size(image->width, image->height, &resolved) / sizeof(uint64_t));
+            return bleed(*image, resolved, owned);
+        }
+        catch (std::bad_alloc const&) {
+            return PPB_ERROR_OUT_OF_MEMORY;
+        }
+        catch (...) {
+            return PPB_ERROR_INVALID_ARGUMENT;
+        }
+    }
+
+    char const* ppb_result_string(ppb_result const result) {
+        switch (result) {
+            case PPB_OK:
+                return "ok";
+            case PPB_ERROR_INVALID_ARGUMENT:
+                return "invalid argument";
+            case PPB_ERROR_SCRATCH_TOO_SMALL:
+                return "scratch buffer too small or misaligned";
+            case PPB_ERROR_OUT_OF_MEMORY:
+                return "out of memory";
+        }
+        return "unknown result";
+    }
+}
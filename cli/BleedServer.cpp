@@ -0,0 +1,155 @@
+#include "BleedServer.hpp"
+#include <cstdio>
+#include "BleedWorker.hpp"
+#include "ext/convert.hpp"
+
+namespace cli {
+    BleedServer::BleedServer(std::string socket_path, uint32_t const worker_count, bool const use_huge_pages)
+        : m_socket_path(std::move(socket_path)), m_use_huge_pages(use_huge_pages) {
+        m_workers.reserve(worker_count);
+        for (uint32_t i = 0; i < worker_count; ++i) {
+            m_workers.emplace_back([this]() -> void { workerMain(); });
+        }
+    }
+
+    BleedServer::~BleedServer() {
+        stop();
+        {
+            std::scoped_lock lock(m_jobs_mutex);
+            m_workers_exit = true;
+        }
+        m_jobs_condition.notify_all();
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    void BleedServer::run() {
+        // a socket file left behind by a previous run makes bind fail
+        DeleteFileW(ext::convert<std::wstring>(m_socket_path).c_str());
+
+        wil::unique_socket listen_socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+        if (!listen_socket) {
+            THROW_WIN32(WSAGetLastError());
+        }
+        auto const address = makeUnixAddress(m_socket_path);
+        if (bind(listen_socket.get(), reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == SOCKET_ERROR) {
+            THROW_WIN32(WSAGetLastError());
+        }
+        if (listen(listen_socket.get(), SOMAXCONN) == SOCKET_ERROR) {
+            THROW_WIN32(WSAGetLastError());
+        }
+        std::printf("listening on %s with %zu workers\n", m_socket_path.c_str(), m_workers.size());
+
+        // a list keeps every done flag in place while its thread runs
+        std::list<Connection> connections;
+        auto const reap = [&connections](bool const all) -> void {
+            for (auto it = connections.begin(); it != connections.end();) {
+                if (all || it->done) {
+                    it->thread.join();
+                    it = connections.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        };
+        while (!m_stopping) {
+            wil::unique_socket connection(accept(listen_socket.get(), nullptr, nullptr));
+            if (m_stopping) {
+                break; // woken by the connection of stop
+            }
+            if (!connection) {
+                THROW_WIN32(WSAGetLastError());
+            }
+            reap(false);
+            auto& entry = connections.emplace_back(std::move(connection));
+            entry.thread = std::thread([this, &entry]() -> void {
+                serveConnection(entry.socket);
+                entry.done = true;
+            });
+        }
+
+        listen_socket.reset();
+        // idle clients keep their threads blocked in recv, shutting the sockets down makes readLine return
+        for (auto& entry : connections) {
+            ::shutdown(entry.socket.native(), SD_BOTH);
+        }
+        reap(true);
+        DeleteFileW(ext::convert<std::wstring>(m_socket_path).c_str());
+    }
+
+    void BleedServer::workerMain() {
+        [[maybe_unused]] auto const co_uninit = wil::CoInitializeEx(COINIT_MULTITHREADED);
+        BleedWorker worker(m_use_huge_pages);
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock lock(m_jobs_mutex);
+                m_jobs_condition.wait(lock, [this]() -> bool { return m_workers_exit || !m_jobs.empty(); });
+                if (m_jobs.empty()) {
+                    return; // exiting and drained
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            job.promise.set_value(worker.run(job.request));
+        }
+    }
+
+    std::future<protocol::Response> BleedServer::submit(protocol::Request request) {
+        Job job{.request = std::move(request), .promise = {}};
+        auto future = job.promise.get_future();
+        {
+            std::scoped_lock lock(m_jobs_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_jobs_condition.notify_one();
+        return future;
+    }
+
+    void BleedServer::serveConnection(LineSocket& connection) {
+        try {
+            std::vector<std::future<protocol::Response>> batch;
+            std::string line;
+            while (connection.readLine(line)) {
+                if (line == "shutdown") {
+                    stop();
+                    return;
+                }
+                if (!line.empty()) {
+                    if (auto request = protocol::parseRequest(line); request) {
+                        batch.push_back(submit(std::move(*request)));
+                    }
+                    else {
+                        std::promise<protocol::Response> rejected;
+                        rejected.set_value(protocol::Response{.ok = false, .message = "malformed request"});
+                        batch.push_back(rejected.get_future());
+                    }
+                    continue;
+                }
+                for (auto& response : batch) {
+                    connection.writeLine(protocol::formatResponse(response.get()));
+                }
+                connection.writeLine({});
+                batch.clear();
+            }
+        }
+        catch (std::exception const& e) {
+            if (!m_stopping) {
+                std::fprintf(stderr, "connection failed: %s\n", e.what());
+            }
+        }
+    }
+
+    void BleedServer::stop() {
+        if (!m_stopping.exchange(true)) {
+            // unblocks accept without touching the listening socket from this thread, fails harmlessly once run returned
+            wil::unique_socket wake(::socket(AF_UNIX, SOCK_STREAM, 0));
+            auto const address = makeUnixAddress(m_socket_path);
+            if (wake) {
+                ::connect(wake.get(), reinterpret_cast<sockaddr const*>(&address), sizeof(address));
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Windows.hpp"
+#include "LineSocket.hpp"
+#include "Protocol.hpp"
+
+namespace cli {
+    // Resident bleed server listening on a unix domain socket. Requests from all connections share one pool
+    // of warm BleedWorker threads, every batch is answered in request order.
+    class BleedServer {
+    public:
+        BleedServer(std::string socket_path, uint32_t worker_count, bool use_huge_pages = false);
+        ~BleedServer();
+
+        // accepts connections until a client sends "shutdown"
+        void run();
+
+    private:
+        struct Job {
+            protocol::Request request;
+            std::promise<protocol::Response> promise;
+        };
+
+        // a connection and its thread, joined by run once done is set or on shutdown. The socket outlives the thread
+        // so run can shut it down to unblock a thread waiting on an idle client.
+        struct Connection {
+            explicit Connection(wil::unique_socket socket) : socket(std::move(socket)) {}
+
+            LineSocket socket;
+            std::thread thread;
+            std::atomic_bool done{false};
+        };
+
+        void workerMain();
+        void serveConnection(LineSocket& connection);
+        [[nodiscard]] std::future<protocol::Response> submit(protocol::Request request);
+        void stop();
+
+        std::string m_socket_path;
+        bool m_use_huge_pages{false};
+        std::atomic_bool m_stopping{false}; // the listening socket belongs to run, stop wakes it by connecting
+
+        std::mutex m_jobs_mutex;
+        std::condition_variable m_jobs_condition;
+        std::deque<Job> m_jobs;
+        bool m_workers_exit{false}; // only set once every connection is done, guarded by m_jobs_mutex
+
+        std::vector<std::thread> m_workers;
+    };
+}
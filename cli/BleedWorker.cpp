@@ -0,0 +1,206 @@
+#include "BleedWorker.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include "ext/convert.hpp"
+
+namespace cli {
+    namespace {
+        struct SharedMemoryImage {
+            wil::unique_handle mapping;
+            wil::unique_mapview_ptr<void> view;
+            image::PixelFormat format{};
+            uint32_t width{};
+            uint32_t height{};
+        };
+
+        image::PixelFormat parsePixelFormat(std::string_view const name) {
+            if (name == "bgra8") {
+                return image::PixelFormat::BGRA8;
+            }
+            if (name == "rgba16") {
+                return image::PixelFormat::RGBA16;
+            }
+            if (name == "rgba32f") {
+                return image::PixelFormat::RGBA32F;
+            }
+            throw std::runtime_error("unknown pixel format: " + std::string(name));
+        }
+
+        // shm:<mapping name>:<width>:<height>:<format>, the name itself may contain ':'
+        SharedMemoryImage openSharedMemory(std::string_view input, bool const writable) {
+            input.remove_prefix(protocol::shared_memory_prefix.size());
+            std::string_view fields[3];
+            for (auto& field : fields | std::views::reverse) {
+                auto const colon = input.rfind(':');
+                if (colon == std::string_view::npos) {
+                    throw std::runtime_error("malformed shared memory input");
+                }
+                field = input.substr(colon + 1);
+                input = input.substr(0, colon);
+            }
+            SharedMemoryImage shared;
+            if (!protocol::parseNumber(fields[0], shared.width) || !protocol::parseNumber(fields[1], shared.height)) {
+                throw std::runtime_error("malformed shared memory size");
+            }
+            shared.format = parsePixelFormat(fields[2]);
+            auto const name = ext::convert<std::wstring>(std::string(input));
+            DWORD const access = writable ? (FILE_MAP_READ | FILE_MAP_WRITE) : FILE_MAP_READ;
+            shared.mapping.reset(OpenFileMappingW(access, FALSE, name.c_str()));
+            THROW_LAST_ERROR_IF(!shared.mapping);
+            shared.view.reset(MapViewOfFile(shared.mapping.get(), access, 0, 0, 0));
+            THROW_LAST_ERROR_IF(!shared.view);
+            return shared;
+        }
+
+        bool sameInRegion(image::AnyImage2D const& image, std::span<uint8_t const> const original, image::DirtyRegion const& region) {
+            auto const pixel_size = image.pixelSize();
+            for (auto const& rect : region.rects()) {
+                for (uint32_t y = rect.y; y < rect.bottom(); ++y) {
+                    auto const offset = static_cast<size_t>(y) * image.pitch() + static_cast<size_t>(rect.x) * pixel_size;
+                    if (std::memcmp(image.buffer<uint8_t>() + offset, original.data() + offset, rect.width * pixel_size) != 0) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        // the input needs no change and is already in the container of the output, copy its bytes instead of encoding it again
+        void passThrough(std::string const& input, std::string const& output) {
+            if (input == output) {
+                return;
+            }
+            auto const input_path = ext::convert<std::wstring>(input);
+            auto const output_path = ext::convert<std::wstring>(output);
+            THROW_IF_WIN32_BOOL_FALSE(CopyFileW(input_path.c_str(), output_path.c_str(), FALSE));
+        }
+
+        uint64_t elapsedMicroseconds(std::chrono::steady_clock::time_point const begin, std::chrono::steady_clock::time_point const end) {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count());
+        }
+    }
+
+    BleedWorker::BleedWorker(bool const use_huge_pages) : m_arena(use_huge_pages) {}
+
+    protocol::Response BleedWorker::run(protocol::Request const& request) {
+        using clock = std::chrono::steady_clock;
+        protocol::Response response;
+        auto const page_faults = image::processPageFaultCount();
+        auto const acquire_count = m_arena.stats().acquire_count;
+        auto const reused_count = m_arena.stats().reused_count;
+        try {
+            auto const begin = clock::now();
+
+            std::optional<SharedMemoryImage> shared;
+            auto const in_place = request.output == protocol::in_place_output;
+            if (request.input.starts_with(protocol::shared_memory_prefix)) {
+                shared.emplace(openSharedMemory(request.input, in_place));
+                image::checkImageSize(request.limits, shared->width, shared->height, image::pixelSize(shared->format));
+                m_frames.resize(1);
+                auto& image = m_frames.front();
+                image.resize(shared->format, shared->width, shared->height);
+                MEMORY_BASIC_INFORMATION view_info{};
+                THROW_LAST_ERROR_IF(VirtualQuery(shared->view.get(), &view_info, sizeof(view_info)) == 0);
+                if (view_info.RegionSize < image.size()) {
+                    throw std::runtime_error("shared memory section is smaller than the image");
+                }
+                std::memcpy(image.buffer<uint8_t>(), shared->view.get(), image.size());
+            }
+            else if (in_place) {
+                throw std::runtime_error("in place output requires a shared memory input");
+            }
+            else if (!m_codec.hasAlphaChannel(request.input)) {
+                response.skip = protocol::SkipReason::NoAlphaChannel;
+            }
+            else if (!m_codec.loadFrames(request.input, m_frames, request.limits, &m_playback)) {
+                throw std::runtime_error("unsupported pixel format: " + request.input);
+            }
+            std::span<image::AnyImage2D> const frames{m_frames};
+            if (response.skip == protocol::SkipReason::None && std::ranges::all_of(frames, [&](auto const& frame) -> bool {
+                return frame.countTransparentPixels(request.alpha_threshold) == 0;
+            })) {
+                response.skip = protocol::SkipReason::Opaque;
+            }
+            auto const decoded = clock::now();
+
+            if (response.skip == protocol::SkipReason::None) {
+                // bleeding moves block compressed colors back before the block pass sets them again,
+                // so with that pass the dirty region alone can't tell whether anything changed
+                std::vector<std::span<uint8_t>> originals(frames.size());
+                for (size_t i = 0; i < frames.size(); ++i) {
+                    frames[i].clearDirtyRegion();
+                    if (request.optimize_for_block_compression) {
+                        originals[i] = m_arena.acquire<uint8_t>(frames[i].size());
+                        std::memcpy(originals[i].data(), frames[i].buffer<uint8_t>(), originals[i].size());
+                    }
+                }
+                auto const reports = image::bleedFrames(
+                    frames,
+                    image::BleedingOptions{request.alpha_threshold, request.kernel, request.optimize_for_block_compression},
+                    m_arena, request.limits
+                );
+                for (auto const& report : reports) {
+                    response.frame_bleed_us.push_back(report.bleed_us);
+                    response.reused_frame_count += report.reused ? 1 : 0;
+                    if (response.limit == image::ResourceLimit::None) {
+                        response.limit = report.limit;
+                    }
+                }
+                // only pixels whose color really changed are dirty, nothing dirty means the file was bled before
+                auto const unchanged = [&](size_t const i) -> bool {
+                    auto const& region = frames[i].dirtyRegion();
+                    return region.empty() || (!originals[i].empty() && sameInRegion(frames[i], originals[i], region));
+                };
+                if (std::ranges::all_of(std::views::iota(size_t{}, frames.size()), unchanged)) {
+                    response.skip = protocol::SkipReason::AlreadyBled;
+                }
+            }
+            auto const bled = clock::now();
+
+            if (shared && in_place) {
+                if (response.skip == protocol::SkipReason::None) {
+                    std::memcpy(shared->view.get(), frames.front().buffer<uint8_t>(), frames.front().size());
+                }
+            }
+            else if (!shared && response.skip != protocol::SkipReason::None
+                && m_codec.containerFormat(request.input) == wic::ImageCodec::outputContainerFormat(request.output)) {
+                passThrough(request.input, request.output);
+            }
+            else {
+                // a skipped file going to another container is converted like any other, e.g. a TIFF to PNG
+                if (response.skip == protocol::SkipReason::NoAlphaChannel && !m_codec.loadFrames(request.input, m_frames, request.limits, &m_playback)) {
+                    throw std::runtime_error("unsupported pixel format: " + request.input);
+                }
+                m_codec.saveFrames(request.output, m_frames, &m_playback);
+            }
+            auto const encoded = clock::now();
+
+            response.frame_count = response.skip == protocol::SkipReason::NoAlphaChannel ? 0 : static_cast<uint32_t>(frames.size());
+            response.ok = true;
+            response.decode_us = elapsedMicroseconds(begin, decoded);
+            response.bleed_us = elapsedMicroseconds(decoded, bled);
+            response.encode_us = elapsedMicroseconds(bled, encoded);
+            response.total_us = elapsedMicroseconds(begin, encoded);
+        }
+        catch (image::ResourceLimitError const& e) {
+            response.ok = false;
+            response.message = e.what();
+            response.limit = e.limit();
+        }
+        catch (std::exception const& e) {
+            response.ok = false;
+            response.message = e.what();
+        }
+        response.scratch_reused = m_arena.stats().reused_count - reused_count == m_arena.stats().acquire_count - acquire_count;
+        m_arena.reset();
+        response.page_faults = image::processPageFaultCount() - page_faults;
+        response.scratch_reserved_bytes = m_arena.stats().reserved_bytes;
+        response.scratch_high_water_bytes = m_arena.stats().high_water_bytes;
+        return response;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include "Windows.hpp"
+#include "Protocol.hpp"
+#include "image/AnyImage2D.hpp"
+#include "image/FrameBleeding.hpp"
+#include "image/ScratchArena.hpp"
+#include "wic/ImageCodec.hpp"
+
+namespace cli {
+    // Runs requests one after another on the calling thread. The WIC factory, the frame buffers and the scratch
+    // arena are kept between requests, so a resident worker pays codec setup once and its memory settles at
+    // the high-water mark of the batch instead of going back to the heap after every file.
+    class BleedWorker {
+    public:
+        explicit BleedWorker(bool use_huge_pages = false);
+
+        protocol::Response run(protocol::Request const& request);
+
+    private:
+        wic::ImageCodec m_codec;
+        std::vector<image::AnyImage2D> m_frames;
+        png::Playback m_playback; // delays of the frames of an APNG, kept for writing them back
+        image::ScratchArena m_arena;
+    };
+}
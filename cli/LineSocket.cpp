@@ -0,0 +1,75 @@
+#include "LineSocket.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace cli {
+    WinsockScope::WinsockScope() {
+        WSADATA data{};
+        if (auto const error = WSAStartup(MAKEWORD(2, 2), &data); error != 0) {
+            THROW_WIN32(error);
+        }
+    }
+
+    WinsockScope::~WinsockScope() {
+        WSACleanup();
+    }
+
+    sockaddr_un makeUnixAddress(std::string const& path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("socket path too long");
+        }
+        std::memcpy(address.sun_path, path.data(), path.size());
+        return address;
+    }
+
+    bool LineSocket::readLine(std::string& line) {
+        for (;;) {
+            if (auto const end = m_buffer.find('\n'); end != std::string::npos) {
+                line.assign(m_buffer, 0, end);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                m_buffer.erase(0, end + 1);
+                return true;
+            }
+            char chunk[4096];
+            auto const received = recv(m_socket.get(), chunk, static_cast<int>(sizeof(chunk)), 0);
+            if (received == 0) {
+                return false;
+            }
+            if (received == SOCKET_ERROR) {
+                THROW_WIN32(WSAGetLastError());
+            }
+            m_buffer.append(chunk, static_cast<size_t>(received));
+        }
+    }
+
+    void LineSocket::writeLine(std::string_view const line) {
+        std::string data(line);
+        data.push_back('\n');
+        size_t sent_total{};
+        while (sent_total < data.size()) {
+            auto const sent = send(
+                m_socket.get(), data.data() + sent_total, static_cast<int>(data.size() - sent_total), 0
+            );
+            if (sent == SOCKET_ERROR) {
+                THROW_WIN32(WSAGetLastError());
+            }
+            sent_total += static_cast<size_t>(sent);
+        }
+    }
+
+    LineSocket LineSocket::connect(std::string const& path) {
+        wil::unique_socket socket(::socket(AF_UNIX, SOCK_STREAM, 0));
+        if (!socket) {
+            THROW_WIN32(WSAGetLastError());
+        }
+        auto const address = makeUnixAddress(path);
+        if (::connect(socket.get(), reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == SOCKET_ERROR) {
+            THROW_WIN32(WSAGetLastError());
+        }
+        return LineSocket(std::move(socket));
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include "Windows.hpp"
+
+namespace cli {
+    // winsock startup for the lifetime of the object
+    class WinsockScope {
+    public:
+        WinsockScope();
+        ~WinsockScope();
+        WinsockScope(WinsockScope const&) = delete;
+        WinsockScope& operator=(WinsockScope const&) = delete;
+    };
+
+    [[nodiscard]] sockaddr_un makeUnixAddress(std::string const& path);
+
+    // buffered reading and writing of '\n' terminated lines on a connected stream socket
+    class LineSocket {
+    public:
+        explicit LineSocket(wil::unique_socket socket) : m_socket(std::move(socket)) {}
+
+        // returns false once the peer closed the connection and no complete line is left
+        bool readLine(std::string& line);
+
+        void writeLine(std::string_view line);
+
+        [[nodiscard]] SOCKET native() const noexcept {
+            return m_socket.get();
+        }
+
+        [[nodiscard]] static LineSocket connect(std::string const& path);
+
+    private:
+        wil::unique_socket m_socket;
+        std::string m_buffer;
+    };
+}
@@ -0,0 +1,381 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <charconv>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "image/PixelBleeding.hpp"
+#include "image/ResourceLimits.hpp"
+
+// Line based protocol between the bleed server and its clients, fields are separated by tabs.
+//
+//   request  : bleed <tab> input <tab> output <tab> alpha_threshold <tab> block_compression(0|1)
+//                 [<tab> connectivity(4|8) <tab> tie_break(first|average|max-alpha) <tab> traversal(rows|tiles|frontier|jump-flood[+corrections])
+//                 [<tab> max_pixels <tab> max_bytes <tab> max_time_ms <tab> max_passes <tab> on_limit(abort|radius|fill)]]
+//   response : ok <tab> decode_us <tab> bleed_us <tab> encode_us <tab> total_us
+//                 <tab> page_faults <tab> scratch_reused(0|1) <tab> scratch_reserved_bytes <tab> scratch_high_water_bytes
+//                 <tab> skip(-|no-alpha|opaque|bled) <tab> frame_count <tab> reused_frame_count
+//                 <tab> frame_bleed_us(comma separated, one per frame, "-" if nothing was bled)
+//                 <tab> limit(-|time|passes|bytes)
+//              error <tab> message [<tab> limit(pixels|bytes|time|passes)]
+//
+// A batch is any number of request lines followed by an empty line, the server answers with one
+// response line per request in request order followed by an empty line. A "shutdown" line stops the server.
+//
+// input is a file path or "shm:<mapping name>:<width>:<height>:<format>" naming a shared memory section of
+// tightly packed pixels, format is bgra8, rgba16 or rgba32f. With a shared memory input, output "-" writes
+// the result back into the section instead of encoding a file. A file with several frames, e.g. a multi-page
+// TIFF or an APNG, is bled frame by frame and written as pages of a .tif or .tiff output or as APNG otherwise.
+//
+// The limits of a request cap the job, 0 is unlimited, see image::ResourceLimits. A job that runs into one with
+// on_limit abort answers with an error naming the limit, with radius or fill the output is written and the ok
+// response names the limit that cut bleeding short. Either way the server goes on with the next request.
+namespace protocol {
+    inline constexpr std::string_view shared_memory_prefix{"shm:"};
+    inline constexpr std::string_view in_place_output{"-"};
+
+    struct Request {
+        std::string input;
+        std::string output;
+        float alpha_threshold{0.0f};
+        bool optimize_for_block_compression{false};
+        image::BleedingKernel kernel;
+        image::ResourceLimits limits;
+    };
+
+    // why a request needed no bleeding, skipped files are copied byte for byte instead of encoded again
+    enum class SkipReason : uint8_t {
+        None,
+        NoAlphaChannel, // pixel format without alpha, found from the header alone
+        Opaque, // no pixel at or below the alpha threshold
+        AlreadyBled, // bleeding changed no pixel
+    };
+
+    [[nodiscard]] inline std::string_view skipReasonName(SkipReason const reason) {
+        switch (reason) {
+        case SkipReason::NoAlphaChannel:
+            return "no-alpha";
+        case SkipReason::Opaque:
+            return "opaque";
+        case SkipReason::AlreadyBled:
+            return "bled";
+        default:
+            return "-";
+        }
+    }
+
+    [[nodiscard]] inline std::optional<SkipReason> parseSkipReason(std::string_view const name) {
+        for (auto const reason : {SkipReason::None, SkipReason::NoAlphaChannel, SkipReason::Opaque, SkipReason::AlreadyBled}) {
+            if (name == skipReasonName(reason)) {
+                return reason;
+            }
+        }
+        return std::nullopt;
+    }
+
+    struct Response {
+        bool ok{false};
+        std::string message;
+        uint64_t decode_us{};
+        uint64_t bleed_us{};
+        uint64_t encode_us{};
+        uint64_t total_us{};
+        // page faults of the server process while the request ran, other workers add to it
+        uint64_t page_faults{};
+        // true if all scratch memory came from the worker's arena without growing it
+        bool scratch_reused{false};
+        uint64_t scratch_reserved_bytes{};
+        uint64_t scratch_high_water_bytes{};
+        SkipReason skip{SkipReason::None};
+        uint32_t frame_count{};
+        // frames that replayed the source map of the previous frame, see image::bleedFrames
+        uint32_t reused_frame_count{};
+        std::vector<uint64_t> frame_bleed_us;
+        // the limit that aborted the job, or with ok the one that cut bleeding short
+        image::ResourceLimit limit{image::ResourceLimit::None};
+    };
+
+    [[nodiscard]] inline std::vector<std::string_view> splitFields(std::string_view line) {
+        std::vector<std::string_view> fields;
+        for (;;) {
+            auto const tab = line.find('\t');
+            fields.push_back(line.substr(0, tab));
+            if (tab == std::string_view::npos) {
+                return fields;
+            }
+            line.remove_prefix(tab + 1);
+        }
+    }
+
+    template <typename T>
+    [[nodiscard]] bool parseNumber(std::string_view const text, T& value) {
+        auto const [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return error == std::errc{} && end == text.data() + text.size();
+    }
+
+    [[nodiscard]] inline std::string_view tieBreakName(image::BleedingTieBreak const tie_break) {
+        switch (tie_break) {
+        case image::BleedingTieBreak::Average:
+            return "average";
+        case image::BleedingTieBreak::MaxAlpha:
+            return "max-alpha";
+        default:
+            return "first";
+        }
+    }
+
+    [[nodiscard]] inline std::optional<image::BleedingTieBreak> parseTieBreak(std::string_view const name) {
+        if (name == "first") {
+            return image::BleedingTieBreak::FirstHit;
+        }
+        if (name == "average") {
+            return image::BleedingTieBreak::Average;
+        }
+        if (name == "max-alpha") {
+            return image::BleedingTieBreak::MaxAlpha;
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] inline std::optional<image::BleedingConnectivity> parseConnectivity(std::string_view const text) {
+        if (text == "8") {
+            return image::BleedingConnectivity::Eight;
+        }
+        if (text == "4") {
+            return image::BleedingConnectivity::Four;
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] inline std::string_view traversalName(image::BleedingTraversal const traversal) {
+        switch (traversal) {
+        case image::BleedingTraversal::Tiled:
+            return "tiles";
+        case image::BleedingTraversal::Frontier:
+            return "frontier";
+        case image::BleedingTraversal::JumpFlood:
+            return "jump-flood";
+        default:
+            return "rows";
+        }
+    }
+
+    [[nodiscard]] inline std::optional<image::BleedingTraversal> parseTraversal(std::string_view const name) {
+        for (auto const traversal : {
+            image::BleedingTraversal::RowMajor, image::BleedingTraversal::Tiled,
+            image::BleedingTraversal::Frontier, image::BleedingTraversal::JumpFlood,
+        }) {
+            if (name == traversalName(traversal)) {
+                return traversal;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // traversal field of a request, the jump flood appends its correction passes, e.g. jump-flood+1
+    [[nodiscard]] inline std::string formatTraversal(image::BleedingKernel const& kernel) {
+        auto text = std::string(traversalName(kernel.traversal));
+        if (kernel.traversal == image::BleedingTraversal::JumpFlood) {
+            text += "+" + std::to_string(kernel.jump_flood_corrections);
+        }
+        return text;
+    }
+
+    // sets the traversal and the jump flood corrections of kernel, false if text is not a traversal field
+    [[nodiscard]] inline bool parseTraversal(std::string_view const text, image::BleedingKernel& kernel) {
+        auto const plus = text.find('+');
+        auto const traversal = parseTraversal(text.substr(0, plus));
+        if (!traversal) {
+            return false;
+        }
+        uint8_t corrections{image::BleedingKernel{}.jump_flood_corrections};
+        if (plus != std::string_view::npos
+            && (*traversal != image::BleedingTraversal::JumpFlood || !parseNumber(text.substr(plus + 1), corrections) || corrections > 2)) {
+            return false;
+        }
+        kernel.traversal = *traversal;
+        kernel.jump_flood_corrections = corrections;
+        return true;
+    }
+
+    [[nodiscard]] inline std::string_view limitActionName(image::LimitAction const action) {
+        switch (action) {
+        case image::LimitAction::RadiusLimit:
+            return "radius";
+        case image::LimitAction::ConstantFill:
+            return "fill";
+        default:
+            return "abort";
+        }
+    }
+
+    [[nodiscard]] inline std::optional<image::LimitAction> parseLimitAction(std::string_view const name) {
+        for (auto const action : {image::LimitAction::Abort, image::LimitAction::RadiusLimit, image::LimitAction::ConstantFill}) {
+            if (name == limitActionName(action)) {
+                return action;
+            }
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] inline std::optional<image::ResourceLimit> parseResourceLimit(std::string_view const name) {
+        for (auto const limit : {
+            image::ResourceLimit::None, image::ResourceLimit::Pixels, image::ResourceLimit::Bytes,
+            image::ResourceLimit::Time, image::ResourceLimit::Passes,
+        }) {
+            if (name == image::resourceLimitName(limit)) {
+                return limit;
+            }
+        }
+        return std::nullopt;
+    }
+
+    [[nodiscard]] inline std::string formatRequest(Request const& request) {
+        return "bleed\t" + request.input + "\t" + request.output + "\t"
+            + std::to_string(request.alpha_threshold) + "\t"
+            + (request.optimize_for_block_compression ? "1" : "0") + "\t"
+            + (request.kernel.connectivity == image::BleedingConnectivity::Four ? "4" : "8") + "\t"
+            + std::string(tieBreakName(request.kernel.tie_break)) + "\t"
+            + formatTraversal(request.kernel) + "\t"
+            + std::to_string(request.limits.max_pixels) + "\t" + std::to_string(request.limits.max_bytes) + "\t"
+            + std::to_string(request.limits.max_time.count()) + "\t" + std::to_string(request.limits.max_passes) + "\t"
+            + std::string(limitActionName(request.limits.on_limit));
+    }
+
+    [[nodiscard]] inline std::optional<Request> parseRequest(std::string_view const line) {
+        auto const fields = splitFields(line);
+        if ((fields.size() != 5 && fields.size() != 8 && fields.size() != 13) || fields[0] != "bleed") {
+            return std::nullopt;
+        }
+        Request request;
+        request.input.assign(fields[1]);
+        request.output.assign(fields[2]);
+        if (!parseNumber(fields[3], request.alpha_threshold)) {
+            return std::nullopt;
+        }
+        request.optimize_for_block_compression = fields[4] == "1";
+        if (fields.size() >= 8) {
+            auto const connectivity = parseConnectivity(fields[5]);
+            auto const tie_break = parseTieBreak(fields[6]);
+            if (!connectivity || !tie_break || !parseTraversal(fields[7], request.kernel)) {
+                return std::nullopt;
+            }
+            request.kernel.connectivity = *connectivity;
+            request.kernel.tie_break = *tie_break;
+        }
+        if (fields.size() == 13) {
+            int64_t max_time_ms{};
+            auto const on_limit = parseLimitAction(fields[12]);
+            if (!parseNumber(fields[8], request.limits.max_pixels)
+                || !parseNumber(fields[9], request.limits.max_bytes)
+                || !parseNumber(fields[10], max_time_ms) || max_time_ms < 0
+                || !parseNumber(fields[11], request.limits.max_passes)
+                || !on_limit) {
+                return std::nullopt;
+            }
+            request.limits.max_time = std::chrono::milliseconds{max_time_ms};
+            request.limits.on_limit = *on_limit;
+        }
+        return request;
+    }
+
+    [[nodiscard]] inline std::string formatFrameTimes(std::vector<uint64_t> const& frame_us) {
+        if (frame_us.empty()) {
+            return "-";
+        }
+        std::string text;
+        for (auto const us : frame_us) {
+            text += (text.empty() ? "" : ",") + std::to_string(us);
+        }
+        return text;
+    }
+
+    [[nodiscard]] inline std::optional<std::vector<uint64_t>> parseFrameTimes(std::string_view text) {
+        std::vector<uint64_t> frame_us;
+        if (text == "-") {
+            return frame_us;
+        }
+        for (;;) {
+            auto const comma = text.find(',');
+            if (!parseNumber(text.substr(0, comma), frame_us.emplace_back())) {
+                return std::nullopt;
+            }
+            if (comma == std::string_view::npos) {
+                return frame_us;
+            }
+            text.remove_prefix(comma + 1);
+        }
+    }
+
+    [[nodiscard]] inline std::string formatResponse(Response const& response) {
+        if (!response.ok) {
+            std::string message(response.message);
+            for (auto& c : message) {
+                if (c == '\t' || c == '\n' || c == '\r') {
+                    c = ' ';
+                }
+            }
+            if (response.limit != image::ResourceLimit::None) {
+                message += "\t" + std::string(image::resourceLimitName(response.limit));
+            }
+            return "error\t" + message;
+        }
+        return "ok\t" + std::to_string(response.decode_us) + "\t" + std::to_string(response.bleed_us) + "\t"
+            + std::to_string(response.encode_us) + "\t" + std::to_string(response.total_us) + "\t"
+            + std::to_string(response.page_faults) + "\t" + (response.scratch_reused ? "1" : "0") + "\t"
+            + std::to_string(response.scratch_reserved_bytes) + "\t" + std::to_string(response.scratch_high_water_bytes) + "\t"
+            + std::string(skipReasonName(response.skip)) + "\t"
+            + std::to_string(response.frame_count) + "\t" + std::to_string(response.reused_frame_count) + "\t"
+            + formatFrameTimes(response.frame_bleed_us) + "\t"
+            + std::string(image::resourceLimitName(response.limit));
+    }
+
+    [[nodiscard]] inline std::optional<Response> parseResponse(std::string_view const line) {
+        auto const fields = splitFields(line);
+        Response response;
+        if ((fields.size() == 2 || fields.size() == 3) && fields[0] == "error") {
+            response.message.assign(fields[1]);
+            if (fields.size() == 3) {
+                auto const limit = parseResourceLimit(fields[2]);
+                if (!limit) {
+                    return std::nullopt;
+                }
+                response.limit = *limit;
+            }
+            return response;
+        }
+        if (fields.size() != 14 || fields[0] != "ok"
+            || !parseNumber(fields[1], response.decode_us)
+            || !parseNumber(fields[2], response.bleed_us)
+            || !parseNumber(fields[3], response.encode_us)
+            || !parseNumber(fields[4], response.total_us)
+            || !parseNumber(fields[5], response.page_faults)
+            || !parseNumber(fields[7], response.scratch_reserved_bytes)
+            || !parseNumber(fields[8], response.scratch_high_water_bytes)
+            || !parseNumber(fields[10], response.frame_count)
+            || !parseNumber(fields[11], response.reused_frame_count)) {
+            return std::nullopt;
+        }
+        response.scratch_reused = fields[6] == "1";
+        auto const skip = parseSkipReason(fields[9]);
+        if (!skip) {
+            return std::nullopt;
+        }
+        response.skip = *skip;
+        auto frame_us = parseFrameTimes(fields[12]);
+        if (!frame_us) {
+            return std::nullopt;
+        }
+        response.frame_bleed_us = std::move(*frame_us);
+        auto const limit = parseResourceLimit(fields[13]);
+        if (!limit) {
+            return std::nullopt;
+        }
+        response.limit = *limit;
+        response.ok = true;
+        return response;
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <afunix.h>
+#include <windows.h>
+#include <wil/resource.h>
+#include <wil/result_macros.h>
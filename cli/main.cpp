@@ -0,0 +1,238 @@
+// png_pixel_bleed_cli: resident bleed server and its client
+//
+//   png_pixel_bleed_cli serve <socket path> [--workers <count>] [--huge-pages]
+//   png_pixel_bleed_cli client <socket path> [--alpha-threshold <value>] [--bc] [--connectivity 4|8] [--tie-break first|average|max-alpha] [--traversal rows|tiles|frontier|jump-flood[+0|1|2]] [--max-pixels <count>] [--max-bytes <count>] [--max-time-ms <ms>] [--max-passes <count>] [--on-limit abort|radius|fill] <input> <output> [<input> <output> ...]
+//   png_pixel_bleed_cli shutdown <socket path>
+
+#include "Windows.hpp"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "ext/convert.hpp"
+#include "Protocol.hpp"
+#include "LineSocket.hpp"
+#include "BleedServer.hpp"
+
+namespace {
+    int printUsage() {
+        std::fprintf(stderr,
+            "usage:\n"
+            "  png_pixel_bleed_cli serve <socket path> [--workers <count>] [--huge-pages]\n"
+            "  png_pixel_bleed_cli client <socket path> [--alpha-threshold <value>] [--bc] [--connectivity 4|8] [--tie-break first|average|max-alpha] [--traversal rows|tiles|frontier|jump-flood[+0|1|2]] [--max-pixels <count>] [--max-bytes <count>] [--max-time-ms <ms>] [--max-passes <count>] [--on-limit abort|radius|fill] <input> <output> [<input> <output> ...]\n"
+            "  png_pixel_bleed_cli shutdown <socket path>\n"
+        );
+        return 2;
+    }
+
+    int serveCommand(std::vector<std::string> const& args) {
+        auto worker_count = std::max(1u, std::thread::hardware_concurrency());
+        bool use_huge_pages{false};
+        for (size_t i = 3; i < args.size(); ++i) {
+            if (args[i] == "--workers" && i + 1 < args.size() && protocol::parseNumber(args[i + 1], worker_count)) {
+                ++i;
+                continue;
+            }
+            if (args[i] == "--huge-pages") {
+                use_huge_pages = true;
+                continue;
+            }
+            return printUsage();
+        }
+        cli::BleedServer server(args[2], std::max(1u, worker_count), use_huge_pages);
+        server.run();
+        return 0;
+    }
+
+    int clientCommand(std::vector<std::string> const& args) {
+        protocol::Request options;
+        std::vector<std::string> files;
+        for (size_t i = 3; i < args.size(); ++i) {
+            if (args[i] == "--alpha-threshold" && i + 1 < args.size()) {
+                if (!protocol::parseNumber(args[++i], options.alpha_threshold)) {
+                    return printUsage();
+                }
+            }
+            else if (args[i] == "--bc") {
+                options.optimize_for_block_compression = true;
+            }
+            else if (args[i] == "--connectivity" && i + 1 < args.size()) {
+                auto const connectivity = protocol::parseConnectivity(args[++i]);
+                if (!connectivity) {
+                    return printUsage();
+                }
+                options.kernel.connectivity = *connectivity;
+            }
+            else if (args[i] == "--traversal" && i + 1 < args.size()) {
+                if (!protocol::parseTraversal(args[++i], options.kernel)) {
+                    return printUsage();
+                }
+            }
+            else if (args[i] == "--max-pixels" && i + 1 < args.size()) {
+                if (!protocol::parseNumber(args[++i], options.limits.max_pixels)) {
+                    return printUsage();
+                }
+            }
+            else if (args[i] == "--max-bytes" && i + 1 < args.size()) {
+                if (!protocol::parseNumber(args[++i], options.limits.max_bytes)) {
+                    return printUsage();
+                }
+            }
+            else if (args[i] == "--max-time-ms" && i + 1 < args.size()) {
+                uint32_t max_time_ms{};
+                if (!protocol::parseNumber(args[++i], max_time_ms)) {
+                    return printUsage();
+                }
+                options.limits.max_time = std::chrono::milliseconds{max_time_ms};
+            }
+            else if (args[i] == "--max-passes" && i + 1 < args.size()) {
+                if (!protocol::parseNumber(args[++i], options.limits.max_passes)) {
+                    return printUsage();
+                }
+            }
+            else if (args[i] == "--on-limit" && i + 1 < args.size()) {
+                auto const on_limit = protocol::parseLimitAction(args[++i]);
+                if (!on_limit) {
+                    return printUsage();
+                }
+                options.limits.on_limit = *on_limit;
+            }
+            else if (args[i] == "--tie-break" && i + 1 < args.size()) {
+                auto const tie_break = protocol::parseTieBreak(args[++i]);
+                if (!tie_break) {
+                    return printUsage();
+                }
+                options.kernel.tie_break = *tie_break;
+            }
+            else {
+                files.push_back(args[i]);
+            }
+        }
+        if (files.empty() || files.size() % 2 != 0) {
+            return printUsage();
+        }
+
+        auto connection = cli::LineSocket::connect(args[2]);
+        for (size_t i = 0; i < files.size(); i += 2) {
+            auto request = options;
+            request.input = files[i];
+            request.output = files[i + 1];
+            connection.writeLine(protocol::formatRequest(request));
+        }
+        connection.writeLine({});
+
+        int exit_code{0};
+        size_t succeeded{};
+        size_t scratch_reused{};
+        size_t skipped{};
+        uint64_t page_faults{};
+        uint64_t scratch_reserved_bytes{};
+        uint64_t bled_frames{};
+        uint64_t reused_frames{};
+        // jobs aborted or cut short per image::ResourceLimit
+        size_t aborted{};
+        size_t cut_short{};
+        std::map<image::ResourceLimit, size_t> limit_counts;
+        std::string line;
+        for (size_t i = 0; i < files.size(); i += 2) {
+            if (!connection.readLine(line)) {
+                std::fprintf(stderr, "server closed the connection\n");
+                return 1;
+            }
+            auto const response = protocol::parseResponse(line);
+            if (response && response->limit != image::ResourceLimit::None) {
+                ++(response->ok ? cut_short : aborted);
+                ++limit_counts[response->limit];
+            }
+            if (!response || !response->ok) {
+                std::fprintf(stderr, "%s: %s\n", files[i].c_str(), response ? response->message.c_str() : "malformed response");
+                exit_code = 1;
+                continue;
+            }
+            std::printf(
+                "%s: decode %.3f ms, bleed %.3f ms, encode %.3f ms, total %.3f ms, %llu page faults%s%s%s%s%s\n", files[i].c_str(),
+                static_cast<double>(response->decode_us) / 1000.0, static_cast<double>(response->bleed_us) / 1000.0,
+                static_cast<double>(response->encode_us) / 1000.0, static_cast<double>(response->total_us) / 1000.0,
+                static_cast<unsigned long long>(response->page_faults), response->scratch_reused ? "" : ", scratch grown",
+                response->skip == protocol::SkipReason::None ? "" : ", skipped: ",
+                response->skip == protocol::SkipReason::None ? "" : protocol::skipReasonName(response->skip).data(),
+                response->limit == image::ResourceLimit::None ? "" : ", cut short by the limit on ",
+                response->limit == image::ResourceLimit::None ? "" : image::resourceLimitName(response->limit).data()
+            );
+            if (response->frame_bleed_us.size() > 1) {
+                std::printf("  %u frames, %u reused, bleed ms per frame:", response->frame_count, response->reused_frame_count);
+                for (auto const us : response->frame_bleed_us) {
+                    std::printf(" %.3f", static_cast<double>(us) / 1000.0);
+                }
+                std::printf("\n");
+            }
+            ++succeeded;
+            skipped += response->skip == protocol::SkipReason::None ? 0 : 1;
+            scratch_reused += response->scratch_reused ? 1 : 0;
+            page_faults += response->page_faults;
+            scratch_reserved_bytes = std::max(scratch_reserved_bytes, response->scratch_reserved_bytes);
+            bled_frames += response->frame_bleed_us.size();
+            reused_frames += response->reused_frame_count;
+        }
+        connection.readLine(line); // end of batch
+        if (succeeded > 0) {
+            std::printf(
+                "%zu files, %.1f%% skipped, scratch reused for %.1f%%, %llu page faults, largest worker arena %.1f MiB\n",
+                succeeded, 100.0 * static_cast<double>(skipped) / static_cast<double>(succeeded),
+                100.0 * static_cast<double>(scratch_reused) / static_cast<double>(succeeded),
+                static_cast<unsigned long long>(page_faults), static_cast<double>(scratch_reserved_bytes) / (1024.0 * 1024.0)
+            );
+        }
+        if (bled_frames > succeeded) {
+            std::printf(
+                "%llu frames, source map reused for %.1f%%\n", static_cast<unsigned long long>(bled_frames),
+                100.0 * static_cast<double>(reused_frames) / static_cast<double>(bled_frames)
+            );
+        }
+        if (aborted + cut_short > 0) {
+            std::printf("%zu files aborted and %zu cut short by limits:", aborted, cut_short);
+            for (auto const& [limit, count] : limit_counts) {
+                std::printf(" %s %zu", image::resourceLimitName(limit).data(), count);
+            }
+            std::printf("\n");
+        }
+        return exit_code;
+    }
+
+    int shutdownCommand(std::vector<std::string> const& args) {
+        auto connection = cli::LineSocket::connect(args[2]);
+        connection.writeLine("shutdown");
+        return 0;
+    }
+}
+
+int wmain(int argc, wchar_t** argv) {
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; ++i) {
+        args.push_back(ext::convert<std::string>(std::wstring_view(argv[i])));
+    }
+    if (args.size() < 3) {
+        return printUsage();
+    }
+    try {
+        cli::WinsockScope const winsock;
+        if (args[1] == "serve") {
+            return serveCommand(args);
+        }
+        if (args[1] == "client") {
+            return clientCommand(args);
+        }
+        if (args[1] == "shutdown") {
+            return shutdownCommand(args);
+        }
+        return printUsage();
+    }
+    catch (std::exception const& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
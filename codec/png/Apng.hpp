@@ -0,0 +1,443 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+#include <algorithm>
+#include "image/AnyImage2D.hpp"
+
+// Animated PNG on top of a codec of plain PNG streams, e.g. WIC, which decodes only the default image of an APNG.
+// splitAnimation cuts the file into one standalone PNG stream per frame: the IHDR with the frame's size, the header
+// chunks all frames share (PLTE, tRNS, ...) and the frame's IDAT or fdAT data as IDAT. joinAnimation is the reverse,
+// and AnimationCanvas composites the decoded frames, which may cover part of the canvas only, by their fcTL ops.
+// It is platform-neutral and header-only, its checks run in regress.
+namespace png {
+    inline constexpr std::array<uint8_t, 8> signature{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    enum class DisposeOp : uint8_t {
+        None, // the canvas is left as the frame made it
+        Background, // the frame's rect is cleared to transparent black
+        Previous, // the frame's rect goes back to what it was before the frame
+    };
+
+    enum class BlendOp : uint8_t {
+        Source, // the frame replaces the pixels of its rect
+        Over, // the frame is composited over them
+    };
+
+    // delay_num / delay_den seconds, a denominator of 0 means 100
+    struct Delay {
+        uint16_t numerator{1};
+        uint16_t denominator{10};
+    };
+
+    // the fcTL of a frame
+    struct FrameControl {
+        uint32_t width{};
+        uint32_t height{};
+        uint32_t x{};
+        uint32_t y{};
+        Delay delay;
+        DisposeOp dispose{DisposeOp::None};
+        BlendOp blend{BlendOp::Source};
+    };
+
+    // timing of composited frames, a frame without a delay gets the default one
+    struct Playback {
+        uint32_t play_count{}; // 0 loops forever
+        std::vector<Delay> delays;
+    };
+
+    struct Animation {
+        uint32_t width{};
+        uint32_t height{};
+        uint32_t play_count{};
+        std::vector<FrameControl> controls;
+        std::vector<std::vector<uint8_t>> frames; // one standalone PNG stream per control
+    };
+
+    namespace detail {
+        struct Chunk {
+            std::string_view type;
+            std::span<uint8_t const> data;
+        };
+
+        [[nodiscard]] inline uint32_t crc32(std::span<uint8_t const> const bytes, uint32_t crc) noexcept {
+            static constexpr auto table = []() -> std::array<uint32_t, 256> {
+                std::array<uint32_t, 256> entries{};
+                for (uint32_t i = 0; i < 256; ++i) {
+                    auto value = i;
+                    for (int bit = 0; bit < 8; ++bit) {
+                        value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                    }
+                    entries[i] = value;
+                }
+                return entries;
+            }();
+            for (auto const byte : bytes) {
+                crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+            }
+            return crc;
+        }
+
+        [[nodiscard]] inline uint32_t chunkCrc(std::string_view const type, std::span<uint8_t const> const data) noexcept {
+            auto const crc = crc32({reinterpret_cast<uint8_t const*>(type.data()), type.size()}, 0xffffffffu);
+            return crc32(data, crc) ^ 0xffffffffu;
+        }
+
+        [[nodiscard]] inline uint32_t readBigEndian32(uint8_t const* const data) noexcept {
+            return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16
+                | static_cast<uint32_t>(data[2]) << 8 | data[3];
+        }
+
+        [[nodiscard]] inline uint16_t readBigEndian16(uint8_t const* const data) noexcept {
+            return static_cast<uint16_t>(data[0] << 8 | data[1]);
+        }
+
+        inline void appendBigEndian32(std::vector<uint8_t>& bytes, uint32_t const value) {
+            bytes.insert(bytes.end(), {
+                static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value),
+            });
+        }
+
+        inline void appendBigEndian16(std::vector<uint8_t>& bytes, uint16_t const value) {
+            bytes.insert(bytes.end(), {static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value)});
+        }
+
+        inline void appendChunk(std::vector<uint8_t>& stream, std::string_view const type, std::span<uint8_t const> const data) {
+            appendBigEndian32(stream, static_cast<uint32_t>(data.size()));
+            stream.insert(stream.end(), type.begin(), type.end());
+            stream.insert(stream.end(), data.begin(), data.end());
+            appendBigEndian32(stream, chunkCrc(type, data));
+        }
+
+        // the chunks up to IEND, throws std::runtime_error if the file is no PNG, a chunk runs past its end
+        // or fails its checksum
+        [[nodiscard]] inline std::vector<Chunk> readChunks(std::span<uint8_t const> const file) {
+            if (file.size() < signature.size() || !std::equal(signature.begin(), signature.end(), file.begin())) {
+                throw std::runtime_error("not a PNG stream");
+            }
+            std::vector<Chunk> chunks;
+            for (size_t position = signature.size(); position < file.size();) {
+                if (file.size() - position < 12) {
+                    throw std::runtime_error("truncated PNG chunk");
+                }
+                auto const length = readBigEndian32(file.data() + position);
+                if (file.size() - position - 12 < length) {
+                    throw std::runtime_error("truncated PNG chunk");
+                }
+                Chunk const chunk{
+                    std::string_view{reinterpret_cast<char const*>(file.data() + position + 4), 4},
+                    file.subspan(position + 8, length),
+                };
+                if (chunkCrc(chunk.type, chunk.data) != readBigEndian32(file.data() + position + 8 + length)) {
+                    throw std::runtime_error("PNG chunk " + std::string(chunk.type) + " fails its checksum");
+                }
+                chunks.push_back(chunk);
+                if (chunk.type == "IEND") {
+                    break;
+                }
+                position += 12 + static_cast<size_t>(length);
+            }
+            if (chunks.empty() || chunks.front().type != "IHDR" || chunks.front().data.size() != 13) {
+                throw std::runtime_error("PNG stream does not start with its IHDR");
+            }
+            return chunks;
+        }
+
+        // the rect lies in the canvas, the frame standing for the default image covers all of it
+        inline void checkFrameRect(FrameControl const& control, uint32_t const width, uint32_t const height, bool const default_image) {
+            if (control.width == 0 || control.height == 0 || control.width > width || control.height > height
+                || control.x > width - control.width || control.y > height - control.height) {
+                throw std::runtime_error("APNG frame of " + std::to_string(control.width) + "x" + std::to_string(control.height)
+                    + " at " + std::to_string(control.x) + "," + std::to_string(control.y) + " leaves its canvas");
+            }
+            if (default_image && (control.x != 0 || control.y != 0 || control.width != width || control.height != height)) {
+                throw std::runtime_error("APNG frame of the default image does not cover the canvas");
+            }
+        }
+    }
+
+    // nullopt for a plain PNG, throws std::runtime_error if the animation is malformed: frames out of sequence,
+    // leaving the canvas or without data, or another frame count than acTL announced. A default image without
+    // a fcTL is not part of the animation and left out.
+    [[nodiscard]] inline std::optional<Animation> splitAnimation(std::span<uint8_t const> const file) {
+        auto const chunks = detail::readChunks(file);
+        auto const& header = chunks.front().data;
+        Animation animation;
+        animation.width = detail::readBigEndian32(header.data());
+        animation.height = detail::readBigEndian32(header.data() + 4);
+
+        std::optional<uint32_t> frame_count;
+        std::vector<detail::Chunk> shared; // PLTE, tRNS and ancillary chunks ahead of the image data
+        std::vector<std::vector<std::span<uint8_t const>>> frame_data;
+        uint32_t sequence{};
+        auto image_data = false;
+        auto default_image = false; // the IDAT data is the first frame
+        for (auto const& chunk : std::span{chunks}.subspan(1)) {
+            if (chunk.type == "acTL") {
+                if (chunk.data.size() != 8 || image_data) {
+                    throw std::runtime_error("malformed APNG acTL chunk");
+                }
+                frame_count = detail::readBigEndian32(chunk.data.data());
+                animation.play_count = detail::readBigEndian32(chunk.data.data() + 4);
+            }
+            else if (chunk.type == "fcTL") {
+                if (chunk.data.size() != 26 || detail::readBigEndian32(chunk.data.data()) != sequence++) {
+                    throw std::runtime_error("malformed APNG fcTL chunk");
+                }
+                auto const* const data = chunk.data.data();
+                FrameControl const control{
+                    detail::readBigEndian32(data + 4), detail::readBigEndian32(data + 8),
+                    detail::readBigEndian32(data + 12), detail::readBigEndian32(data + 16),
+                    Delay{detail::readBigEndian16(data + 20), detail::readBigEndian16(data + 22)},
+                    static_cast<DisposeOp>(data[24]), static_cast<BlendOp>(data[25]),
+                };
+                if (data[24] > 2 || data[25] > 1) {
+                    throw std::runtime_error("APNG frame with unknown dispose or blend op");
+                }
+                if (!frame_data.empty() && frame_data.back().empty()) {
+                    throw std::runtime_error("APNG frame without image data");
+                }
+                detail::checkFrameRect(control, animation.width, animation.height, !image_data && animation.controls.empty());
+                animation.controls.push_back(control);
+                frame_data.emplace_back();
+            }
+            else if (chunk.type == "IDAT") {
+                if (!image_data) {
+                    image_data = true;
+                    default_image = animation.controls.size() == 1;
+                }
+                if (default_image) {
+                    frame_data.front().push_back(chunk.data);
+                }
+            }
+            else if (chunk.type == "fdAT") {
+                if (chunk.data.size() < 4 || detail::readBigEndian32(chunk.data.data()) != sequence++
+                    || !image_data || frame_data.empty() || (default_image && frame_data.size() == 1)) {
+                    throw std::runtime_error("malformed APNG fdAT chunk");
+                }
+                frame_data.back().push_back(chunk.data.subspan(4));
+            }
+            else if (chunk.type != "IEND" && !image_data) {
+                shared.push_back(chunk);
+            }
+        }
+        if (!frame_count) {
+            return std::nullopt;
+        }
+        if (*frame_count == 0 || *frame_count != animation.controls.size() || frame_data.back().empty()) {
+            throw std::runtime_error("APNG announces " + std::to_string(*frame_count) + " frames but holds "
+                + std::to_string(animation.controls.size()));
+        }
+
+        std::vector<uint8_t> frame_header;
+        for (size_t i = 0; i < animation.controls.size(); ++i) {
+            auto& stream = animation.frames.emplace_back(signature.begin(), signature.end());
+            frame_header.clear();
+            detail::appendBigEndian32(frame_header, animation.controls[i].width);
+            detail::appendBigEndian32(frame_header, animation.controls[i].height);
+            frame_header.insert(frame_header.end(), header.begin() + 8, header.end());
+            detail::appendChunk(stream, "IHDR", frame_header);
+            for (auto const& chunk : shared) {
+                detail::appendChunk(stream, chunk.type, chunk.data);
+            }
+            for (auto const& data : frame_data[i]) {
+                detail::appendChunk(stream, "IDAT", data);
+            }
+            detail::appendChunk(stream, "IEND", {});
+        }
+        return animation;
+    }
+
+    // one APNG of standalone PNG streams, e.g. encoded by WIC, the first is the default image and covers the canvas.
+    // The size of each frame is taken from its stream. The streams must agree on everything else of their IHDR
+    // and on PLTE and tRNS, the header chunks of the first are kept. Throws std::runtime_error otherwise.
+    [[nodiscard]] inline std::vector<uint8_t> joinAnimation(
+        std::span<std::vector<uint8_t> const> const frames, std::span<FrameControl const> const controls, uint32_t const play_count
+    ) {
+        if (frames.empty() || frames.size() != controls.size()) {
+            throw std::runtime_error("an APNG needs a fcTL for each of at least one frame");
+        }
+        std::vector<uint8_t> file(signature.begin(), signature.end());
+        std::vector<detail::Chunk> first_shared;
+        std::vector<uint8_t> data;
+        uint32_t width{};
+        uint32_t height{};
+        uint32_t sequence{};
+        for (size_t i = 0; i < frames.size(); ++i) {
+            auto const chunks = detail::readChunks(frames[i]);
+            auto const& header = chunks.front().data;
+            std::vector<detail::Chunk> shared;
+            for (auto const& chunk : chunks) {
+                if (chunk.type == "IDAT") {
+                    break;
+                }
+                if (chunk.type == "PLTE" || chunk.type == "tRNS") {
+                    shared.push_back(chunk);
+                }
+            }
+            auto control = controls[i];
+            control.width = detail::readBigEndian32(header.data());
+            control.height = detail::readBigEndian32(header.data() + 4);
+            if (i == 0) {
+                width = control.width;
+                height = control.height;
+                first_shared = shared;
+                detail::appendChunk(file, "IHDR", header);
+                data.clear();
+                detail::appendBigEndian32(data, static_cast<uint32_t>(frames.size()));
+                detail::appendBigEndian32(data, play_count);
+                detail::appendChunk(file, "acTL", data);
+                for (auto const& chunk : chunks) {
+                    if (chunk.type == "IDAT") {
+                        break;
+                    }
+                    if (chunk.type != "IHDR") {
+                        detail::appendChunk(file, chunk.type, chunk.data);
+                    }
+                }
+            }
+            else {
+                auto const& first_header = detail::readChunks(frames.front()).front().data;
+                auto const same_chunks = std::ranges::equal(shared, first_shared, [](detail::Chunk const& a, detail::Chunk const& b) -> bool {
+                    return a.type == b.type && std::ranges::equal(a.data, b.data);
+                });
+                if (!std::equal(header.begin() + 8, header.end(), first_header.begin() + 8) || !same_chunks) {
+                    throw std::runtime_error("APNG frame " + std::to_string(i) + " has another pixel format or palette than the first");
+                }
+            }
+            detail::checkFrameRect(control, width, height, i == 0);
+
+            data.clear();
+            detail::appendBigEndian32(data, sequence++);
+            detail::appendBigEndian32(data, control.width);
+            detail::appendBigEndian32(data, control.height);
+            detail::appendBigEndian32(data, control.x);
+            detail::appendBigEndian32(data, control.y);
+            detail::appendBigEndian16(data, control.delay.numerator);
+            detail::appendBigEndian16(data, control.delay.denominator);
+            data.push_back(static_cast<uint8_t>(control.dispose));
+            data.push_back(static_cast<uint8_t>(control.blend));
+            detail::appendChunk(file, "fcTL", data);
+            for (auto const& chunk : chunks) {
+                if (chunk.type != "IDAT") {
+                    continue;
+                }
+                if (i == 0) {
+                    detail::appendChunk(file, "IDAT", chunk.data);
+                    continue;
+                }
+                data.clear();
+                detail::appendBigEndian32(data, sequence++);
+                data.insert(data.end(), chunk.data.begin(), chunk.data.end());
+                detail::appendChunk(file, "fdAT", data);
+            }
+        }
+        detail::appendChunk(file, "IEND", {});
+        return file;
+    }
+
+    namespace detail {
+        // non-premultiplied source over target, as the APNG spec composites
+        template <typename Pixel>
+        void blendOver(Pixel& target, Pixel const& source) noexcept {
+            using Traits = image::PixelTraits<Pixel>;
+            using Channel = typename Traits::Channel;
+            auto const alpha_max = static_cast<float>(Traits::alpha_max);
+            auto const source_alpha = static_cast<float>(source.a) / alpha_max;
+            if (source_alpha >= 1.0f) {
+                target = source;
+                return;
+            }
+            if (source_alpha <= 0.0f) {
+                return;
+            }
+            auto const target_weight = static_cast<float>(target.a) / alpha_max * (1.0f - source_alpha);
+            auto const alpha = source_alpha + target_weight;
+            auto const mix = [&](Channel const source_channel, Channel const target_channel) -> Channel {
+                return image::detail::toChannel<Channel>(
+                    (static_cast<float>(source_channel) * source_alpha + static_cast<float>(target_channel) * target_weight) / alpha
+                );
+            };
+            target.r = mix(source.r, target.r);
+            target.g = mix(source.g, target.g);
+            target.b = mix(source.b, target.b);
+            target.a = image::detail::toChannel<Channel>(alpha * alpha_max);
+        }
+    }
+
+    // The canvas of an animation, render gives the full frame the animation shows after each of its frames.
+    // Keeps its buffers between animations.
+    class AnimationCanvas {
+    public:
+        // a transparent black canvas, as before the first frame
+        void reset(image::PixelFormat const format, uint32_t const width, uint32_t const height) {
+            m_canvas.resize(format, width, height);
+            m_dispose = DisposeOp::None;
+            m_first = true;
+        }
+
+        // disposes of the previous frame, then puts frame at its rect. Throws std::runtime_error if the frame
+        // has another pixel format than the canvas or does not fit the rect of control
+        image::AnyImage2D const& render(image::AnyImage2D const& frame, FrameControl const& control) {
+            auto const pixel_size = m_canvas.pixelSize();
+            switch (m_dispose) {
+            case DisposeOp::Background:
+                for (auto y = m_rect.y; y < m_rect.bottom(); ++y) {
+                    std::memset(m_canvas.buffer<uint8_t>() + static_cast<size_t>(y) * m_canvas.pitch() + static_cast<size_t>(m_rect.x) * pixel_size,
+                        0, static_cast<size_t>(m_rect.width) * pixel_size);
+                }
+                break;
+            case DisposeOp::Previous:
+                image::copyRect(m_canvas.buffer<uint8_t>(), m_canvas.pitch(), m_previous.buffer<uint8_t>(), m_previous.pitch(), m_rect, pixel_size);
+                break;
+            default:
+                break;
+            }
+
+            if (frame.format() != m_canvas.format() || frame.width() != control.width || frame.height() != control.height) {
+                throw std::runtime_error("APNG frame does not match its fcTL or the pixel format of the canvas");
+            }
+            detail::checkFrameRect(control, m_canvas.width(), m_canvas.height(), false);
+            // the first frame has nothing before it to go back to
+            m_dispose = m_first && control.dispose == DisposeOp::Previous ? DisposeOp::Background : control.dispose;
+            m_rect = image::Rect{control.x, control.y, control.width, control.height};
+            m_first = false;
+            if (m_dispose == DisposeOp::Previous) {
+                m_previous = m_canvas;
+            }
+
+            std::visit([&](auto& canvas) -> void {
+                using Image = std::decay_t<decltype(canvas)>;
+                using Pixel = typename Image::PixelType;
+                auto const& pixels = std::get<Image>(frame.variant());
+                for (uint32_t y = 0; y < control.height; ++y) {
+                    auto* const target = canvas.template buffer<Pixel>() + static_cast<size_t>(control.y + y) * canvas.width() + control.x;
+                    auto const* const source = pixels.template buffer<Pixel>() + static_cast<size_t>(y) * pixels.width();
+                    if (control.blend == BlendOp::Source) {
+                        std::memcpy(target, source, static_cast<size_t>(control.width) * sizeof(Pixel));
+                        continue;
+                    }
+                    for (uint32_t x = 0; x < control.width; ++x) {
+                        detail::blendOver(target[x], source[x]);
+                    }
+                }
+            }, m_canvas.variant());
+            return m_canvas;
+        }
+
+    private:
+        image::AnyImage2D m_canvas;
+        image::AnyImage2D m_previous;
+        image::Rect m_rect;
+        DisposeOp m_dispose{DisposeOp::None};
+        bool m_first{true};
+    };
+}
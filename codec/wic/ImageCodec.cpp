@@ -0,0 +1,435 @@
+#include "wic/ImageCodec.hpp"
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include <wil/resource.h>
+#include <wil/result_macros.h>
+#include "ext/convert.hpp"
+
+namespace wic {
+    namespace {
+        // a number of the metadata at name, nullopt if there is none
+        std::optional<uint32_t> readMetadataNumber(IWICMetadataQueryReader* const reader, wchar_t const* const name) {
+            wil::unique_prop_variant value;
+            if (FAILED(reader->GetMetadataByName(name, value.reset_and_addressof()))) {
+                return std::nullopt;
+            }
+            switch (value.vt) {
+            case VT_UI1:
+                return value.bVal;
+            case VT_UI2:
+                return value.uiVal;
+            case VT_UI4:
+                return value.ulVal;
+            default:
+                return std::nullopt;
+            }
+        }
+
+        // WIC gives the frames of a GIF as stored, rects of the logical screen meant to be composited by their
+        // disposal methods, which is left undone
+        void checkFullCanvas(IWICBitmapDecoder* const decoder, IWICBitmapFrameDecode* const decoder_frame, std::string const& path, UINT const index) {
+            wil::com_ptr<IWICMetadataQueryReader> screen;
+            wil::com_ptr<IWICMetadataQueryReader> descriptor;
+            THROW_IF_FAILED(decoder->GetMetadataQueryReader(screen.put()));
+            THROW_IF_FAILED(decoder_frame->GetMetadataQueryReader(descriptor.put()));
+            UINT width{};
+            UINT height{};
+            THROW_IF_FAILED(decoder_frame->GetSize(&width, &height));
+            if (readMetadataNumber(descriptor.get(), L"/imgdesc/Left").value_or(0) != 0
+                || readMetadataNumber(descriptor.get(), L"/imgdesc/Top").value_or(0) != 0
+                || readMetadataNumber(screen.get(), L"/logscrdesc/Width").value_or(width) != width
+                || readMetadataNumber(screen.get(), L"/logscrdesc/Height").value_or(height) != height) {
+                throw std::runtime_error(
+                    "frame " + std::to_string(index) + " of " + path + " covers part of its canvas only, such frames are not composited"
+                );
+            }
+        }
+
+        // the whole stream, from its start
+        std::vector<uint8_t> readStream(IStream* const stream) {
+            STATSTG stat{};
+            THROW_IF_FAILED(stream->Stat(&stat, STATFLAG_NONAME));
+            if (stat.cbSize.QuadPart > UINT32_MAX) {
+                throw std::length_error("stream of " + std::to_string(stat.cbSize.QuadPart) + " bytes is too large");
+            }
+            std::vector<uint8_t> bytes(static_cast<size_t>(stat.cbSize.QuadPart));
+            THROW_IF_FAILED(stream->Seek(LARGE_INTEGER{}, STREAM_SEEK_SET, nullptr));
+            ULONG read{};
+            THROW_IF_FAILED(stream->Read(bytes.data(), static_cast<ULONG>(bytes.size()), &read));
+            if (read != bytes.size()) {
+                throw std::runtime_error("stream ended after " + std::to_string(read) + " of " + std::to_string(bytes.size()) + " bytes");
+            }
+            return bytes;
+        }
+    }
+
+    WICPixelFormatGUID toWicPixelFormat(image::PixelFormat const format) {
+        switch (format) {
+        case image::PixelFormat::RGBA16:
+            return GUID_WICPixelFormat64bppRGBA;
+        case image::PixelFormat::RGBA32F:
+            return GUID_WICPixelFormat128bppRGBAFloat;
+        default:
+            return GUID_WICPixelFormat32bppBGRA;
+        }
+    }
+
+    IWICImagingFactory* ImageCodec::factory() {
+        if (!m_factory) {
+            m_factory = wil::CoCreateInstance<IWICImagingFactory>(CLSID_WICImagingFactory);
+        }
+        return m_factory.get();
+    }
+
+    bool ImageCodec::load(std::string const& path, image::AnyImage2D& image, image::ResourceLimits const& limits) {
+        auto const decoder = openDecoder(path, WICDecodeMetadataCacheOnLoad);
+        wil::com_ptr<IWICBitmapFrameDecode> decoder_frame;
+        THROW_IF_FAILED(decoder->GetFrame(0, decoder_frame.put()));
+        uint64_t used_bytes{};
+        return decodeFrame(decoder_frame.get(), image, limits, used_bytes);
+    }
+
+    bool ImageCodec::loadFrames(
+        std::string const& path, std::vector<image::AnyImage2D>& frames, image::ResourceLimits const& limits, png::Playback* const playback
+    ) {
+        if (playback) {
+            *playback = {};
+        }
+        if (auto const animation = readAnimation(path); animation) {
+            return loadAnimation(*animation, frames, limits, playback);
+        }
+        auto const decoder = openDecoder(path, WICDecodeMetadataCacheOnLoad);
+        UINT frame_count{};
+        THROW_IF_FAILED(decoder->GetFrameCount(&frame_count));
+        GUID container_format{};
+        THROW_IF_FAILED(decoder->GetContainerFormat(&container_format));
+        auto const partial_frames = frame_count > 1 && container_format == GUID_ContainerFormatGif;
+        // frames are added as they are decoded, a header claiming millions of pages runs into the limits first
+        frames.resize(std::min<size_t>(frames.size(), frame_count));
+        uint64_t used_bytes{};
+        for (UINT i = 0; i < frame_count; ++i) {
+            wil::com_ptr<IWICBitmapFrameDecode> decoder_frame;
+            THROW_IF_FAILED(decoder->GetFrame(i, decoder_frame.put()));
+            if (partial_frames) {
+                checkFullCanvas(decoder.get(), decoder_frame.get(), path, i);
+            }
+            if (i == frames.size()) {
+                frames.emplace_back();
+            }
+            if (!decodeFrame(decoder_frame.get(), frames[i], limits, used_bytes)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool ImageCodec::hasAlphaChannel(std::string const& path) {
+        auto const decoder = openDecoder(path, WICDecodeMetadataCacheOnDemand);
+        wil::com_ptr<IWICBitmapFrameDecode> decoder_frame;
+        THROW_IF_FAILED(decoder->GetFrame(0, decoder_frame.put()));
+        WICPixelFormatGUID pixel_format{};
+        THROW_IF_FAILED(decoder_frame->GetPixelFormat(&pixel_format));
+
+        wil::com_ptr<IWICComponentInfo> component_info;
+        THROW_IF_FAILED(factory()->CreateComponentInfo(pixel_format, component_info.put()));
+        auto const pixel_format_info = component_info.query<IWICPixelFormatInfo2>();
+        BOOL supports_transparency{FALSE};
+        THROW_IF_FAILED(pixel_format_info->SupportsTransparency(&supports_transparency));
+        return supports_transparency != FALSE;
+    }
+
+    void ImageCodec::save(std::string const& path, image::AnyImage2D& image) {
+        saveFrames(path, std::span{&image, 1});
+    }
+
+    void ImageCodec::saveFrames(std::string const& path, std::span<image::AnyImage2D> const frames, png::Playback const* const playback) {
+        auto const container_format = outputContainerFormat(path);
+        if (container_format == GUID_ContainerFormatPng && frames.size() > 1) {
+            saveAnimation(path, frames, playback);
+            return;
+        }
+
+        wil::com_ptr<IWICStream> stream;
+        THROW_IF_FAILED(factory()->CreateStream(stream.put()));
+        auto const file_path = ext::convert<std::wstring>(path);
+        THROW_IF_FAILED(stream->InitializeFromFilename(file_path.c_str(), GENERIC_WRITE));
+
+        wil::com_ptr<IWICBitmapEncoder> encoder;
+        THROW_IF_FAILED(factory()->CreateEncoder(container_format, nullptr, encoder.put()));
+        THROW_IF_FAILED(encoder->Initialize(stream.get(), WICBitmapEncoderNoCache));
+        for (auto& frame : frames) {
+            encodeFrame(encoder.get(), frame);
+        }
+        THROW_IF_FAILED(encoder->Commit());
+    }
+
+    GUID ImageCodec::containerFormat(std::string const& path) {
+        auto const decoder = openDecoder(path, WICDecodeMetadataCacheOnDemand);
+        GUID container_format{};
+        THROW_IF_FAILED(decoder->GetContainerFormat(&container_format));
+        return container_format;
+    }
+
+    GUID ImageCodec::outputContainerFormat(std::string const& path) {
+        auto const extension = std::filesystem::path(ext::convert<std::wstring>(path)).extension().wstring();
+        if (_wcsicmp(extension.c_str(), L".tif") == 0 || _wcsicmp(extension.c_str(), L".tiff") == 0) {
+            return GUID_ContainerFormatTiff;
+        }
+        return GUID_ContainerFormatPng;
+    }
+
+    std::optional<png::Animation> ImageCodec::readAnimation(std::string const& path) {
+        wil::com_ptr<IWICStream> stream;
+        THROW_IF_FAILED(factory()->CreateStream(stream.put()));
+        auto const file_path = ext::convert<std::wstring>(path);
+        THROW_IF_FAILED(stream->InitializeFromFilename(file_path.c_str(), GENERIC_READ));
+
+        // only the chunk headers up to the image data are read to tell an APNG by its acTL
+        auto const read = [&](void* const data, ULONG const size) -> bool {
+            ULONG read_size{};
+            return SUCCEEDED(stream->Read(data, size, &read_size)) && read_size == size;
+        };
+        std::array<uint8_t, 8> header{};
+        if (!read(header.data(), 8) || header != png::signature) {
+            return std::nullopt;
+        }
+        for (auto animated = false; !animated;) {
+            if (!read(header.data(), 8)) {
+                return std::nullopt;
+            }
+            std::string_view const type{reinterpret_cast<char const*>(header.data() + 4), 4};
+            if (type == "IDAT" || type == "IEND") {
+                return std::nullopt;
+            }
+            animated = type == "acTL";
+            LARGE_INTEGER skip{};
+            skip.QuadPart = static_cast<LONGLONG>(png::detail::readBigEndian32(header.data())) + 4;
+            THROW_IF_FAILED(stream->Seek(skip, STREAM_SEEK_CUR, nullptr));
+        }
+        return png::splitAnimation(readStream(stream.get()));
+    }
+
+    bool ImageCodec::loadAnimation(
+        png::Animation const& animation, std::vector<image::AnyImage2D>& frames, image::ResourceLimits const& limits,
+        png::Playback* const playback
+    ) {
+        frames.resize(std::min(frames.size(), animation.frames.size()));
+        uint64_t used_bytes{};
+        for (size_t i = 0; i < animation.frames.size(); ++i) {
+            auto const& data = animation.frames[i];
+            wil::com_ptr<IWICStream> stream;
+            THROW_IF_FAILED(factory()->CreateStream(stream.put()));
+            THROW_IF_FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(data.data()), static_cast<DWORD>(data.size())));
+            wil::com_ptr<IWICBitmapDecoder> decoder;
+            THROW_IF_FAILED(factory()->CreateDecoderFromStream(stream.get(), nullptr, WICDecodeMetadataCacheOnLoad, decoder.put()));
+            wil::com_ptr<IWICBitmapFrameDecode> decoder_frame;
+            THROW_IF_FAILED(decoder->GetFrame(0, decoder_frame.put()));
+
+            // the partial frame is checked on top of the frames before it, then replaced by its full canvas
+            auto frame_bytes = used_bytes;
+            if (!decodeFrame(decoder_frame.get(), m_animation_frame, limits, frame_bytes)) {
+                return false;
+            }
+            auto const format = m_animation_frame.format();
+            used_bytes = image::checkImageSize(limits, animation.width, animation.height, image::pixelSize(format), used_bytes);
+            if (i == 0) {
+                m_canvas.reset(format, animation.width, animation.height);
+            }
+            if (i == frames.size()) {
+                frames.emplace_back();
+            }
+            frames[i] = m_canvas.render(m_animation_frame, animation.controls[i]);
+            if (playback) {
+                playback->delays.push_back(animation.controls[i].delay);
+            }
+        }
+        if (playback) {
+            playback->play_count = animation.play_count;
+        }
+        return true;
+    }
+
+    void ImageCodec::saveAnimation(std::string const& path, std::span<image::AnyImage2D> const frames, png::Playback const* const playback) {
+        // every frame is encoded on its own into memory, then their image data is put together as APNG
+        std::vector<std::vector<uint8_t>> streams;
+        std::vector<png::FrameControl> controls;
+        for (size_t i = 0; i < frames.size(); ++i) {
+            wil::com_ptr<IStream> memory;
+            THROW_IF_FAILED(CreateStreamOnHGlobal(nullptr, TRUE, memory.put()));
+            wil::com_ptr<IWICBitmapEncoder> encoder;
+            THROW_IF_FAILED(factory()->CreateEncoder(GUID_ContainerFormatPng, nullptr, encoder.put()));
+            THROW_IF_FAILED(encoder->Initialize(memory.get(), WICBitmapEncoderNoCache));
+            encodeFrame(encoder.get(), frames[i]);
+            THROW_IF_FAILED(encoder->Commit());
+            streams.push_back(readStream(memory.get()));
+
+            png::FrameControl control;
+            if (playback && i < playback->delays.size()) {
+                control.delay = playback->delays[i];
+            }
+            controls.push_back(control);
+        }
+        auto const file = png::joinAnimation(streams, controls, playback ? playback->play_count : 0);
+
+        wil::com_ptr<IWICStream> stream;
+        THROW_IF_FAILED(factory()->CreateStream(stream.put()));
+        auto const file_path = ext::convert<std::wstring>(path);
+        THROW_IF_FAILED(stream->InitializeFromFilename(file_path.c_str(), GENERIC_WRITE));
+        ULONG written{};
+        THROW_IF_FAILED(stream->Write(file.data(), static_cast<ULONG>(file.size()), &written));
+        if (written != file.size()) {
+            throw std::runtime_error("wrote " + std::to_string(written) + " of " + std::to_string(file.size()) + " bytes to " + path);
+        }
+    }
+
+    image::PixelFormat ImageCodec::choosePixelFormat(WICPixelFormatGUID const& pixel_format) {
+        wil::com_ptr<IWICComponentInfo> component_info;
+        THROW_IF_FAILED(factory()->CreateComponentInfo(pixel_format, component_info.put()));
+        auto const pixel_format_info = component_info.query<IWICPixelFormatInfo2>();
+
+        WICPixelFormatNumericRepresentation numeric_representation{};
+        THROW_IF_FAILED(pixel_format_info->GetNumericRepresentation(&numeric_representation));
+        if (numeric_representation == WICPixelFormatNumericRepresentationFloat) {
+            return image::PixelFormat::RGBA32F;
+        }
+
+        UINT bits_per_pixel{};
+        UINT channel_count{};
+        THROW_IF_FAILED(pixel_format_info->GetBitsPerPixel(&bits_per_pixel));
+        THROW_IF_FAILED(pixel_format_info->GetChannelCount(&channel_count));
+        if (channel_count > 0 && bits_per_pixel / channel_count > 8) {
+            return image::PixelFormat::RGBA16; // keep full precision of 16-bit sources
+        }
+
+        return image::PixelFormat::BGRA8;
+    }
+
+    wil::com_ptr<IWICBitmapDecoder> ImageCodec::openDecoder(std::string const& path, WICDecodeOptions const options) {
+        wil::com_ptr<IWICBitmapDecoder> decoder;
+        auto const file_path = ext::convert<std::wstring>(path);
+        THROW_IF_FAILED(factory()->CreateDecoderFromFilename(
+            file_path.c_str(), nullptr, GENERIC_READ, options, decoder.put()
+        ));
+        return decoder;
+    }
+
+    bool ImageCodec::decodeFrame(
+        IWICBitmapFrameDecode* const decoder_frame, image::AnyImage2D& image, image::ResourceLimits const& limits, uint64_t& used_bytes
+    ) {
+        //UINT color_context_count{};
+        //THROW_IF_FAILED(decoder_frame->GetColorContexts(
+        //    0, nullptr, &color_context_count
+        //));
+        //std::vector<IWICColorContext*> color_contexts(color_context_count);
+        //THROW_IF_FAILED(decoder_frame->GetColorContexts(
+        //    color_context_count, color_contexts.data(), &color_context_count
+        //));
+        //[[maybe_unused]] auto const auto_release_color_contexts = wil::scope_exit([&]() -> void {
+        //    for (auto const color_context : color_contexts) {
+        //        if (color_context) {
+        //            color_context->Release();
+        //        }
+        //    }
+        //    color_contexts.clear();
+        //});
+        //for (auto const color_context : color_contexts) {
+        //    WICColorContextType type{};
+        //    THROW_IF_FAILED(color_context->GetType(&type));
+        //    if (type == WICColorContextExifColorSpace) {
+        //        UINT color_space{};
+        //        THROW_IF_FAILED(color_context->GetExifColorSpace(&color_space));
+        //    }
+        //}
+
+        // convert
+
+        WICPixelFormatGUID pixel_format{};
+        THROW_IF_FAILED(decoder_frame->GetPixelFormat(&pixel_format));
+        auto const image_format{choosePixelFormat(pixel_format)};
+        auto const target_pixel_format{toWicPixelFormat(image_format)};
+
+        auto copyPixels = [&](IWICBitmapSource* bitmap) -> void {
+            UINT width{};
+            UINT height{};
+            THROW_IF_FAILED(bitmap->GetSize(&width, &height));
+
+            // the header is untrusted, check its size before allocating
+            used_bytes = image::checkImageSize(limits, width, height, image::pixelSize(image_format), used_bytes);
+            auto const byte_count = image::imageByteCount(width, height, image::pixelSize(image_format));
+            if (!byte_count || *byte_count > UINT_MAX) {
+                throw std::length_error(
+                    "image of " + std::to_string(width) + "x" + std::to_string(height) + " pixels is too large to decode"
+                );
+            }
+            image.resize(image_format, width, height);
+
+            THROW_IF_FAILED(bitmap->CopyPixels(
+                nullptr, image.pitch(), static_cast<UINT>(image.size()), image.buffer<BYTE>()
+            ));
+        };
+
+        if (pixel_format != target_pixel_format) {
+            wil::com_ptr<IWICFormatConverter> format_converter;
+            THROW_IF_FAILED(factory()->CreateFormatConverter(format_converter.put()));
+            BOOL can_convert{FALSE};
+            THROW_IF_FAILED(format_converter->CanConvert(pixel_format, target_pixel_format, &can_convert));
+            if (!can_convert) {
+                return false;
+            }
+            THROW_IF_FAILED(format_converter->Initialize(
+                decoder_frame, target_pixel_format,
+                WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom
+            ));
+            copyPixels(format_converter.get());
+        }
+        else {
+            copyPixels(decoder_frame);
+        }
+        return true;
+    }
+
+    void ImageCodec::encodeFrame(IWICBitmapEncoder* const encoder, image::AnyImage2D& image) {
+        if (image.size() > UINT_MAX) {
+            throw std::length_error(
+                "image of " + std::to_string(image.width()) + "x" + std::to_string(image.height()) + " pixels is too large to encode"
+            );
+        }
+        wil::com_ptr<IWICBitmapFrameEncode> encoder_frame;
+        wil::com_ptr<IPropertyBag2> props;
+        THROW_IF_FAILED(encoder->CreateNewFrame(encoder_frame.put(), props.put()));
+
+        THROW_IF_FAILED(encoder_frame->Initialize(props.get()));
+        THROW_IF_FAILED(encoder_frame->SetSize(image.width(), image.height()));
+        auto const source_pixel_format{toWicPixelFormat(image.format())};
+        auto target_pixel_format{source_pixel_format};
+        THROW_IF_FAILED(encoder_frame->SetPixelFormat(&target_pixel_format));
+        if (target_pixel_format == source_pixel_format) {
+            THROW_IF_FAILED(encoder_frame->WritePixels(
+                image.height(), image.pitch(), static_cast<UINT>(image.size()), image.buffer<BYTE>()
+            ));
+        }
+        else {
+            // the encoder does not support this pixel format (e.g. PNG has no float format)
+            wil::com_ptr<IWICBitmap> bitmap;
+            THROW_IF_FAILED(factory()->CreateBitmapFromMemory(
+                image.width(), image.height(), source_pixel_format,
+                image.pitch(), static_cast<UINT>(image.size()), image.buffer<BYTE>(), bitmap.put()
+            ));
+            wil::com_ptr<IWICFormatConverter> format_converter;
+            THROW_IF_FAILED(factory()->CreateFormatConverter(format_converter.put()));
+            THROW_IF_FAILED(format_converter->Initialize(
+                bitmap.get(), target_pixel_format,
+                WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom
+            ));
+            THROW_IF_FAILED(encoder_frame->WriteSource(format_converter.get(), nullptr));
+        }
+
+        THROW_IF_FAILED(encoder_frame->Commit());
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#ifndef NOMINMAX
+#define NOMINMAX_DEFINED
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <wincodec.h>
+#ifdef NOMINMAX_DEFINED
+#undef NOMINMAX_DEFINED
+#undef NOMINMAX
+#endif
+#include <wil/com.h>
+#include "image/AnyImage2D.hpp"
+#include "image/ResourceLimits.hpp"
+#include "png/Apng.hpp"
+
+namespace wic {
+    [[nodiscard]] WICPixelFormatGUID toWicPixelFormat(image::PixelFormat format);
+
+    // PNG decode and encode through WIC, the imaging factory is created on first use and kept,
+    // so one ImageCodec per thread amortizes the factory and codec setup over many files.
+    // WIC sees only the default image of an animated PNG, its frames are split and composited by png/Apng.hpp.
+    class ImageCodec {
+    public:
+        // decodes the first frame into image, returns false if WIC can't convert the source pixel format.
+        // Throws image::ResourceLimitError if the frame breaks the pixel or byte limit, checked from its size
+        // before anything is allocated, and std::length_error if it does not fit the 32 bit sizes WIC takes.
+        bool load(std::string const& path, image::AnyImage2D& image, image::ResourceLimits const& limits = {});
+
+        // decodes every frame (e.g. the pages of a TIFF), frames keeps its images so their buffers are reused,
+        // returns false if WIC can't convert the pixel format of one of them. limits.max_bytes caps all frames together.
+        // The frames of an APNG come out composited, each the full canvas as the animation shows it, their delays go
+        // to playback. Throws std::runtime_error for other frames that are only part of a canvas, e.g. those of most
+        // animated GIFs, they would be bled as images of their own.
+        bool loadFrames(
+            std::string const& path, std::vector<image::AnyImage2D>& frames, image::ResourceLimits const& limits = {},
+            png::Playback* playback = nullptr
+        );
+
+        // reads only the header, false if the pixel format can't hold transparency (e.g. PNG color type 0 or 2 without tRNS)
+        bool hasAlphaChannel(std::string const& path);
+
+        void save(std::string const& path, image::AnyImage2D& image);
+
+        // a .tif or .tiff path gets one page per frame, anything else is written as PNG, an APNG if there are several
+        // frames, timed by playback. Throws std::runtime_error if the frames of an APNG differ in pixel format
+        // or are larger than the first.
+        void saveFrames(std::string const& path, std::span<image::AnyImage2D> frames, png::Playback const* playback = nullptr);
+
+        // the container of the file at path, read from its header
+        [[nodiscard]] GUID containerFormat(std::string const& path);
+
+        // the container saveFrames writes to path, chosen by its extension
+        [[nodiscard]] static GUID outputContainerFormat(std::string const& path);
+
+        [[nodiscard]] IWICImagingFactory* factory();
+
+    private:
+        [[nodiscard]] image::PixelFormat choosePixelFormat(WICPixelFormatGUID const& pixel_format);
+
+        [[nodiscard]] wil::com_ptr<IWICBitmapDecoder> openDecoder(std::string const& path, WICDecodeOptions options);
+
+        // used_bytes holds the pixel bytes of the frames decoded before and grows by this one
+        bool decodeFrame(
+            IWICBitmapFrameDecode* decoder_frame, image::AnyImage2D& image, image::ResourceLimits const& limits, uint64_t& used_bytes
+        );
+
+        void encodeFrame(IWICBitmapEncoder* encoder, image::AnyImage2D& image);
+
+        // the frames of the APNG at path split into PNG streams, nullopt for anything else
+        [[nodiscard]] std::optional<png::Animation> readAnimation(std::string const& path);
+
+        bool loadAnimation(
+            png::Animation const& animation, std::vector<image::AnyImage2D>& frames, image::ResourceLimits const& limits,
+            png::Playback* playback
+        );
+
+        void saveAnimation(std::string const& path, std::span<image::AnyImage2D> frames, png::Playback const* playback);
+
+        wil::com_ptr<IWICImagingFactory> m_factory;
+        png::AnimationCanvas m_canvas;
+        image::AnyImage2D m_animation_frame; // a frame of an APNG before it is composited
+    };
+}
@@ -0,0 +1,154 @@
+#pragma once
+#include <variant>
+#include "image/Image2D.hpp"
+#include "image/BlockCompression.hpp"
+
+namespace image {
+    class AnyImage2D {
+    public:
+        using Variant = std::variant<Image2D<PixelBGRA8>, Image2D<PixelRGBA16>, Image2D<PixelRGBA32F>>;
+
+        [[nodiscard]] PixelFormat format() const noexcept {
+            return std::visit([](auto const& image) -> PixelFormat {
+                return std::decay_t<decltype(image)>::Traits::format;
+            }, m_image);
+        }
+
+        [[nodiscard]] uint32_t width() const noexcept {
+            return std::visit([](auto const& image) -> uint32_t { return image.width(); }, m_image);
+        }
+
+        [[nodiscard]] uint32_t pitch() const noexcept {
+            return std::visit([](auto const& image) -> uint32_t { return image.pitch(); }, m_image);
+        }
+
+        [[nodiscard]] uint32_t height() const noexcept {
+            return std::visit([](auto const& image) -> uint32_t { return image.height(); }, m_image);
+        }
+
+        [[nodiscard]] size_t size() const noexcept {
+            return std::visit([](auto const& image) -> size_t { return image.size(); }, m_image);
+        }
+
+        [[nodiscard]] uint32_t pixelSize() const noexcept {
+            return std::visit([](auto const& image) -> uint32_t { return image.pixelSize(); }, m_image);
+        }
+
+        template <typename T>
+        [[nodiscard]] T* buffer() noexcept {
+            return std::visit([](auto& image) -> T* { return image.template buffer<T>(); }, m_image);
+        }
+
+        template <typename T>
+        [[nodiscard]] T const* buffer() const noexcept {
+            return std::visit([](auto const& image) -> T const* { return image.template buffer<T>(); }, m_image);
+        }
+
+        void clear() {
+            std::visit([](auto& image) -> void { image.clear(); }, m_image);
+        }
+
+        void releaseMemory() {
+            std::visit([](auto& image) -> void { image.releaseMemory(); }, m_image);
+        }
+
+        void resize(PixelFormat const format, uint32_t const width, uint32_t const height) {
+            if (format != this->format()) {
+                switch (format) {
+                case PixelFormat::BGRA8:
+                    m_image.emplace<Image2D<PixelBGRA8>>();
+                    break;
+                case PixelFormat::RGBA16:
+                    m_image.emplace<Image2D<PixelRGBA16>>();
+                    break;
+                case PixelFormat::RGBA32F:
+                    m_image.emplace<Image2D<PixelRGBA32F>>();
+                    break;
+                }
+            }
+            std::visit([=](auto& image) -> void {
+                image.resize(width, height);
+                image.fill();
+            }, m_image);
+        }
+
+        [[nodiscard]] DirtyRegion const& dirtyRegion() const noexcept {
+            return std::visit([](auto const& image) -> DirtyRegion const& { return image.dirtyRegion(); }, m_image);
+        }
+
+        void markDirty(Rect const& rect) {
+            std::visit([&](auto& image) -> void { image.markDirty(rect); }, m_image);
+        }
+
+        void clearDirtyRegion() noexcept {
+            std::visit([](auto& image) -> void { image.clearDirtyRegion(); }, m_image);
+        }
+
+        bool doPixelBleeding(
+            float const alpha_threshold = 0.0f,
+            std::stop_token const& stop_token = {},
+            BleedingProgressCallback const& on_progress = {}
+        ) {
+            return std::visit([&](auto& image) -> bool {
+                return image.doPixelBleeding(alpha_threshold, stop_token, on_progress);
+            }, m_image);
+        }
+
+        // scratch holds at least bleedingScratchWordCount(width(), height(), kernel.traversal) words, allocated if empty
+        bool doPixelBleeding(
+            float const alpha_threshold,
+            BleedingKernel const& kernel,
+            std::span<uint64_t> const scratch,
+            std::stop_token const& stop_token = {},
+            BleedingProgressCallback const& on_progress = {},
+            std::span<uint32_t> const source_map = {}
+        ) {
+            return std::visit([&](auto& image) -> bool {
+                return image.doPixelBleeding(alpha_threshold, kernel, scratch, stop_token, on_progress, source_map);
+            }, m_image);
+        }
+
+        void applyBleedingSources(float const alpha_threshold, std::span<uint32_t const> const source_map) {
+            std::visit([&](auto& image) -> void { image.applyBleedingSources(alpha_threshold, source_map); }, m_image);
+        }
+
+        void fillTransparentPixels(float const alpha_threshold) {
+            std::visit([&](auto& image) -> void { image.fillTransparentPixels(alpha_threshold); }, m_image);
+        }
+
+        void rebleedPixels(
+            Rect const& region, float const alpha_threshold, BleedingKernel const& kernel, std::span<uint32_t> const source_map
+        ) {
+            std::visit([&](auto& image) -> void { image.rebleedPixels(region, alpha_threshold, kernel, source_map); }, m_image);
+        }
+
+        [[nodiscard]] uint64_t countTransparentPixels(float const alpha_threshold) const noexcept {
+            return std::visit([=](auto const& image) -> uint64_t { return image.countTransparentPixels(alpha_threshold); }, m_image);
+        }
+
+        void applyAlphaThreshold(float const alpha_threshold) {
+            std::visit([=](auto& image) -> void { image.applyAlphaThreshold(alpha_threshold); }, m_image);
+        }
+
+        void premultiplyAlpha() {
+            std::visit([](auto& image) -> void { image.premultiplyAlpha(); }, m_image);
+        }
+
+        BlockCompressionStats optimizeForBlockCompression(float const alpha_threshold = 0.0f) {
+            return std::visit([=](auto& image) -> BlockCompressionStats {
+                return image::optimizeForBlockCompression(image, alpha_threshold);
+            }, m_image);
+        }
+
+        [[nodiscard]] Variant& variant() noexcept {
+            return m_image;
+        }
+
+        [[nodiscard]] Variant const& variant() const noexcept {
+            return m_image;
+        }
+
+    private:
+        Variant m_image;
+    };
+}
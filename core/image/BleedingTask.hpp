@@ -0,0 +1,168 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include "image/AnyImage2D.hpp"
+
+namespace image {
+    struct BleedingOptions {
+        float alpha_threshold{0.0f};
+        BleedingKernel kernel;
+        bool optimize_for_block_compression{false};
+    };
+
+    struct BleedingResult {
+        bool completed{false};
+        std::optional<BlockCompressionStats> block_compression_stats;
+        DirtyRegion changed; // every pixel the run changed
+    };
+
+    // Runs doPixelBleeding on a worker thread. Partial results are handed to the owner through
+    // double-buffered staging: the worker copies the rects changed since a buffer was last synced
+    // into the back buffer and swaps it to the front, the owner uploads the front buffer's dirty rects.
+    class BleedingTask {
+    public:
+        static constexpr std::chrono::milliseconds preview_interval{16};
+
+        using UploadCallback = std::function<void(AnyImage2D const& image, DirtyRegion const& region)>;
+
+        void start(AnyImage2D const& source, BleedingOptions const options) {
+            m_worker = {}; // stops and joins the previous run
+            m_progress = 0.0f;
+            m_running = true;
+            m_preview_fresh = false;
+            m_result.reset();
+            m_upload_region.clear();
+            m_changed.clear();
+            m_image = source;
+            m_image.clearDirtyRegion();
+            // both staging buffers still hold pixels of an earlier run
+            Rect const all{0, 0, source.width(), source.height()};
+            m_back_pending.clear();
+            m_back_pending.add(all);
+            m_front_pending.clear();
+            m_front_pending.add(all);
+            m_worker = std::jthread([this, options](std::stop_token const stop_token) -> void {
+                run(stop_token, options);
+            });
+        }
+
+        // the worker stops after the current pass, takeResult then reports the run as not completed
+        void cancel() {
+            m_worker.request_stop();
+        }
+
+        // stops and joins the worker, drops anything it staged
+        void reset() {
+            m_worker = {};
+            m_running = false;
+            m_preview_fresh = false;
+            m_result.reset();
+            m_upload_region.clear();
+        }
+
+        [[nodiscard]] bool running() const noexcept {
+            return m_running;
+        }
+
+        [[nodiscard]] float progress() const noexcept {
+            return m_progress;
+        }
+
+        // hands the latest staged image and the region changed since the previous call to upload,
+        // returns false if nothing new was staged, the worker can't swap buffers while upload runs
+        bool uploadPreview(UploadCallback const& upload) {
+            std::scoped_lock lock(m_staging_mutex);
+            if (!m_preview_fresh) {
+                return false;
+            }
+            upload(m_staging_front, m_upload_region);
+            m_upload_region.clear();
+            m_preview_fresh = false;
+            return true;
+        }
+
+        // result of the finished run, only available once and after the final preview was uploaded,
+        // the processed image is swapped into target if the run completed
+        std::optional<BleedingResult> takeResult(AnyImage2D& target) {
+            std::scoped_lock lock(m_staging_mutex);
+            if (m_running || m_preview_fresh || !m_result) {
+                return std::nullopt;
+            }
+            if (m_result->completed) {
+                std::swap(m_image, target);
+            }
+            return std::exchange(m_result, std::nullopt);
+        }
+
+    private:
+        void run(std::stop_token const& stop_token, BleedingOptions const options) {
+            BleedingResult result;
+            auto last_preview = std::chrono::steady_clock::now();
+            result.completed = m_image.doPixelBleeding(options.alpha_threshold, options.kernel, {}, stop_token, [&](float const progress) -> void {
+                m_progress = progress;
+                auto const now = std::chrono::steady_clock::now();
+                if (now - last_preview >= preview_interval) {
+                    last_preview = now;
+                    stage();
+                }
+            });
+            if (result.completed && options.optimize_for_block_compression) {
+                result.block_compression_stats = m_image.optimizeForBlockCompression(options.alpha_threshold);
+            }
+            if (result.completed) {
+                stage();
+            }
+            result.changed = m_changed;
+            std::scoped_lock lock(m_staging_mutex);
+            m_result = result;
+            m_running = false;
+        }
+
+        void stage() {
+            DirtyRegion const changed = m_image.dirtyRegion();
+            m_image.clearDirtyRegion();
+            m_changed.add(changed);
+            if (m_staging_back.format() != m_image.format()
+                || m_staging_back.width() != m_image.width()
+                || m_staging_back.height() != m_image.height()) {
+                m_staging_back = m_image;
+                m_staging_back.clearDirtyRegion();
+            }
+            else {
+                m_back_pending.add(changed);
+                copyRegion(
+                    m_staging_back.buffer<uint8_t>(), m_staging_back.pitch(),
+                    m_image.buffer<uint8_t>(), m_image.pitch(),
+                    m_back_pending, m_image.pixelSize()
+                );
+            }
+            m_back_pending.clear();
+
+            std::scoped_lock lock(m_staging_mutex);
+            m_front_pending.add(changed); // the front buffer misses these changes until it becomes the back buffer again
+            std::swap(m_staging_back, m_staging_front);
+            std::swap(m_back_pending, m_front_pending);
+            m_upload_region.add(changed);
+            m_preview_fresh = true;
+        }
+
+        AnyImage2D m_image;
+        AnyImage2D m_staging_back;
+        AnyImage2D m_staging_front;
+        DirtyRegion m_back_pending;
+        DirtyRegion m_front_pending;
+        DirtyRegion m_upload_region;
+        DirtyRegion m_changed;
+        std::mutex m_staging_mutex;
+        bool m_preview_fresh{false};
+        std::optional<BleedingResult> m_result;
+        std::atomic<float> m_progress{0.0f};
+        std::atomic_bool m_running{false};
+        std::jthread m_worker; // declared last, joins before the buffers above are destroyed
+    };
+}
@@ -0,0 +1,185 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <execution>
+#include "image/Image2D.hpp"
+
+namespace image {
+    struct BlockCompressionStats {
+        uint32_t block_count{};
+        uint32_t opaque_block_count{};
+        uint32_t transparent_block_count{};
+        uint32_t mixed_block_count{};
+        uint32_t adjusted_texel_count{};
+    };
+
+    namespace detail {
+        struct Color3f {
+            float r{};
+            float g{};
+            float b{};
+        };
+
+        // principal axis of the opaque colors, same approach BC encoders use to pick the endpoint line
+        [[nodiscard]] inline Color3f findPrincipalAxis(Color3f const* colors, uint32_t const count, Color3f const& mean) noexcept {
+            float cov[6]{}; // rr rg rb gg gb bb
+            Color3f low{colors[0]};
+            Color3f high{colors[0]};
+            for (uint32_t i = 0; i < count; ++i) {
+                auto const r = colors[i].r - mean.r;
+                auto const g = colors[i].g - mean.g;
+                auto const b = colors[i].b - mean.b;
+                cov[0] += r * r;
+                cov[1] += r * g;
+                cov[2] += r * b;
+                cov[3] += g * g;
+                cov[4] += g * b;
+                cov[5] += b * b;
+                low = Color3f{std::min(low.r, colors[i].r), std::min(low.g, colors[i].g), std::min(low.b, colors[i].b)};
+                high = Color3f{std::max(high.r, colors[i].r), std::max(high.g, colors[i].g), std::max(high.b, colors[i].b)};
+            }
+            Color3f axis{high.r - low.r, high.g - low.g, high.b - low.b};
+            for (int i = 0; i < 8; ++i) {
+                Color3f const next{
+                    cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b,
+                    cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+                    cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b,
+                };
+                auto const length = std::sqrt(next.r * next.r + next.g * next.g + next.b * next.b);
+                if (!(length > 0.0f)) {
+                    break;
+                }
+                axis = Color3f{next.r / length, next.g / length, next.b / length};
+            }
+            return axis;
+        }
+    }
+
+    // Moves the colors of transparent texels in every 4x4 block onto the segment spanned by the
+    // opaque texels of that block, so BC3/BC7 encoders don't waste endpoint precision on them.
+    // Run it after doPixelBleeding, blocks without opaque texels are left untouched.
+    // The rects of changed blocks are added to changed if it is not null.
+    template <typename Pixel>
+    BlockCompressionStats optimizeForBlockCompression(
+        ImageView<Pixel> const& image, float const alpha_threshold, DirtyRegion* const changed
+    ) {
+        using Channel = typename PixelTraits<Pixel>::Channel;
+        constexpr uint32_t block_size = 4;
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        auto const blocks_x = (image.width + block_size - 1) / block_size;
+        auto const blocks_y = (image.height + block_size - 1) / block_size;
+
+        std::atomic_uint32_t opaque_block_count{};
+        std::atomic_uint32_t transparent_block_count{};
+        std::atomic_uint32_t mixed_block_count{};
+        std::atomic_uint32_t adjusted_texel_count{};
+
+        std::vector<Rect> row_dirty(blocks_y);
+        std::vector<uint32_t> block_rows(blocks_y);
+        std::iota(block_rows.begin(), block_rows.end(), 0u);
+        std::for_each(std::execution::par, block_rows.begin(), block_rows.end(), [&](uint32_t const block_y) -> void {
+            detail::Color3f colors[block_size * block_size]{};
+            Pixel* transparent[block_size * block_size]{};
+            BlockCompressionStats row{};
+            for (uint32_t block_x = 0; block_x < blocks_x; ++block_x) {
+                uint32_t opaque_count{};
+                uint32_t transparent_count{};
+                detail::Color3f mean{};
+                auto const x0 = block_x * block_size;
+                auto const y0 = block_y * block_size;
+                auto const x1 = std::min(x0 + block_size, image.width);
+                auto const y1 = std::min(y0 + block_size, image.height);
+                for (uint32_t y = y0; y < y1; ++y) {
+                    for (uint32_t x = x0; x < x1; ++x) {
+                        auto& px = image.pixel(x, y);
+                        if (isOpaque(px, cutoff)) {
+                            auto& color = colors[opaque_count++];
+                            color = detail::Color3f{
+                                static_cast<float>(px.r), static_cast<float>(px.g), static_cast<float>(px.b)
+                            };
+                            mean.r += color.r;
+                            mean.g += color.g;
+                            mean.b += color.b;
+                        }
+                        else {
+                            transparent[transparent_count++] = &px;
+                        }
+                    }
+                }
+                if (transparent_count == 0) {
+                    ++row.opaque_block_count;
+                    continue;
+                }
+                if (opaque_count == 0) {
+                    ++row.transparent_block_count;
+                    continue;
+                }
+                ++row.mixed_block_count;
+
+                auto const n = static_cast<float>(opaque_count);
+                mean = detail::Color3f{mean.r / n, mean.g / n, mean.b / n};
+                auto const axis = detail::findPrincipalAxis(colors, opaque_count, mean);
+                auto project = [&](float const r, float const g, float const b) -> float {
+                    return (r - mean.r) * axis.r + (g - mean.g) * axis.g + (b - mean.b) * axis.b;
+                };
+                auto t_min = project(colors[0].r, colors[0].g, colors[0].b);
+                auto t_max = t_min;
+                for (uint32_t i = 1; i < opaque_count; ++i) {
+                    auto const t = project(colors[i].r, colors[i].g, colors[i].b);
+                    t_min = std::min(t_min, t);
+                    t_max = std::max(t_max, t);
+                }
+                uint32_t adjusted_count{};
+                for (uint32_t i = 0; i < transparent_count; ++i) {
+                    auto& px = *transparent[i];
+                    auto const t = std::clamp(
+                        project(static_cast<float>(px.r), static_cast<float>(px.g), static_cast<float>(px.b)),
+                        t_min, t_max
+                    );
+                    adjusted_count += detail::setColor(
+                        px,
+                        detail::toChannel<Channel>(mean.r + axis.r * t),
+                        detail::toChannel<Channel>(mean.g + axis.g * t),
+                        detail::toChannel<Channel>(mean.b + axis.b * t)
+                    ) ? 1 : 0;
+                }
+                if (adjusted_count > 0) {
+                    row_dirty[block_y] = row_dirty[block_y].united(Rect::fromBounds(x0, y0, x1, y1));
+                }
+                row.adjusted_texel_count += adjusted_count;
+            }
+            opaque_block_count += row.opaque_block_count;
+            transparent_block_count += row.transparent_block_count;
+            mixed_block_count += row.mixed_block_count;
+            adjusted_texel_count += row.adjusted_texel_count;
+        });
+
+        if (changed) {
+            for (auto const& rect : row_dirty) {
+                changed->add(rect);
+            }
+        }
+
+        return BlockCompressionStats{
+            .block_count = blocks_x * blocks_y,
+            .opaque_block_count = opaque_block_count,
+            .transparent_block_count = transparent_block_count,
+            .mixed_block_count = mixed_block_count,
+            .adjusted_texel_count = adjusted_texel_count,
+        };
+    }
+
+    template <typename Pixel>
+    BlockCompressionStats optimizeForBlockCompression(Image2D<Pixel>& image, float const alpha_threshold = 0.0f) {
+        DirtyRegion changed;
+        auto const stats = optimizeForBlockCompression(image.view(), alpha_threshold, &changed);
+        for (auto const& rect : changed.rects()) {
+            image.markDirty(rect);
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+namespace image {
+    struct Rect {
+        uint32_t x{};
+        uint32_t y{};
+        uint32_t width{};
+        uint32_t height{};
+
+        [[nodiscard]] bool empty() const noexcept {
+            return width == 0 || height == 0;
+        }
+
+        [[nodiscard]] uint32_t right() const noexcept {
+            return x + width;
+        }
+
+        [[nodiscard]] uint32_t bottom() const noexcept {
+            return y + height;
+        }
+
+        [[nodiscard]] uint64_t area() const noexcept {
+            return static_cast<uint64_t>(width) * height;
+        }
+
+        [[nodiscard]] bool contains(Rect const& other) const noexcept {
+            return other.x >= x && other.y >= y && other.right() <= right() && other.bottom() <= bottom();
+        }
+
+        // also true for rects that only touch, merging those never grows the covered area
+        [[nodiscard]] bool touches(Rect const& other) const noexcept {
+            return other.x <= right() && x <= other.right() && other.y <= bottom() && y <= other.bottom();
+        }
+
+        [[nodiscard]] Rect united(Rect const& other) const noexcept {
+            if (empty()) {
+                return other;
+            }
+            if (other.empty()) {
+                return *this;
+            }
+            auto const left = std::min(x, other.x);
+            auto const top = std::min(y, other.y);
+            return Rect{left, top, std::max(right(), other.right()) - left, std::max(bottom(), other.bottom()) - top};
+        }
+
+        // empty if the rects do not overlap
+        [[nodiscard]] Rect intersected(Rect const& other) const noexcept {
+            return fromBounds(std::max(x, other.x), std::max(y, other.y), std::min(right(), other.right()), std::min(bottom(), other.bottom()));
+        }
+
+        [[nodiscard]] static Rect fromBounds(uint32_t const left, uint32_t const top, uint32_t const right, uint32_t const bottom) noexcept {
+            if (right <= left || bottom <= top) {
+                return {};
+            }
+            return Rect{left, top, right - left, bottom - top};
+        }
+    };
+
+    // A small set of rects covering every pixel changed since the last clear. Rects that touch are merged,
+    // past max_rect_count everything collapses into the bounding rect, uploads stay a handful of copies.
+    class DirtyRegion {
+    public:
+        static constexpr size_t max_rect_count{16};
+
+        [[nodiscard]] bool empty() const noexcept {
+            return m_rects.empty();
+        }
+
+        [[nodiscard]] std::vector<Rect> const& rects() const noexcept {
+            return m_rects;
+        }
+
+        [[nodiscard]] Rect bounds() const noexcept {
+            Rect result;
+            for (auto const& rect : m_rects) {
+                result = result.united(rect);
+            }
+            return result;
+        }
+
+        void add(Rect rect) {
+            if (rect.empty()) {
+                return;
+            }
+            for (size_t i = 0; i < m_rects.size();) {
+                if (m_rects[i].contains(rect)) {
+                    return;
+                }
+                if (m_rects[i].touches(rect)) {
+                    rect = rect.united(m_rects[i]);
+                    m_rects.erase(m_rects.begin() + static_cast<ptrdiff_t>(i));
+                    i = 0; // the grown rect may touch rects already visited
+                    continue;
+                }
+                ++i;
+            }
+            m_rects.push_back(rect);
+            if (m_rects.size() > max_rect_count) {
+                auto const all = bounds();
+                m_rects.clear();
+                m_rects.push_back(all);
+            }
+        }
+
+        void add(DirtyRegion const& other) {
+            for (auto const& rect : other.m_rects) {
+                add(rect);
+            }
+        }
+
+        void clear() noexcept {
+            m_rects.clear();
+        }
+
+    private:
+        std::vector<Rect> m_rects;
+    };
+
+    // copies the pixels inside rect between two images of the same size, both given by base pointer and row pitch
+    inline void copyRect(
+        void* const target, size_t const target_pitch,
+        void const* const source, size_t const source_pitch,
+        Rect const& rect, size_t const pixel_size
+    ) noexcept {
+        auto const row_size = rect.width * pixel_size;
+        auto const offset = rect.x * pixel_size;
+        auto target_row = static_cast<uint8_t*>(target) + rect.y * target_pitch + offset;
+        auto source_row = static_cast<uint8_t const*>(source) + rect.y * source_pitch + offset;
+        for (uint32_t y = 0; y < rect.height; ++y) {
+            std::memcpy(target_row, source_row, row_size);
+            target_row += target_pitch;
+            source_row += source_pitch;
+        }
+    }
+
+    inline void copyRegion(
+        void* const target, size_t const target_pitch,
+        void const* const source, size_t const source_pitch,
+        DirtyRegion const& region, size_t const pixel_size
+    ) noexcept {
+        for (auto const& rect : region.rects()) {
+            copyRect(target, target_pitch, source, source_pitch, rect, pixel_size);
+        }
+    }
+}
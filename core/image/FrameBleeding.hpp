@@ -0,0 +1,232 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <string>
+#include <vector>
+#include <variant>
+#include <algorithm>
+#include <execution>
+#include "image/AnyImage2D.hpp"
+#include "image/BleedingTask.hpp"
+#include "image/ResourceLimits.hpp"
+#include "image/ScratchArena.hpp"
+
+namespace image {
+    struct FrameBleedingReport {
+        uint64_t bleed_us{}; // bleeding and the block compression pass of this frame
+        bool reused{false}; // repeated the source map of the previous frame instead of searching
+        ResourceLimit limit{ResourceLimit::None}; // the limit that cut bleeding this frame short, see bleedFrames
+    };
+
+    // True if bleeding b picks the same source pixel as bleeding a for every pixel, so the source map of a can be
+    // applied to b. FirstHit only depends on which pixels are opaque, MaxAlpha also compares the alpha of every
+    // pixel, Average mixes colors and never qualifies.
+    [[nodiscard]] inline bool sameBleedingSources(
+        AnyImage2D const& a, AnyImage2D const& b, float const alpha_threshold, BleedingTieBreak const tie_break
+    ) {
+        if (tie_break == BleedingTieBreak::Average || a.format() != b.format()
+            || a.width() != b.width() || a.height() != b.height()
+            || static_cast<uint64_t>(a.width()) * a.height() >= no_bleeding_source) {
+            return false;
+        }
+        return std::visit([&](auto const& image_a) -> bool {
+            using Pixel = typename std::decay_t<decltype(image_a)>::PixelType;
+            auto const& image_b = std::get<Image2D<Pixel>>(b.variant());
+            auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+            auto const pixels_a = std::span{image_a.template buffer<Pixel>(), static_cast<size_t>(a.width()) * a.height()};
+            auto const pixels_b = image_b.template buffer<Pixel>();
+            if (tie_break == BleedingTieBreak::MaxAlpha) {
+                return std::equal(pixels_a.begin(), pixels_a.end(), pixels_b, [](Pixel const& pa, Pixel const& pb) -> bool {
+                    return pa.a == pb.a;
+                });
+            }
+            return std::equal(pixels_a.begin(), pixels_a.end(), pixels_b, [=](Pixel const& pa, Pixel const& pb) -> bool {
+                return isOpaque(pa, cutoff) == isOpaque(pb, cutoff);
+            });
+        }, a.variant());
+    }
+
+    // Bleeds the frames of an animation or a multi-page file. Frames run in parallel, a frame whose sources
+    // match the previous frame's skips the search and replays the source map of the first frame of that run,
+    // which is the common case of an animation that only changes colors inside a fixed silhouette.
+    // All scratch memory comes from arena, release it with reset once the frames are no longer needed.
+    //
+    // limits caps the job. If the frames, what arena handed out already and the scratch don't fit max_bytes, the
+    // tiled and jump flood traversals give way to the row-major and frontier ones and then frames stop replaying
+    // source maps, neither changes the result beyond the jump flood turning exact. A watchdog between the passes
+    // of every frame stops it once the job ran past max_time or the frame past max_passes, what happens then is
+    // up to limits.on_limit and is recorded in the frame's report. With LimitAction::Abort a ResourceLimitError
+    // is thrown once all frames stopped, the frames are left partially bled.
+    inline std::vector<FrameBleedingReport> bleedFrames(
+        std::span<AnyImage2D> const frames, BleedingOptions const& options, ScratchArena& arena, ResourceLimits const& limits = {}
+    ) {
+        using clock = std::chrono::steady_clock;
+        auto const start = clock::now();
+        auto const frame_count = frames.size();
+        std::vector<FrameBleedingReport> reports(frame_count);
+        std::vector<size_t> indices(frame_count);
+        std::iota(indices.begin(), indices.end(), size_t{});
+
+        std::vector<uint8_t> same_as_previous(frame_count);
+        std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t const i) -> void {
+            same_as_previous[i] = i > 0 && sameBleedingSources(
+                frames[i - 1], frames[i], options.alpha_threshold, options.kernel.tie_break
+            );
+        });
+
+        auto kernel = options.kernel;
+        bool reuse_sources{true};
+        if (limits.max_bytes != 0) {
+            uint64_t held_bytes{arena.usedBytes()};
+            for (auto const& frame : frames) {
+                held_bytes += frame.size();
+            }
+            auto const jobBytes = [&](BleedingTraversal const traversal, bool const reuse) -> uint64_t {
+                auto bytes = held_bytes;
+                for (size_t i = 0; i < frame_count; ++i) {
+                    auto const& frame = frames[i];
+                    if (reuse && same_as_previous[i]) {
+                        continue;
+                    }
+                    bytes += bleedingScratchWordCount(frame.width(), frame.height(), traversal) * sizeof(uint64_t);
+                    if (reuse && i + 1 < frame_count && same_as_previous[i + 1]) {
+                        bytes += static_cast<uint64_t>(frame.width()) * frame.height() * sizeof(uint32_t);
+                    }
+                }
+                return bytes;
+            };
+            auto const cheap_traversal = kernel.traversal == BleedingTraversal::Tiled ? BleedingTraversal::RowMajor
+                : kernel.traversal == BleedingTraversal::JumpFlood ? BleedingTraversal::Frontier
+                : kernel.traversal;
+            if (jobBytes(kernel.traversal, true) > limits.max_bytes) {
+                kernel.traversal = cheap_traversal;
+            }
+            if (jobBytes(kernel.traversal, true) > limits.max_bytes) {
+                reuse_sources = false;
+            }
+            if (jobBytes(kernel.traversal, false) > limits.max_bytes) {
+                if (limits.on_limit == LimitAction::Abort) {
+                    throw ResourceLimitError(
+                        ResourceLimit::Bytes, "bleeding needs more than the limit of " + std::to_string(limits.max_bytes) + " bytes"
+                    );
+                }
+                // without scratch for the search even a radius limit can't be bled, the fill needs none
+                std::for_each(std::execution::par, indices.begin(), indices.end(), [&](size_t const i) -> void {
+                    auto const begin = clock::now();
+                    frames[i].fillTransparentPixels(options.alpha_threshold);
+                    reports[i].limit = ResourceLimit::Bytes;
+                    reports[i].bleed_us = static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - begin).count()
+                    );
+                });
+                return reports;
+            }
+        }
+
+        // run_head[i] is the frame whose source map frame i replays, itself if it needs a search
+        std::vector<size_t> run_head(frame_count);
+        std::vector<size_t> heads;
+        std::vector<size_t> followers;
+        for (size_t i = 0; i < frame_count; ++i) {
+            run_head[i] = reuse_sources && same_as_previous[i] ? run_head[i - 1] : i;
+            (run_head[i] == i ? heads : followers).push_back(i);
+        }
+
+        // the arena is not thread safe, hand out all memory before going parallel
+        std::vector<std::span<uint64_t>> scratch(frame_count);
+        std::vector<std::span<uint32_t>> source_maps(frame_count);
+        for (auto const i : heads) {
+            auto const& frame = frames[i];
+            scratch[i] = arena.acquire<uint64_t>(
+                bleedingScratchWordCount(frame.width(), frame.height(), kernel.traversal)
+            );
+            if (i + 1 < frame_count && run_head[i + 1] == i) {
+                source_maps[i] = arena.acquire<uint32_t>(static_cast<size_t>(frame.width()) * frame.height());
+            }
+        }
+
+        auto const finish = [&](size_t const i, clock::time_point const begin) -> void {
+            if (options.optimize_for_block_compression) {
+                frames[i].optimizeForBlockCompression(options.alpha_threshold);
+            }
+            reports[i].bleed_us = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - begin).count()
+            );
+        };
+        auto const deadline = limits.max_time.count() > 0 ? start + limits.max_time : clock::time_point::max();
+        auto const watched = limits.max_time.count() > 0 || limits.max_passes != 0;
+        std::atomic_bool aborted{false};
+        std::for_each(std::execution::par, heads.begin(), heads.end(), [&](size_t const i) -> void {
+            auto const begin = clock::now();
+            std::stop_source stop;
+            auto limit = ResourceLimit::None;
+            uint32_t passes{};
+            // the watchdog, stop_token is checked before every pass so the frame ends after the pass that ran over
+            auto const watchdog = [&](float) -> void {
+                if (limits.max_passes != 0 && ++passes >= limits.max_passes) {
+                    limit = ResourceLimit::Passes;
+                }
+                else if (clock::now() >= deadline) {
+                    limit = ResourceLimit::Time;
+                }
+                else if (aborted) {
+                    limit = ResourceLimit::None; // another frame already aborted the job
+                }
+                else {
+                    return;
+                }
+                stop.request_stop();
+            };
+            auto const completed = frames[i].doPixelBleeding(
+                options.alpha_threshold, kernel, scratch[i], stop.get_token(),
+                watched ? BleedingProgressCallback{watchdog} : BleedingProgressCallback{}, source_maps[i]
+            );
+            if (!completed) {
+                reports[i].limit = limit;
+                if (limits.on_limit == LimitAction::Abort && limit != ResourceLimit::None) {
+                    aborted = true;
+                }
+                if (limits.on_limit == LimitAction::ConstantFill) {
+                    frames[i].fillTransparentPixels(options.alpha_threshold);
+                }
+            }
+            finish(i, begin);
+        });
+        // the jump flood writes its source map after the last pass, the map of a frame it did not finish is not there
+        auto const jump_flood = [&](AnyImage2D const& frame) -> bool {
+            return kernel.traversal == BleedingTraversal::JumpFlood
+                && frame.width() <= jump_flood_max_extent && frame.height() <= jump_flood_max_extent;
+        };
+        std::for_each(std::execution::par, followers.begin(), followers.end(), [&](size_t const i) -> void {
+            auto const begin = clock::now();
+            auto const head = run_head[i];
+            reports[i].limit = reports[head].limit;
+            if (reports[i].limit != ResourceLimit::None
+                && (limits.on_limit == LimitAction::ConstantFill || jump_flood(frames[head]))) {
+                if (limits.on_limit == LimitAction::ConstantFill) {
+                    frames[i].fillTransparentPixels(options.alpha_threshold);
+                }
+            }
+            else {
+                frames[i].applyBleedingSources(options.alpha_threshold, source_maps[head]);
+                reports[i].reused = true;
+            }
+            finish(i, begin);
+        });
+
+        if (aborted) {
+            auto const hit = std::ranges::find_if(reports, [](FrameBleedingReport const& report) -> bool {
+                return report.limit != ResourceLimit::None;
+            });
+            throw ResourceLimitError(
+                hit->limit, hit->limit == ResourceLimit::Passes
+                    ? "bleeding a frame needs more than the limit of " + std::to_string(limits.max_passes) + " passes"
+                    : "bleeding needs more than the limit of " + std::to_string(limits.max_time.count()) + " ms"
+            );
+        }
+        return reports;
+    }
+}
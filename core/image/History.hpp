@@ -0,0 +1,132 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <variant>
+#include <unordered_set>
+#include "image/AnyImage2D.hpp"
+#include "image/TiledSnapshot.hpp"
+
+namespace image {
+    struct HistoryMemoryUsage {
+        size_t snapshot_count{};
+        size_t tile_count{}; // distinct tiles kept alive by all snapshots
+        size_t stored_bytes{}; // bytes of those tiles
+        size_t full_copy_bytes{}; // bytes the same history would take with a full image copy per snapshot
+    };
+
+    // Undo/redo stack of tiled copy-on-write snapshots, every entry is the image state after an operation.
+    class History {
+    public:
+        using Snapshot = std::variant<TiledSnapshot<PixelBGRA8>, TiledSnapshot<PixelRGBA16>, TiledSnapshot<PixelRGBA32F>>;
+
+        struct Entry {
+            std::string label;
+            Snapshot snapshot;
+        };
+
+        // drops all entries and records image as the initial state
+        void reset(AnyImage2D const& image, std::string label) {
+            m_entries.clear();
+            m_current = 0;
+            m_entries.push_back(Entry{std::move(label), capture(image, nullptr)});
+        }
+
+        void clear() {
+            m_entries.clear();
+            m_current = 0;
+        }
+
+        // records the state after an operation and drops the redo entries,
+        // changed limits the tiles compared against the current state, nullptr compares every tile
+        void commit(AnyImage2D const& image, std::string label, DirtyRegion const* changed = nullptr) {
+            if (m_entries.empty()) {
+                reset(image, std::move(label));
+                return;
+            }
+            m_entries.resize(m_current + 1);
+            auto snapshot = capture(image, changed);
+            m_entries.push_back(Entry{std::move(label), std::move(snapshot)});
+            ++m_current;
+        }
+
+        [[nodiscard]] bool canUndo() const noexcept {
+            return m_current > 0;
+        }
+
+        [[nodiscard]] bool canRedo() const noexcept {
+            return m_current + 1 < m_entries.size();
+        }
+
+        bool undo(AnyImage2D& image) {
+            if (!canUndo()) {
+                return false;
+            }
+            moveTo(image, m_current - 1);
+            return true;
+        }
+
+        bool redo(AnyImage2D& image) {
+            if (!canRedo()) {
+                return false;
+            }
+            moveTo(image, m_current + 1);
+            return true;
+        }
+
+        [[nodiscard]] std::vector<Entry> const& entries() const noexcept {
+            return m_entries;
+        }
+
+        [[nodiscard]] size_t current() const noexcept {
+            return m_current;
+        }
+
+        [[nodiscard]] HistoryMemoryUsage memoryUsage() const {
+            HistoryMemoryUsage usage;
+            usage.snapshot_count = m_entries.size();
+            std::unordered_set<void const*> seen;
+            for (auto const& entry : m_entries) {
+                std::visit([&](auto const& snapshot) -> void {
+                    usage.full_copy_bytes += snapshot.fullBytes();
+                    for (auto const& tile : snapshot.tiles()) {
+                        if (seen.insert(tile.get()).second) {
+                            ++usage.tile_count;
+                            usage.stored_bytes += tile->size() * sizeof(typename std::decay_t<decltype(*tile)>::value_type);
+                        }
+                    }
+                }, entry.snapshot);
+            }
+            return usage;
+        }
+
+    private:
+        [[nodiscard]] Snapshot capture(AnyImage2D const& image, DirtyRegion const* changed) const {
+            return std::visit([&](auto const& typed) -> Snapshot {
+                using SnapshotType = TiledSnapshot<typename std::decay_t<decltype(typed)>::PixelType>;
+                SnapshotType const* previous{};
+                if (!m_entries.empty()) {
+                    previous = std::get_if<SnapshotType>(&m_entries[m_current].snapshot);
+                }
+                return SnapshotType::capture(typed, previous, changed);
+            }, image.variant());
+        }
+
+        void moveTo(AnyImage2D& image, size_t const index) {
+            auto const& current = m_entries[m_current].snapshot;
+            std::visit([&](auto const& target) -> void {
+                using SnapshotType = std::decay_t<decltype(target)>;
+                auto const* base = std::get_if<SnapshotType>(&current);
+                auto* typed = std::get_if<Image2D<typename SnapshotType::PixelType>>(&image.variant());
+                if (!typed) {
+                    typed = &image.variant().template emplace<Image2D<typename SnapshotType::PixelType>>();
+                    base = nullptr;
+                }
+                target.restore(*typed, base);
+            }, m_entries[index].snapshot);
+            m_current = index;
+        }
+
+        std::vector<Entry> m_entries;
+        size_t m_current{};
+    };
+}
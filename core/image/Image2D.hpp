@@ -0,0 +1,241 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stop_token>
+#include <type_traits>
+#include "image/Pixel.hpp"
+#include "image/DirtyRegion.hpp"
+#include "image/ImageView.hpp"
+#include "image/PixelBleeding.hpp"
+#include "image/IncrementalBleeding.hpp"
+
+namespace image {
+    // progress is the fraction of pixels already processed, called once per pass
+    using BleedingProgressCallback = std::function<void(float progress)>;
+
+    template <typename Pixel>
+    class Image2D {
+    public:
+        using PixelType = Pixel;
+        using Traits = PixelTraits<Pixel>;
+        using Channel = typename Traits::Channel;
+
+        [[nodiscard]] uint32_t width() const noexcept {
+            return m_width;
+        }
+
+        [[nodiscard]] uint32_t pitch() const noexcept {
+            return static_cast<uint32_t>(m_width * sizeof(Pixel));
+        }
+
+        [[nodiscard]] uint32_t height() const noexcept {
+            return m_height;
+        }
+
+        [[nodiscard]] size_t size() const noexcept {
+            return m_pixels.size() * sizeof(Pixel);
+        }
+
+        [[nodiscard]] static constexpr uint32_t pixelSize() noexcept {
+            return static_cast<uint32_t>(sizeof(Pixel));
+        }
+
+        template <typename T>
+        [[nodiscard]] T* buffer() noexcept {
+            return reinterpret_cast<T*>(m_pixels.data());
+        }
+
+        template <typename T>
+        [[nodiscard]] T const* buffer() const noexcept {
+            return reinterpret_cast<T const*>(m_pixels.data());
+        }
+
+        // keeps the pixel storage, so the next resize up to the same size does not allocate
+        void clear() {
+            m_width = 0;
+            m_height = 0;
+            m_pixels.clear();
+            m_dirty.clear();
+        }
+
+        void releaseMemory() {
+            clear();
+            m_pixels.shrink_to_fit();
+        }
+
+        // throws std::length_error if a row does not fit the 32 bit pitch or the pixels don't fit in memory,
+        // the image is left as it was in that case
+        void resize(uint32_t const width, uint32_t const height) {
+            auto const pixel_count = static_cast<uint64_t>(width) * height;
+            if (width > UINT32_MAX / sizeof(Pixel) || pixel_count > m_pixels.max_size()) {
+                throw std::length_error("image of " + std::to_string(width) + "x" + std::to_string(height) + " pixels is too large");
+            }
+            m_pixels.resize(static_cast<size_t>(pixel_count));
+            m_width = width;
+            m_height = height;
+            m_dirty.clear();
+            m_dirty.add(Rect{0, 0, width, height});
+        }
+
+        // pixels changed by processing steps since the last clearDirtyRegion
+        [[nodiscard]] DirtyRegion const& dirtyRegion() const noexcept {
+            return m_dirty;
+        }
+
+        // clipped to the image, uploads and copies of the dirty rects never reach past it
+        void markDirty(Rect const& rect) {
+            m_dirty.add(rect.intersected(Rect{0, 0, m_width, m_height}));
+        }
+
+        void clearDirtyRegion() noexcept {
+            m_dirty.clear();
+        }
+
+        void fill(Pixel const color = {}) {
+            std::ranges::fill(m_pixels, color);
+        }
+
+        [[nodiscard]] Pixel const& pixel(uint32_t const x, uint32_t const y) const {
+            return m_pixels.at(static_cast<size_t>(y) * m_width + x);
+        }
+
+        [[nodiscard]] Pixel& pixel(uint32_t const x, uint32_t const y) {
+            return m_pixels.at(static_cast<size_t>(y) * m_width + x);
+        }
+
+        // sets the alpha of pixels at or below alpha_threshold to zero
+        void applyAlphaThreshold(float const alpha_threshold) {
+            auto const cutoff = Traits::alphaCutoff(alpha_threshold);
+            transformPixels([cutoff](Pixel& color) -> bool {
+                if (isOpaque(color, cutoff) || color.a == Channel{}) {
+                    return false;
+                }
+                color.a = Channel{};
+                return true;
+            });
+        }
+
+        void premultiplyAlpha() {
+            transformPixels([](Pixel& color) -> bool {
+                if (color.a == Traits::alpha_max) {
+                    return false;
+                }
+                if constexpr (std::is_floating_point_v<Channel>) {
+                    color.r *= color.a;
+                    color.g *= color.a;
+                    color.b *= color.a;
+                }
+                else {
+                    constexpr uint32_t half = Traits::alpha_max / 2;
+                    color.r = static_cast<Channel>((uint32_t{color.r} * color.a + half) / Traits::alpha_max);
+                    color.g = static_cast<Channel>((uint32_t{color.g} * color.a + half) / Traits::alpha_max);
+                    color.b = static_cast<Channel>((uint32_t{color.b} * color.a + half) / Traits::alpha_max);
+                }
+                return true;
+            });
+        }
+
+        // pixels at or below alpha_threshold, the per row sum has no branches so it vectorizes
+        [[nodiscard]] uint64_t countTransparentPixels(float const alpha_threshold) const noexcept {
+            auto const cutoff = Traits::alphaCutoff(alpha_threshold);
+            uint64_t count{};
+            for (uint32_t y = 0; y < height(); ++y) {
+                auto const row = m_pixels.data() + static_cast<size_t>(y) * width();
+                uint32_t row_count{};
+                for (uint32_t x = 0; x < width(); ++x) {
+                    row_count += row[x].a <= cutoff ? 1u : 0u;
+                }
+                count += row_count;
+            }
+            return count;
+        }
+
+        [[nodiscard]] ImageView<Pixel> view() noexcept {
+            return ImageView<Pixel>{m_pixels.data(), m_width, m_height, pitch()};
+        }
+
+        // alpha_threshold is normalized to [0, 1], pixels at or below it take the color of the nearest opaque pixel,
+        // returns false if stopped through stop_token, the image is left partially processed in that case
+        bool doPixelBleeding(
+            float const alpha_threshold = 0.0f,
+            std::stop_token const& stop_token = {},
+            BleedingProgressCallback const& on_progress = {}
+        ) {
+            return doPixelBleeding(alpha_threshold, BleedingKernel{}, {}, stop_token, on_progress);
+        }
+
+        // scratch is caller memory of at least bleedingScratchWordCount(width(), height(), kernel.traversal) words,
+        // allocated if empty. A non-empty source_map of width() * height() entries receives where every pixel
+        // got its color from, see bleedPixels.
+        bool doPixelBleeding(
+            float const alpha_threshold,
+            BleedingKernel const& kernel,
+            std::span<uint64_t> scratch,
+            std::stop_token const& stop_token = {},
+            BleedingProgressCallback const& on_progress = {},
+            std::span<uint32_t> const source_map = {}
+        ) {
+            std::vector<uint64_t> owned_scratch;
+            if (scratch.empty()) {
+                owned_scratch.resize(bleedingScratchWordCount(width(), height(), kernel.traversal));
+                scratch = owned_scratch;
+            }
+            return bleedPixels(view(), alpha_threshold, kernel, scratch, stop_token, [&](Rect const& changed, float const progress) -> void {
+                markDirty(changed);
+                if (on_progress) {
+                    on_progress(progress);
+                }
+            }, source_map);
+        }
+
+        // repeats a bleed recorded in source_map, valid if this image has the same sources as the recorded one
+        void applyBleedingSources(float const alpha_threshold, std::span<uint32_t const> const source_map) {
+            markDirty(image::applyBleedingSources(view(), alpha_threshold, source_map));
+        }
+
+        // gives every pixel at or below alpha_threshold the mean color of the opaque pixels, see image::fillTransparentPixels
+        void fillTransparentPixels(float const alpha_threshold) {
+            markDirty(image::fillTransparentPixels(view(), alpha_threshold));
+        }
+
+        // bleeds again after the pixels in region changed, source_map comes from the last bleed and is kept up to date
+        void rebleedPixels(
+            Rect const& region, float const alpha_threshold, BleedingKernel const& kernel, std::span<uint32_t> const source_map
+        ) {
+            markDirty(image::rebleedPixels(view(), alpha_threshold, kernel, source_map, region));
+        }
+
+    private:
+        // transform returns true if it changed the pixel, the bounds of changed pixels are marked dirty
+        template <typename Transform>
+        void transformPixels(Transform&& transform) {
+            uint32_t dirty_left{width()};
+            uint32_t dirty_top{height()};
+            uint32_t dirty_right{};
+            uint32_t dirty_bottom{};
+            for (uint32_t y = 0; y < height(); ++y) {
+                auto row = m_pixels.data() + static_cast<size_t>(y) * width();
+                for (uint32_t x = 0; x < width(); ++x) {
+                    if (transform(row[x])) {
+                        dirty_left = std::min(dirty_left, x);
+                        dirty_top = std::min(dirty_top, y);
+                        dirty_right = std::max(dirty_right, x + 1);
+                        dirty_bottom = std::max(dirty_bottom, y + 1);
+                    }
+                }
+            }
+            markDirty(Rect::fromBounds(dirty_left, dirty_top, dirty_right, dirty_bottom));
+        }
+
+        std::vector<Pixel> m_pixels;
+        uint32_t m_width{};
+        uint32_t m_height{};
+        DirtyRegion m_dirty;
+    };
+}
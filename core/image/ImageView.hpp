@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "image/Pixel.hpp"
+
+namespace image {
+    // Non-owning view of pixels in caller memory, rows are stride bytes apart.
+    template <typename Pixel>
+    struct ImageView {
+        void* data{};
+        uint32_t width{};
+        uint32_t height{};
+        size_t stride{};
+
+        [[nodiscard]] Pixel* row(uint32_t const y) const noexcept {
+            return reinterpret_cast<Pixel*>(static_cast<uint8_t*>(data) + y * stride);
+        }
+
+        [[nodiscard]] Pixel& pixel(uint32_t const x, uint32_t const y) const noexcept {
+            return row(y)[x];
+        }
+    };
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "image/PixelBleeding.hpp"
+
+namespace image {
+    namespace detail {
+        // passes between two pixels, without obstacles bleeding grows squares with corner neighbors and diamonds without
+        template <BleedingConnectivity Connectivity>
+        [[nodiscard]] constexpr uint32_t passDistance(uint32_t const dx, uint32_t const dy) noexcept {
+            if constexpr (Connectivity == BleedingConnectivity::Eight) {
+                return std::max(dx, dy);
+            }
+            else {
+                return dx + dy;
+            }
+        }
+
+        // calls visit(x, y) for every image pixel at pass distance ring from rect, returns false if there was none
+        template <BleedingConnectivity Connectivity, typename Visit>
+        bool visitRing(Rect const& rect, uint32_t const ring, uint32_t const width, uint32_t const height, Visit&& visit) {
+            auto const k = static_cast<int64_t>(ring);
+            auto const left = static_cast<int64_t>(rect.x);
+            auto const top = static_cast<int64_t>(rect.y);
+            auto const right = static_cast<int64_t>(rect.right()) - 1;
+            auto const bottom = static_cast<int64_t>(rect.bottom()) - 1;
+            bool visited{false};
+            auto const visitSpan = [&](int64_t const y, int64_t const x0, int64_t const x1) -> void {
+                for (auto x = std::max<int64_t>(x0, 0); x <= std::min<int64_t>(x1, width - 1); ++x) {
+                    visit(static_cast<uint32_t>(x), static_cast<uint32_t>(y));
+                    visited = true;
+                }
+            };
+            for (auto y = std::max<int64_t>(top - k, 0); y <= std::min<int64_t>(bottom + k, height - 1); ++y) {
+                auto const dy = y < top ? top - y : y > bottom ? y - bottom : 0;
+                // columns left and right of rect at distance dx, or the full span where the ring runs along a side
+                auto const dx = Connectivity == BleedingConnectivity::Eight ? (dy == k ? -1 : k) : k - dy;
+                if (dx < 0) {
+                    visitSpan(y, left - k, right + k);
+                }
+                else if (dx == 0) {
+                    visitSpan(y, left, right);
+                }
+                else {
+                    visitSpan(y, left - dx, left - dx);
+                    visitSpan(y, right + dx, right + dx);
+                }
+            }
+            return visited;
+        }
+    }
+
+    // Bleeds again after the pixels in region were edited, in place of a full bleedPixels. source_map is the map
+    // of the last bleed of this image with the same threshold and connectivity and is updated to the edit.
+    // A pixel's pass is its distance to the opaque pixel in source_map, so the pixels an edit can reach are those
+    // no farther from region than from their source: the rings around region are walked outwards for as long as
+    // they hold such pixels. Those are bled again level by level, from the opaque pixels in region and from the
+    // untouched pixels around them, which keep their pass and color. The result is the same as a full bleed.
+    // An edit that leaves no opaque pixel behaves like a full bleed of such an image: colors stay as they are,
+    // also the ones bled from the removed pixels, and every map entry becomes no_bleeding_source.
+    // Returns the bounds of the pixels whose color changed, edited pixels are not included unless bleeding
+    // changed them again.
+    template <BleedingConnectivity Connectivity, BleedingTieBreak TieBreak, typename Pixel>
+    Rect rebleedPixels(ImageView<Pixel> const& image, float const alpha_threshold, std::span<uint32_t> const source_map, Rect region) {
+        using Accumulator = detail::SourceAccumulator<Pixel, TieBreak>;
+        constexpr auto& offsets = detail::neighbor_offsets<Connectivity>;
+        constexpr uint32_t unreached{UINT32_MAX};
+        constexpr uint32_t outside{UINT32_MAX};
+        constexpr uint32_t pending{UINT32_MAX - 1};
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        auto const width = image.width;
+        auto const height = image.height;
+        region = Rect::fromBounds(region.x, region.y, std::min(region.right(), width), std::min(region.bottom(), height));
+        if (region.empty()) {
+            return {};
+        }
+        auto const oldPass = [&](uint32_t const x, uint32_t const y) -> uint32_t {
+            auto const origin = source_map[static_cast<uint64_t>(y) * width + x];
+            if (origin == no_bleeding_source) {
+                return unreached;
+            }
+            auto const ox = origin % width;
+            auto const oy = origin / width;
+            return detail::passDistance<Connectivity>(x > ox ? x - ox : ox - x, y > oy ? y - oy : oy - y);
+        };
+
+        // pixels to bleed again
+        std::vector<Vector2i> affected;
+        uint32_t left{region.x};
+        uint32_t top{region.y};
+        uint32_t right{region.right()};
+        uint32_t bottom{region.bottom()};
+        for (uint32_t ring = 0;; ++ring) {
+            auto const count = affected.size();
+            detail::visitRing<Connectivity>(region, ring, width, height, [&](uint32_t const x, uint32_t const y) -> void {
+                if (ring == 0 || oldPass(x, y) >= ring) {
+                    affected.push_back(Vector2i{static_cast<int32_t>(x), static_cast<int32_t>(y)});
+                    left = std::min(left, x);
+                    top = std::min(top, y);
+                    right = std::max(right, x + 1);
+                    bottom = std::max(bottom, y + 1);
+                }
+            });
+            // a pixel of the next ring can only be affected if its neighbor towards region is
+            if (affected.size() == count) {
+                break;
+            }
+        }
+
+        // levels of the affected pixels and their neighbors, everything else keeps its pass
+        auto const box = Rect::fromBounds(left > 0 ? left - 1 : 0, top > 0 ? top - 1 : 0, std::min(right + 1, width), std::min(bottom + 1, height));
+        std::vector<uint32_t> levels(static_cast<size_t>(box.width) * box.height, outside);
+        auto const in_box = [&](uint32_t const x, uint32_t const y) -> bool {
+            return x - box.x < box.width && y - box.y < box.height; // wraps around left and above box
+        };
+        auto const level = [&](uint32_t const x, uint32_t const y) -> uint32_t& {
+            return levels[static_cast<size_t>(y - box.y) * box.width + (x - box.x)];
+        };
+        auto const passOf = [&](uint32_t const x, uint32_t const y) -> uint32_t {
+            if (in_box(x, y)) {
+                if (auto const l = level(x, y); l != outside) {
+                    return l == pending ? unreached : l;
+                }
+            }
+            return oldPass(x, y);
+        };
+        for (auto const& position : affected) {
+            auto const x = static_cast<uint32_t>(position.x);
+            auto const y = static_cast<uint32_t>(position.y);
+            auto const index = static_cast<uint64_t>(y) * width + x;
+            auto const opaque = isOpaque(image.pixel(x, y), cutoff);
+            level(x, y) = opaque ? 0 : pending;
+            source_map[index] = opaque ? static_cast<uint32_t>(index) : no_bleeding_source;
+        }
+
+        // first level each affected pixel is reached at from pixels that are already settled
+        std::vector<std::pair<uint32_t, Vector2i>> seeds;
+        for (auto const& position : affected) {
+            auto const x = static_cast<uint32_t>(position.x);
+            auto const y = static_cast<uint32_t>(position.y);
+            if (level(x, y) != pending) {
+                continue;
+            }
+            auto best = unreached;
+            for (auto const& offset : offsets) {
+                auto const nx = static_cast<uint32_t>(position.x + offset.x); // wraps around below 0
+                auto const ny = static_cast<uint32_t>(position.y + offset.y);
+                if (nx < width && ny < height) {
+                    best = std::min(best, passOf(nx, ny));
+                }
+            }
+            if (best != unreached) {
+                seeds.emplace_back(best + 1, position);
+            }
+        }
+        std::ranges::sort(seeds, {}, [](auto const& seed) -> uint32_t { return seed.first; });
+        affected = {};
+
+        uint32_t dirty_left{width};
+        uint32_t dirty_top{height};
+        uint32_t dirty_right{};
+        uint32_t dirty_bottom{};
+        std::vector<Vector2i> current;
+        std::vector<Vector2i> next;
+        size_t next_seed{};
+        uint32_t pass{};
+        while (next_seed < seeds.size() || !current.empty()) {
+            if (current.empty()) {
+                pass = seeds[next_seed].first;
+            }
+            for (; next_seed < seeds.size() && seeds[next_seed].first == pass; ++next_seed) {
+                current.push_back(seeds[next_seed].second);
+            }
+            auto const is_source = [&](uint64_t const index, Pixel const&) -> bool {
+                return passOf(static_cast<uint32_t>(index % width), static_cast<uint32_t>(index / width)) < pass;
+            };
+            next.clear();
+            for (auto const& position : current) {
+                auto const x = static_cast<uint32_t>(position.x);
+                auto const y = static_cast<uint32_t>(position.y);
+                if (level(x, y) != pending) {
+                    continue; // reached at a lower level or twice in this one
+                }
+                level(x, y) = pass;
+                Accumulator sources;
+                detail::gatherSources<Connectivity, true>(image, x, y, is_source, sources);
+                source_map[static_cast<uint64_t>(y) * width + x] = sources.origin(source_map);
+                if (sources.apply(image.pixel(x, y))) {
+                    dirty_left = std::min(dirty_left, x);
+                    dirty_top = std::min(dirty_top, y);
+                    dirty_right = std::max(dirty_right, x + 1);
+                    dirty_bottom = std::max(dirty_bottom, y + 1);
+                }
+                for (auto const& offset : offsets) {
+                    auto const nx = static_cast<uint32_t>(position.x + offset.x);
+                    auto const ny = static_cast<uint32_t>(position.y + offset.y);
+                    if (in_box(nx, ny) && level(nx, ny) == pending) {
+                        next.push_back(Vector2i{static_cast<int32_t>(nx), static_cast<int32_t>(ny)});
+                    }
+                }
+            }
+            std::swap(current, next);
+            ++pass;
+        }
+        return Rect::fromBounds(dirty_left, dirty_top, dirty_right, dirty_bottom);
+    }
+
+    // picks the compiled variant for kernel, the exact traversals all share it. The map of the jump flood holds
+    // seeds rather than nearest pixels, so with it the image is bled again as a whole and the map rewritten.
+    template <typename Pixel>
+    Rect rebleedPixels(
+        ImageView<Pixel> const& image, float const alpha_threshold, BleedingKernel const& kernel,
+        std::span<uint32_t> const source_map, Rect const& region
+    ) {
+        if (kernel.traversal == BleedingTraversal::JumpFlood) {
+            std::vector<uint64_t> scratch(bleedingScratchWordCount(image.width, image.height, kernel.traversal));
+            Rect changed;
+            bleedPixels(image, alpha_threshold, kernel, scratch, {}, [&](Rect const& pass_changed, float) -> void {
+                changed = changed.united(pass_changed);
+            }, source_map);
+            return changed;
+        }
+        auto run = [&]<BleedingConnectivity Connectivity>() -> Rect {
+            switch (kernel.tie_break) {
+            case BleedingTieBreak::Average:
+                return rebleedPixels<Connectivity, BleedingTieBreak::Average>(image, alpha_threshold, source_map, region);
+            case BleedingTieBreak::MaxAlpha:
+                return rebleedPixels<Connectivity, BleedingTieBreak::MaxAlpha>(image, alpha_threshold, source_map, region);
+            default:
+                return rebleedPixels<Connectivity, BleedingTieBreak::FirstHit>(image, alpha_threshold, source_map, region);
+            }
+        };
+        if (kernel.connectivity == BleedingConnectivity::Four) {
+            return run.template operator()<BleedingConnectivity::Four>();
+        }
+        return run.template operator()<BleedingConnectivity::Eight>();
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+namespace image {
+    enum class PixelFormat : uint8_t {
+        BGRA8,
+        RGBA16,
+        RGBA32F,
+    };
+
+    struct PixelBGRA8 {
+        uint8_t b{};
+        uint8_t g{};
+        uint8_t r{};
+        uint8_t a{};
+    };
+
+    struct PixelRGBA16 {
+        uint16_t r{};
+        uint16_t g{};
+        uint16_t b{};
+        uint16_t a{};
+    };
+
+    struct PixelRGBA32F {
+        float r{};
+        float g{};
+        float b{};
+        float a{};
+    };
+
+    static_assert(sizeof(PixelBGRA8) == 4);
+    static_assert(sizeof(PixelRGBA16) == 8);
+    static_assert(sizeof(PixelRGBA32F) == 16);
+
+    [[nodiscard]] constexpr uint32_t pixelSize(PixelFormat const format) noexcept {
+        switch (format) {
+        case PixelFormat::RGBA16:
+            return static_cast<uint32_t>(sizeof(PixelRGBA16));
+        case PixelFormat::RGBA32F:
+            return static_cast<uint32_t>(sizeof(PixelRGBA32F));
+        default:
+            return static_cast<uint32_t>(sizeof(PixelBGRA8));
+        }
+    }
+
+    template <typename Pixel>
+    struct PixelTraits;
+
+    template <>
+    struct PixelTraits<PixelBGRA8> {
+        using Channel = uint8_t;
+        static constexpr PixelFormat format{PixelFormat::BGRA8};
+        static constexpr Channel alpha_max{255};
+
+        // alpha_threshold is normalized to [0, 1], pixels with alpha above the cutoff are opaque
+        [[nodiscard]] static constexpr Channel alphaCutoff(float const alpha_threshold) noexcept {
+            return static_cast<Channel>(std::clamp(alpha_threshold, 0.0f, 1.0f) * 255.0f);
+        }
+    };
+
+    template <>
+    struct PixelTraits<PixelRGBA16> {
+        using Channel = uint16_t;
+        static constexpr PixelFormat format{PixelFormat::RGBA16};
+        static constexpr Channel alpha_max{65535};
+
+        [[nodiscard]] static constexpr Channel alphaCutoff(float const alpha_threshold) noexcept {
+            return static_cast<Channel>(std::clamp(alpha_threshold, 0.0f, 1.0f) * 65535.0f);
+        }
+    };
+
+    template <>
+    struct PixelTraits<PixelRGBA32F> {
+        using Channel = float;
+        static constexpr PixelFormat format{PixelFormat::RGBA32F};
+        static constexpr Channel alpha_max{1.0f};
+
+        [[nodiscard]] static constexpr Channel alphaCutoff(float const alpha_threshold) noexcept {
+            return std::clamp(alpha_threshold, 0.0f, 1.0f);
+        }
+    };
+
+    template <typename Pixel>
+    [[nodiscard]] constexpr bool isOpaque(Pixel const& pixel, typename PixelTraits<Pixel>::Channel const cutoff) noexcept {
+        return pixel.a > cutoff;
+    }
+
+    namespace detail {
+        // rounds and clamps integral channels, float channels are passed through
+        template <typename Channel>
+        [[nodiscard]] Channel toChannel(float const value) noexcept {
+            if constexpr (std::is_integral_v<Channel>) {
+                constexpr auto channel_max = static_cast<float>(std::numeric_limits<Channel>::max());
+                return static_cast<Channel>(std::clamp(value + 0.5f, 0.0f, channel_max));
+            }
+            else {
+                return static_cast<Channel>(value);
+            }
+        }
+
+        // keeps the alpha of target, returns false if the color was already the same
+        template <typename Pixel, typename Channel = typename PixelTraits<Pixel>::Channel>
+        bool setColor(Pixel& target, Channel const r, Channel const g, Channel const b) noexcept {
+            if (target.r == r && target.g == g && target.b == b) {
+                return false;
+            }
+            target.r = r;
+            target.g = g;
+            target.b = b;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,886 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <cstring>
+#include <utility>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <execution>
+#include <stop_token>
+#include "image/Pixel.hpp"
+#include "image/ImageView.hpp"
+#include "image/DirtyRegion.hpp"
+
+namespace image {
+    struct Vector2i {
+        int32_t x{};
+        int32_t y{};
+    };
+
+    enum class BleedingConnectivity : uint8_t {
+        Eight, // edge and corner neighbors
+        Four, // edge neighbors only, cheaper and grows diamonds instead of squares
+    };
+
+    // how a pixel picks its color when several neighbors are sources in the same pass
+    enum class BleedingTieBreak : uint8_t {
+        FirstHit, // first source in the fixed neighbor order
+        Average, // mean color of all sources
+        MaxAlpha, // source with the highest alpha, first one on ties
+    };
+
+    enum class BleedingTraversal : uint8_t {
+        RowMajor, // one sweep over the whole image per pass
+        Tiled, // several passes per cache-sized tile before moving on, same result
+        Frontier, // visits only the pixels next to the previous pass, seeded from the opaque boundary, same result
+        JumpFlood, // approximate, nearest opaque pixel found in log2 passes, see bleedPixelsJumpFlood
+    };
+
+    struct BleedingKernel {
+        BleedingConnectivity connectivity{BleedingConnectivity::Eight};
+        BleedingTieBreak tie_break{BleedingTieBreak::FirstHit};
+        BleedingTraversal traversal{BleedingTraversal::RowMajor};
+        uint8_t jump_flood_corrections{1}; // extra passes of the jump flood, 0 to 2 are useful
+    };
+
+    // tiles of the tiled traversal, tile and halo of pixels and stamps stay within a few hundred KiB of L2
+    template <typename Pixel>
+    inline constexpr uint32_t bleeding_tile_size{sizeof(Pixel) > 8 ? 64u : 128u};
+    // passes run inside a tile per round, also the width of the halo around it
+    inline constexpr uint32_t bleeding_tile_passes{16};
+
+    // source map entry of pixels without an origin, see bleedPixels
+    inline constexpr uint32_t no_bleeding_source{UINT32_MAX};
+    // the jump flood packs coordinates and distances into 32 bits, larger images use the frontier traversal
+    inline constexpr uint32_t jump_flood_max_extent{0x7fff};
+
+    // words of scratch memory bleedPixels needs for an image of this size,
+    // two bits per pixel row-major and frontier, one byte per pixel and tile tiled, two 32 bit seeds per pixel jump flood
+    [[nodiscard]] constexpr size_t bleedingScratchWordCount(
+        uint32_t const width, uint32_t const height, BleedingTraversal const traversal = BleedingTraversal::RowMajor
+    ) noexcept {
+        auto const pixel_count = static_cast<uint64_t>(width) * height;
+        if (traversal == BleedingTraversal::Tiled) {
+            constexpr uint32_t smallest_tile = bleeding_tile_size<PixelRGBA32F>;
+            auto const tile_count = static_cast<uint64_t>((width + smallest_tile - 1) / smallest_tile)
+                * ((height + smallest_tile - 1) / smallest_tile);
+            return (pixel_count + tile_count + 7) / 8;
+        }
+        if (traversal == BleedingTraversal::JumpFlood && width <= jump_flood_max_extent && height <= jump_flood_max_extent) {
+            return std::max<uint64_t>(pixel_count, 2 * ((pixel_count + 63) / 64));
+        }
+        return 2 * ((pixel_count + 63) / 64);
+    }
+
+    namespace detail {
+        class BitSpan {
+        public:
+            BitSpan(uint64_t* const words, size_t const word_count) noexcept : m_words(words), m_word_count(word_count) {}
+
+            [[nodiscard]] bool get(uint64_t const index) const noexcept {
+                return (m_words[index >> 6] >> (index & 63)) & 1;
+            }
+
+            void set(uint64_t const index) const noexcept {
+                m_words[index >> 6] |= uint64_t{1} << (index & 63);
+            }
+
+            void reset() const noexcept {
+                std::fill_n(m_words, m_word_count, uint64_t{});
+            }
+
+            // moves every bit of other into this one and clears other
+            void take(BitSpan const& other) const noexcept {
+                for (size_t i = 0; i < m_word_count; ++i) {
+                    m_words[i] |= other.m_words[i];
+                    other.m_words[i] = 0;
+                }
+            }
+
+        private:
+            uint64_t* m_words;
+            size_t m_word_count;
+        };
+
+        template <BleedingConnectivity Connectivity>
+        inline constexpr auto neighbor_offsets = [] {
+            constexpr std::array<Vector2i, 8> all{
+                Vector2i{1, 0},
+                Vector2i{0, 1},
+                Vector2i{-1, 0},
+                Vector2i{0, -1},
+                Vector2i{1, 1},
+                Vector2i{-1, 1},
+                Vector2i{-1, -1},
+                Vector2i{1, -1},
+            };
+            constexpr size_t count = Connectivity == BleedingConnectivity::Four ? 4 : 8;
+            std::array<Vector2i, count> offsets{};
+            std::copy_n(all.begin(), count, offsets.begin());
+            return offsets;
+        }();
+
+        template <typename Pixel, BleedingTieBreak TieBreak>
+        class SourceAccumulator;
+
+        template <typename Pixel>
+        class SourceAccumulator<Pixel, BleedingTieBreak::FirstHit> {
+        public:
+            static constexpr bool stops_at_first{true};
+
+            void add(uint64_t const index, Pixel const& source) noexcept {
+                m_index = index;
+                m_source = &source;
+            }
+
+            // the opaque pixel the color comes from, looked up through the source map of earlier passes
+            [[nodiscard]] uint32_t origin(std::span<uint32_t const> const source_map) const noexcept {
+                return source_map[m_index];
+            }
+
+            [[nodiscard]] bool empty() const noexcept {
+                return !m_source;
+            }
+
+            // returns false if target already had the color
+            bool apply(Pixel& target) const noexcept {
+                return setColor(target, m_source->r, m_source->g, m_source->b);
+            }
+
+        private:
+            uint64_t m_index{};
+            Pixel const* m_source{};
+        };
+
+        template <typename Pixel>
+        class SourceAccumulator<Pixel, BleedingTieBreak::Average> {
+        public:
+            static constexpr bool stops_at_first{false};
+
+            void add(uint64_t const index, Pixel const& source) noexcept {
+                if (m_count == 0) {
+                    m_first = index;
+                }
+                m_r += static_cast<float>(source.r);
+                m_g += static_cast<float>(source.g);
+                m_b += static_cast<float>(source.b);
+                ++m_count;
+            }
+
+            [[nodiscard]] bool empty() const noexcept {
+                return m_count == 0;
+            }
+
+            // a mix of several colors has no single origin, the first source's one is at the same distance
+            [[nodiscard]] uint32_t origin(std::span<uint32_t const> const source_map) const noexcept {
+                return source_map[m_first];
+            }
+
+            bool apply(Pixel& target) const noexcept {
+                using Channel = typename PixelTraits<Pixel>::Channel;
+                auto const n = static_cast<float>(m_count);
+                return setColor(target, toChannel<Channel>(m_r / n), toChannel<Channel>(m_g / n), toChannel<Channel>(m_b / n));
+            }
+
+        private:
+            float m_r{};
+            float m_g{};
+            float m_b{};
+            uint32_t m_count{};
+            uint64_t m_first{};
+        };
+
+        template <typename Pixel>
+        class SourceAccumulator<Pixel, BleedingTieBreak::MaxAlpha> {
+        public:
+            static constexpr bool stops_at_first{false};
+
+            void add(uint64_t const index, Pixel const& source) noexcept {
+                if (!m_source || source.a > m_source->a) {
+                    m_index = index;
+                    m_source = &source;
+                }
+            }
+
+            [[nodiscard]] uint32_t origin(std::span<uint32_t const> const source_map) const noexcept {
+                return source_map[m_index];
+            }
+
+            [[nodiscard]] bool empty() const noexcept {
+                return !m_source;
+            }
+
+            // returns false if target already had the color
+            bool apply(Pixel& target) const noexcept {
+                return setColor(target, m_source->r, m_source->g, m_source->b);
+            }
+
+        private:
+            uint64_t m_index{};
+            Pixel const* m_source{};
+        };
+
+        // Feeds every neighbor is_source(index, pixel) accepts into accumulator, unrolled over the offsets of
+        // Connectivity. Checked handles pixels on the image border, interior pixels skip the tests.
+        template <BleedingConnectivity Connectivity, bool Checked, typename Pixel, typename IsSource, typename Accumulator>
+        void gatherSources(
+            ImageView<Pixel> const& image, uint32_t const x, uint32_t const y,
+            IsSource const& is_source, Accumulator& accumulator
+        ) noexcept {
+            constexpr auto& offsets = neighbor_offsets<Connectivity>;
+            auto const index = static_cast<uint64_t>(y) * image.width + x;
+            auto visit = [&]<size_t I>() -> bool {
+                constexpr auto offset = offsets[I];
+                if constexpr (Checked) {
+                    if ((offset.x == -1 && x == 0) || (offset.x == 1 && x == image.width - 1)
+                        || (offset.y == -1 && y == 0) || (offset.y == 1 && y == image.height - 1)) {
+                        return false; // out of bounds
+                    }
+                }
+                auto const& px = image.pixel(x + offset.x, y + offset.y);
+                auto const neighbor = index + static_cast<int64_t>(offset.y) * image.width + offset.x;
+                if (!is_source(neighbor, px)) {
+                    return false;
+                }
+                accumulator.add(neighbor, px);
+                return Accumulator::stops_at_first;
+            };
+            [&]<size_t... I>(std::index_sequence<I...>) -> void {
+                (visit.template operator()<I>() || ...);
+            }(std::make_index_sequence<offsets.size()>{});
+        }
+    }
+
+    // Bleeds image in place, ring by ring. A pixel filled in the current pass only becomes a source in the next one,
+    // which is tracked by two bitmaps in scratch instead of a copy of the image, so the only memory needed is
+    // bleedingScratchWordCount words. on_pass(Rect changed, float progress) is called after every pass,
+    // returns false if stopped through stop_token, the image is left partially processed in that case.
+    template <BleedingConnectivity Connectivity, BleedingTieBreak TieBreak, typename Pixel, typename OnPass>
+    bool bleedPixelsRowMajor(
+        ImageView<Pixel> const& image, float const alpha_threshold, std::span<uint64_t> const scratch,
+        std::stop_token const& stop_token, OnPass&& on_pass, std::span<uint32_t> const source_map = {}
+    ) {
+        using Accumulator = detail::SourceAccumulator<Pixel, TieBreak>;
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        auto const word_count = bleedingScratchWordCount(image.width, image.height) / 2;
+        detail::BitSpan const processed{scratch.data(), word_count};
+        detail::BitSpan const fresh{scratch.data() + word_count, word_count};
+        processed.reset();
+        fresh.reset();
+        auto const pixel_count = static_cast<uint64_t>(image.width) * image.height;
+        // transparent pixels and pixels filled in the current pass are not sources yet
+        auto const is_source = [&](uint64_t const index, Pixel const& px) -> bool {
+            return processed.get(index) || isOpaque(px, cutoff);
+        };
+        // opaque neighbors later in the row are sources before the pass reaches them
+        if (!source_map.empty()) {
+            for (uint32_t y = 0; y < image.height; ++y) {
+                auto const row = image.row(y);
+                auto const row_index = static_cast<uint64_t>(y) * image.width;
+                for (uint32_t x = 0; x < image.width; ++x) {
+                    auto const index = row_index + x;
+                    source_map[index] = isOpaque(row[x], cutoff) ? static_cast<uint32_t>(index) : no_bleeding_source;
+                }
+            }
+        }
+        uint64_t processed_count{};
+        uint64_t processed_before{};
+        size_t miss_count{};
+        do {
+            if (stop_token.stop_requested()) {
+                return false;
+            }
+            processed_before = processed_count;
+            miss_count = 0;
+            uint32_t dirty_left{image.width};
+            uint32_t dirty_top{image.height};
+            uint32_t dirty_right{};
+            uint32_t dirty_bottom{};
+            for (uint32_t y = 0; y < image.height; ++y) {
+                auto const row = image.row(y);
+                auto const row_index = static_cast<uint64_t>(y) * image.width;
+                auto const interior_row = y > 0 && y + 1 < image.height;
+                for (uint32_t x = 0; x < image.width; ++x) {
+                    if (processed.get(row_index + x)) {
+                        continue;
+                    }
+                    auto& color = row[x];
+                    if (isOpaque(color, cutoff)) {
+                        fresh.set(row_index + x);
+                        ++processed_count;
+                        continue;
+                    }
+                    Accumulator sources;
+                    if (interior_row && x > 0 && x + 1 < image.width) {
+                        detail::gatherSources<Connectivity, false>(image, x, y, is_source, sources);
+                    }
+                    else {
+                        detail::gatherSources<Connectivity, true>(image, x, y, is_source, sources);
+                    }
+                    if (sources.empty()) {
+                        ++miss_count;
+                        continue;
+                    }
+                    fresh.set(row_index + x);
+                    ++processed_count;
+                    if (!source_map.empty()) {
+                        source_map[row_index + x] = sources.origin(source_map);
+                    }
+                    if (!sources.apply(color)) {
+                        continue; // already had the color, e.g. bled before
+                    }
+                    dirty_left = std::min(dirty_left, x);
+                    dirty_top = std::min(dirty_top, y);
+                    dirty_right = std::max(dirty_right, x + 1);
+                    dirty_bottom = std::max(dirty_bottom, y + 1);
+                }
+            }
+            processed.take(fresh);
+            on_pass(
+                Rect::fromBounds(dirty_left, dirty_top, dirty_right, dirty_bottom),
+                static_cast<float>(static_cast<double>(processed_count) / static_cast<double>(pixel_count))
+            );
+        }
+        // a pass that filled nothing leaves misses only in an image without any opaque pixel
+        while (miss_count > 0 && processed_count > processed_before);
+        return true;
+    }
+
+    // Same result as bleedPixelsRowMajor with temporal blocking: every round runs bleeding_tile_passes passes
+    // tile by tile, each over the tile grown by a halo that shrinks by one pixel per pass, so a tile's pixels and
+    // their neighbors stay in cache for all passes of the round. Each pixel records in scratch the pass of the round
+    // that filled it, a neighbor is a source when its stamp is below the current pass. Stamps are exact wherever
+    // they are set, so a tile can fill halo pixels of tiles that come later and reads those of tiles before it.
+    // Tiles without unfilled pixels are skipped, on_pass is called once per round.
+    template <BleedingConnectivity Connectivity, BleedingTieBreak TieBreak, typename Pixel, typename OnPass>
+    bool bleedPixelsTiled(
+        ImageView<Pixel> const& image, float const alpha_threshold, std::span<uint64_t> const scratch,
+        std::stop_token const& stop_token, OnPass&& on_pass, std::span<uint32_t> const source_map = {}
+    ) {
+        using Accumulator = detail::SourceAccumulator<Pixel, TieBreak>;
+        constexpr uint8_t before_round{0};
+        constexpr uint8_t unfilled{0xff};
+        constexpr auto tile_size = bleeding_tile_size<Pixel>;
+        constexpr auto halo = bleeding_tile_passes;
+        static_assert(halo < unfilled);
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        auto const width = image.width;
+        auto const height = image.height;
+        auto const pixel_count = static_cast<uint64_t>(width) * height;
+        auto const tiles_x = (width + tile_size - 1) / tile_size;
+        auto const tiles_y = (height + tile_size - 1) / tile_size;
+        auto const stamps = reinterpret_cast<uint8_t*>(scratch.data());
+        auto const tile_done = stamps + pixel_count;
+
+        uint64_t processed_count{};
+        for (uint32_t y = 0; y < height; ++y) {
+            auto const row = image.row(y);
+            for (uint32_t x = 0; x < width; ++x) {
+                auto const index = static_cast<uint64_t>(y) * width + x;
+                auto const opaque = isOpaque(row[x], cutoff);
+                stamps[index] = opaque ? before_round : unfilled;
+                processed_count += opaque ? 1 : 0;
+                if (!source_map.empty()) {
+                    source_map[index] = opaque ? static_cast<uint32_t>(index) : no_bleeding_source;
+                }
+            }
+        }
+        std::fill_n(tile_done, static_cast<size_t>(tiles_x) * tiles_y, uint8_t{0});
+
+        // without any opaque pixel nothing can be filled
+        while (processed_count > 0 && processed_count < pixel_count) {
+            if (stop_token.stop_requested()) {
+                return false;
+            }
+            uint32_t dirty_left{width};
+            uint32_t dirty_top{height};
+            uint32_t dirty_right{};
+            uint32_t dirty_bottom{};
+            for (uint32_t tile_y = 0; tile_y < tiles_y; ++tile_y) {
+                for (uint32_t tile_x = 0; tile_x < tiles_x; ++tile_x) {
+                    auto& done = tile_done[static_cast<size_t>(tile_y) * tiles_x + tile_x];
+                    if (done) {
+                        continue;
+                    }
+                    auto const x0 = tile_x * tile_size;
+                    auto const y0 = tile_y * tile_size;
+                    auto const x1 = std::min(x0 + tile_size, width);
+                    auto const y1 = std::min(y0 + tile_size, height);
+                    for (uint8_t pass = 1; pass <= halo; ++pass) {
+                        auto const grow = halo - pass;
+                        auto const left = x0 > grow ? x0 - grow : 0;
+                        auto const top = y0 > grow ? y0 - grow : 0;
+                        auto const right = std::min(x1 + grow, width);
+                        auto const bottom = std::min(y1 + grow, height);
+                        auto const is_source = [stamps, pass](uint64_t const index, Pixel const&) -> bool {
+                            return stamps[index] < pass;
+                        };
+                        for (uint32_t y = top; y < bottom; ++y) {
+                            auto const row = image.row(y);
+                            auto const row_index = static_cast<uint64_t>(y) * width;
+                            auto const interior_row = y > 0 && y + 1 < height;
+                            for (uint32_t x = left; x < right; ++x) {
+                                if (stamps[row_index + x] != unfilled) {
+                                    continue;
+                                }
+                                Accumulator sources;
+                                if (interior_row && x > 0 && x + 1 < width) {
+                                    detail::gatherSources<Connectivity, false>(image, x, y, is_source, sources);
+                                }
+                                else {
+                                    detail::gatherSources<Connectivity, true>(image, x, y, is_source, sources);
+                                }
+                                if (sources.empty()) {
+                                    continue;
+                                }
+                                stamps[row_index + x] = pass;
+                                ++processed_count;
+                                if (!source_map.empty()) {
+                                    source_map[row_index + x] = sources.origin(source_map);
+                                }
+                                if (!sources.apply(row[x])) {
+                                    continue;
+                                }
+                                dirty_left = std::min(dirty_left, x);
+                                dirty_top = std::min(dirty_top, y);
+                                dirty_right = std::max(dirty_right, x + 1);
+                                dirty_bottom = std::max(dirty_bottom, y + 1);
+                            }
+                        }
+                    }
+                    done = 1;
+                    for (uint32_t y = y0; y < y1 && done; ++y) {
+                        auto const row_stamps = stamps + static_cast<uint64_t>(y) * width;
+                        done = std::find(row_stamps + x0, row_stamps + x1, unfilled) == row_stamps + x1;
+                    }
+                }
+            }
+            // every pass of this round is before the next one
+            for (uint64_t i = 0; i < pixel_count; ++i) {
+                stamps[i] = stamps[i] == unfilled ? unfilled : before_round;
+            }
+            on_pass(
+                Rect::fromBounds(dirty_left, dirty_top, dirty_right, dirty_bottom),
+                static_cast<float>(static_cast<double>(processed_count) / static_cast<double>(pixel_count))
+            );
+        }
+        return true;
+    }
+
+    // horizontal run of pixels in a row
+    struct BleedingRun {
+        uint32_t x{};
+        uint32_t y{};
+        uint32_t length{};
+    };
+
+    // Appends the pixels of region at or below alpha_threshold that have an opaque neighbor inside the image to runs,
+    // row by row, and returns the number of opaque pixels in region. Each row is turned into a byte mask and dilated
+    // with branch-free loops the compiler vectorizes, runs are read from the mask eight bytes at a time, so the scan
+    // streams over region once and the output grows with the length of the opaque boundary instead of the area.
+    template <BleedingConnectivity Connectivity, typename Pixel>
+    uint64_t findBleedingEdges(
+        ImageView<Pixel> const& image, float const alpha_threshold, Rect const& region, std::vector<BleedingRun>& runs
+    ) {
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        // masks cover region plus one pixel on either side, zero outside the image
+        auto const span = static_cast<size_t>(region.width) + 2;
+        std::vector<uint8_t> masks(4 * span + 8);
+        auto above = masks.data();
+        auto current = above + span;
+        auto below = current + span;
+        auto const edges = below + span; // 8 spare bytes for the word reads
+        auto const load = [&](uint8_t* const mask, int64_t const y) -> void {
+            std::fill_n(mask, span, uint8_t{});
+            if (y < 0 || y >= image.height) {
+                return;
+            }
+            auto const row = image.row(static_cast<uint32_t>(y));
+            auto const begin = region.x > 0 ? region.x - 1 : 0u;
+            auto const end = std::min(region.right() + 1, image.width);
+            for (auto x = begin; x < end; ++x) {
+                mask[x + 1 - region.x] = isOpaque(row[x], cutoff) ? 1 : 0;
+            }
+        };
+        load(current, static_cast<int64_t>(region.y) - 1);
+        load(below, region.y);
+        uint64_t opaque_count{};
+        for (auto y = region.y; y < region.bottom(); ++y) {
+            std::swap(above, current);
+            std::swap(current, below);
+            load(below, static_cast<int64_t>(y) + 1);
+            uint32_t row_opaque{};
+            for (size_t m = 1; m + 1 < span; ++m) {
+                uint8_t near = current[m - 1] | current[m + 1] | above[m] | below[m];
+                if constexpr (Connectivity == BleedingConnectivity::Eight) {
+                    near |= above[m - 1] | above[m + 1] | below[m - 1] | below[m + 1];
+                }
+                edges[m - 1] = near & (current[m] ^ 1);
+                row_opaque += current[m];
+            }
+            opaque_count += row_opaque;
+            for (uint32_t x = 0; x < region.width;) {
+                uint64_t word{};
+                std::memcpy(&word, edges + x, sizeof(word));
+                if (word == 0) {
+                    x += 8; // the spare bytes read past the row are zero
+                    continue;
+                }
+                if (!edges[x]) {
+                    ++x;
+                    continue;
+                }
+                auto const begin = x;
+                while (x < region.width && edges[x]) {
+                    ++x;
+                }
+                runs.push_back(BleedingRun{region.x + begin, y, x - begin});
+            }
+        }
+        return opaque_count;
+    }
+
+    // Same result as bleedPixelsRowMajor without sweeping the image: the first pass fills the runs of
+    // findBleedingEdges, every later pass the unprocessed neighbors of the pixels filled by the one before, which
+    // are exactly the pixels that get their first source. Work and the pass lists grow with the pixels filled, so
+    // sprites with a lot of empty space bleed in time proportional to what is bled, not to passes times area.
+    // The pass lists are allocated, scratch holds the processed and queued bitmaps.
+    template <BleedingConnectivity Connectivity, BleedingTieBreak TieBreak, typename Pixel, typename OnPass>
+    bool bleedPixelsFrontier(
+        ImageView<Pixel> const& image, float const alpha_threshold, std::span<uint64_t> const scratch,
+        std::stop_token const& stop_token, OnPass&& on_pass, std::span<uint32_t> const source_map = {}
+    ) {
+        using Accumulator = detail::SourceAccumulator<Pixel, TieBreak>;
+        constexpr auto& offsets = detail::neighbor_offsets<Connectivity>;
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        auto const width = image.width;
+        auto const height = image.height;
+        auto const word_count = bleedingScratchWordCount(width, height) / 2;
+        detail::BitSpan const processed{scratch.data(), word_count};
+        detail::BitSpan const queued{scratch.data() + word_count, word_count};
+        processed.reset();
+        queued.reset();
+        auto const pixel_count = static_cast<uint64_t>(width) * height;
+        auto const is_source = [&](uint64_t const index, Pixel const& px) -> bool {
+            return processed.get(index) || isOpaque(px, cutoff);
+        };
+        if (!source_map.empty()) {
+            for (uint32_t y = 0; y < height; ++y) {
+                auto const row = image.row(y);
+                auto const row_index = static_cast<uint64_t>(y) * width;
+                for (uint32_t x = 0; x < width; ++x) {
+                    auto const index = row_index + x;
+                    source_map[index] = isOpaque(row[x], cutoff) ? static_cast<uint32_t>(index) : no_bleeding_source;
+                }
+            }
+        }
+
+        std::vector<BleedingRun> runs;
+        uint64_t processed_count = findBleedingEdges<Connectivity>(image, alpha_threshold, Rect{0, 0, width, height}, runs);
+        std::vector<uint64_t> current;
+        std::vector<uint64_t> next;
+        for (auto const& run : runs) {
+            auto const row_index = static_cast<uint64_t>(run.y) * width;
+            for (auto x = run.x; x < run.x + run.length; ++x) {
+                queued.set(row_index + x);
+                current.push_back(row_index + x);
+            }
+        }
+        runs = {};
+
+        while (!current.empty()) {
+            if (stop_token.stop_requested()) {
+                return false;
+            }
+            uint32_t dirty_left{width};
+            uint32_t dirty_top{height};
+            uint32_t dirty_right{};
+            uint32_t dirty_bottom{};
+            for (auto const index : current) {
+                auto const x = static_cast<uint32_t>(index % width);
+                auto const y = static_cast<uint32_t>(index / width);
+                Accumulator sources;
+                if (y > 0 && y + 1 < height && x > 0 && x + 1 < width) {
+                    detail::gatherSources<Connectivity, false>(image, x, y, is_source, sources);
+                }
+                else {
+                    detail::gatherSources<Connectivity, true>(image, x, y, is_source, sources);
+                }
+                if (!source_map.empty()) {
+                    source_map[index] = sources.origin(source_map);
+                }
+                if (!sources.apply(image.pixel(x, y))) {
+                    continue;
+                }
+                dirty_left = std::min(dirty_left, x);
+                dirty_top = std::min(dirty_top, y);
+                dirty_right = std::max(dirty_right, x + 1);
+                dirty_bottom = std::max(dirty_bottom, y + 1);
+            }
+            next.clear();
+            for (auto const index : current) {
+                processed.set(index);
+                auto const x = static_cast<int64_t>(index % width);
+                auto const y = static_cast<int64_t>(index / width);
+                for (auto const& offset : offsets) {
+                    auto const nx = x + offset.x;
+                    auto const ny = y + offset.y;
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+                        continue;
+                    }
+                    auto const neighbor = static_cast<uint64_t>(ny) * width + static_cast<uint64_t>(nx);
+                    if (queued.get(neighbor) || isOpaque(image.pixel(static_cast<uint32_t>(nx), static_cast<uint32_t>(ny)), cutoff)) {
+                        continue;
+                    }
+                    queued.set(neighbor);
+                    next.push_back(neighbor);
+                }
+            }
+            processed_count += current.size();
+            std::swap(current, next);
+            on_pass(
+                Rect::fromBounds(dirty_left, dirty_top, dirty_right, dirty_bottom),
+                static_cast<float>(static_cast<double>(processed_count) / static_cast<double>(pixel_count))
+            );
+        }
+        return true;
+    }
+
+    // recolors every pixel at or below alpha_threshold from its entry in source_map, returns the bounds of changed pixels
+    template <typename Pixel>
+    Rect applyBleedingSources(ImageView<Pixel> const& image, float const alpha_threshold, std::span<uint32_t const> const source_map) {
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        uint32_t dirty_left{image.width};
+        uint32_t dirty_top{image.height};
+        uint32_t dirty_right{};
+        uint32_t dirty_bottom{};
+        for (uint32_t y = 0; y < image.height; ++y) {
+            auto const row = image.row(y);
+            auto const row_index = static_cast<uint64_t>(y) * image.width;
+            for (uint32_t x = 0; x < image.width; ++x) {
+                auto& color = row[x];
+                auto const origin = source_map[row_index + x];
+                if (isOpaque(color, cutoff) || origin == no_bleeding_source) {
+                    continue;
+                }
+                auto const& source = image.pixel(origin % image.width, origin / image.width);
+                if (!detail::setColor(color, source.r, source.g, source.b)) {
+                    continue;
+                }
+                dirty_left = std::min(dirty_left, x);
+                dirty_top = std::min(dirty_top, y);
+                dirty_right = std::max(dirty_right, x + 1);
+                dirty_bottom = std::max(dirty_bottom, y + 1);
+            }
+        }
+        return Rect::fromBounds(dirty_left, dirty_top, dirty_right, dirty_bottom);
+    }
+
+    // Colors every pixel at or below alpha_threshold with the mean color of the opaque pixels and keeps its alpha,
+    // the fallback when bleeding is cut off or can't get its scratch memory. Two sweeps and no scratch, an image
+    // without an opaque pixel is left as it is. Returns the bounds of changed pixels.
+    template <typename Pixel>
+    Rect fillTransparentPixels(ImageView<Pixel> const& image, float const alpha_threshold) {
+        using Channel = typename PixelTraits<Pixel>::Channel;
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        double sum_r{};
+        double sum_g{};
+        double sum_b{};
+        uint64_t opaque_count{};
+        for (uint32_t y = 0; y < image.height; ++y) {
+            auto const row = image.row(y);
+            for (uint32_t x = 0; x < image.width; ++x) {
+                if (isOpaque(row[x], cutoff)) {
+                    sum_r += static_cast<double>(row[x].r);
+                    sum_g += static_cast<double>(row[x].g);
+                    sum_b += static_cast<double>(row[x].b);
+                    ++opaque_count;
+                }
+            }
+        }
+        if (opaque_count == 0) {
+            return {};
+        }
+        auto const n = static_cast<double>(opaque_count);
+        auto const r = detail::toChannel<Channel>(static_cast<float>(sum_r / n));
+        auto const g = detail::toChannel<Channel>(static_cast<float>(sum_g / n));
+        auto const b = detail::toChannel<Channel>(static_cast<float>(sum_b / n));
+        uint32_t dirty_left{image.width};
+        uint32_t dirty_top{image.height};
+        uint32_t dirty_right{};
+        uint32_t dirty_bottom{};
+        for (uint32_t y = 0; y < image.height; ++y) {
+            auto const row = image.row(y);
+            for (uint32_t x = 0; x < image.width; ++x) {
+                if (isOpaque(row[x], cutoff) || !detail::setColor(row[x], r, g, b)) {
+                    continue;
+                }
+                dirty_left = std::min(dirty_left, x);
+                dirty_top = std::min(dirty_top, y);
+                dirty_right = std::max(dirty_right, x + 1);
+                dirty_bottom = std::max(dirty_bottom, y + 1);
+            }
+        }
+        return Rect::fromBounds(dirty_left, dirty_top, dirty_right, dirty_bottom);
+    }
+
+    // Approximate bleed in the manner of a GPU jump flood. Every pixel keeps a seed, the nearest opaque pixel it has
+    // seen, and each pass offers it the seeds of the pixels step away in the eight directions, with step halving
+    // from half the image size down to 1, so a source crosses any gap in log2(max(width, height)) passes instead of
+    // one pass per pixel of the gap. Distances use the metric the exact traversals grow in, Chebyshev with corner
+    // neighbors and Manhattan without, ties go to the seed nearer in Euclidean distance. Where the paths of two seeds cross a pixel
+    // can end up with one that is not the nearest, the corrections extra passes with steps 2^(corrections - 1) down
+    // to 1 repair most of those. A final sweep colors every pixel from its seed, tie_break does not apply.
+    // Rows of a pass are independent and run in parallel over branch-free loops, scratch holds the seeds of the
+    // previous and the current pass, on_pass is called with an empty rect after each pass and with the changes at
+    // the end. Images wider or taller than jump_flood_max_extent are not supported.
+    template <BleedingConnectivity Connectivity, typename Pixel, typename OnPass>
+    bool bleedPixelsJumpFlood(
+        ImageView<Pixel> const& image, float const alpha_threshold, uint32_t const corrections, std::span<uint64_t> const scratch,
+        std::stop_token const& stop_token, OnPass&& on_pass, std::span<uint32_t> const source_map = {}
+    ) {
+        constexpr uint32_t no_seed{UINT32_MAX};
+        constexpr uint32_t band_height{16};
+        auto const cutoff = PixelTraits<Pixel>::alphaCutoff(alpha_threshold);
+        auto const width = image.width;
+        auto const height = image.height;
+        auto const pixel_count = static_cast<size_t>(width) * height;
+        // seeds are x << 16 | y
+        auto seeds = reinterpret_cast<uint32_t*>(scratch.data());
+        auto next_seeds = seeds + pixel_count;
+        size_t opaque_count{};
+        for (uint32_t y = 0; y < height; ++y) {
+            auto const row = image.row(y);
+            auto const row_seeds = seeds + static_cast<size_t>(y) * width;
+            for (uint32_t x = 0; x < width; ++x) {
+                auto const opaque = isOpaque(row[x], cutoff);
+                row_seeds[x] = opaque ? x << 16 | y : no_seed;
+                opaque_count += opaque ? 1 : 0;
+            }
+        }
+
+        // no passes if there is nothing to bleed or nothing to bleed from
+        std::vector<uint32_t> steps;
+        if (opaque_count > 0 && opaque_count < pixel_count) {
+            auto const extent = std::max(width, height);
+            for (auto step = extent > 1 ? std::bit_floor(extent - 1) : 0u; step > 0; step /= 2) {
+                steps.push_back(step);
+            }
+            for (auto correction = corrections; correction > 0; --correction) {
+                steps.push_back(1u << (correction - 1));
+            }
+        }
+        std::vector<uint32_t> bands((height + band_height - 1) / band_height);
+        std::iota(bands.begin(), bands.end(), 0u);
+        for (size_t pass = 0; pass < steps.size(); ++pass) {
+            if (stop_token.stop_requested()) {
+                return false;
+            }
+            auto const step = steps[pass];
+            std::for_each(std::execution::par, bands.begin(), bands.end(), [&](uint32_t const band) -> void {
+                // rows are processed a chunk at a time in local arrays, which can't alias the seeds
+                constexpr uint32_t chunk{256};
+                int32_t keys[chunk];
+                uint32_t best[chunk];
+                for (auto y = band * band_height; y < std::min(height, (band + 1) * band_height); ++y) {
+                    for (uint32_t x0 = 0; x0 < width; x0 += chunk) {
+                        auto const x1 = std::min(x0 + chunk, width);
+                        std::fill_n(keys, x1 - x0, INT32_MAX);
+                        // the pixel's own seed first, it stays on ties
+                        for (auto const& offset : std::array<Vector2i, 9>{{{0, 0}, {1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1}}}) {
+                            auto const ny = static_cast<int64_t>(y) + static_cast<int64_t>(offset.y) * step;
+                            if (ny < 0 || ny >= height || (offset.x != 0 && step >= width)) {
+                                continue;
+                            }
+                            auto const begin = offset.x < 0 ? std::max(x0, step) : x0;
+                            auto const end = offset.x > 0 ? std::min(x1, width - step) : x1;
+                            if (begin >= end) {
+                                continue;
+                            }
+                            // signed, the offset of a left neighbor reaches before the start of the row; begin keeps the sum in the buffer
+                            auto const row_offset = ny * width + static_cast<int64_t>(x0) + static_cast<int64_t>(offset.x) * step;
+                            // counting from the chunk keeps the indices of the local arrays linear for the vectorizer
+                            for (auto i = begin - x0; i < end - x0; ++i) {
+                                auto const seed = seeds[row_offset + i];
+                                // no_seed is at 0xffff, 0xffff, clamped it is still farther than any pixel of the image
+                                auto const dx = std::min(std::abs(static_cast<int32_t>(seed >> 16) - static_cast<int32_t>(x0 + i)), 0x7fff);
+                                auto const dy = std::min(std::abs(static_cast<int32_t>(seed & 0xffff) - static_cast<int32_t>(y)), 0x7fff);
+                                // distance, then the other axis for Chebyshev or the longer one for Manhattan,
+                                // both order seeds at the same distance by their Euclidean distance
+                                auto const key = Connectivity == BleedingConnectivity::Eight
+                                    ? std::max(dx, dy) << 15 | std::min(dx, dy)
+                                    : (dx + dy) << 15 | std::max(dx, dy);
+                                auto const better = key < keys[i];
+                                keys[i] = better ? key : keys[i];
+                                best[i] = better ? seed : best[i];
+                            }
+                        }
+                        std::copy(best, best + (x1 - x0), next_seeds + static_cast<size_t>(y) * width + x0);
+                    }
+                }
+            });
+            std::swap(seeds, next_seeds);
+            on_pass(Rect{}, static_cast<float>(pass + 1) / static_cast<float>(steps.size() + 1));
+        }
+
+        // seeds become pixel indices, as in a source map
+        for (size_t i = 0; i < pixel_count; ++i) {
+            auto const seed = seeds[i];
+            seeds[i] = seed == no_seed ? no_bleeding_source : (seed & 0xffff) * width + (seed >> 16);
+        }
+        std::span<uint32_t const> const origins{seeds, pixel_count};
+        if (!source_map.empty()) {
+            std::copy(origins.begin(), origins.end(), source_map.begin());
+        }
+        on_pass(applyBleedingSources(image, alpha_threshold, origins), 1.0f);
+        return true;
+    }
+
+    // picks the compiled variant for kernel, scratch holds bleedingScratchWordCount words for kernel.traversal.
+    // A non-empty source_map of one entry per pixel receives the index of the opaque pixel every pixel got its color
+    // from, opaque pixels map to themselves and pixels no source reached to no_bleeding_source. For FirstHit and
+    // MaxAlpha applyBleedingSources reproduces the result on another image with the same sources, for Average the
+    // entry is one of the nearest opaque pixels, enough for rebleedPixels but not to replay the colors. The jump flood
+    // records the seed each pixel was colored from, rebleedPixels bleeds the whole image again with it.
+    // Images with source maps are limited to 2^32 - 1 pixels.
+    template <typename Pixel, typename OnPass>
+    bool bleedPixels(
+        ImageView<Pixel> const& image, float const alpha_threshold, BleedingKernel const& kernel,
+        std::span<uint64_t> const scratch, std::stop_token const& stop_token, OnPass&& on_pass,
+        std::span<uint32_t> const source_map = {}
+    ) {
+        auto traverse = [&]<BleedingConnectivity Connectivity, BleedingTieBreak TieBreak>() -> bool {
+            if (kernel.traversal == BleedingTraversal::Tiled) {
+                return bleedPixelsTiled<Connectivity, TieBreak>(image, alpha_threshold, scratch, stop_token, on_pass, source_map);
+            }
+            if (kernel.traversal == BleedingTraversal::JumpFlood
+                && image.width <= jump_flood_max_extent && image.height <= jump_flood_max_extent) {
+                return bleedPixelsJumpFlood<Connectivity>(
+                    image, alpha_threshold, kernel.jump_flood_corrections, scratch, stop_token, on_pass, source_map
+                );
+            }
+            if (kernel.traversal == BleedingTraversal::Frontier || kernel.traversal == BleedingTraversal::JumpFlood) {
+                return bleedPixelsFrontier<Connectivity, TieBreak>(image, alpha_threshold, scratch, stop_token, on_pass, source_map);
+            }
+            return bleedPixelsRowMajor<Connectivity, TieBreak>(image, alpha_threshold, scratch, stop_token, on_pass, source_map);
+        };
+        auto run = [&]<BleedingConnectivity Connectivity>() -> bool {
+            switch (kernel.tie_break) {
+            case BleedingTieBreak::Average:
+                return traverse.template operator()<Connectivity, BleedingTieBreak::Average>();
+            case BleedingTieBreak::MaxAlpha:
+                return traverse.template operator()<Connectivity, BleedingTieBreak::MaxAlpha>();
+            default:
+                return traverse.template operator()<Connectivity, BleedingTieBreak::FirstHit>();
+            }
+        };
+        if (kernel.connectivity == BleedingConnectivity::Four) {
+            return run.template operator()<BleedingConnectivity::Four>();
+        }
+        return run.template operator()<BleedingConnectivity::Eight>();
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace image {
+    // what a job does once bleeding runs into its time, pass or byte limit,
+    // pixel and byte limits hit while decoding always abort since there is nothing to bleed yet
+    enum class LimitAction : uint8_t {
+        Abort, // the job fails and writes no output
+        RadiusLimit, // bleeding stops after the last pass it finished, farther pixels keep their color,
+                     // the jump flood only colors after its last pass and leaves the frame as it was
+        ConstantFill, // pixels at or below the threshold take the mean color of the opaque pixels instead
+    };
+
+    enum class ResourceLimit : uint8_t {
+        None,
+        Pixels,
+        Bytes,
+        Time,
+        Passes,
+    };
+
+    [[nodiscard]] inline std::string_view resourceLimitName(ResourceLimit const limit) {
+        switch (limit) {
+        case ResourceLimit::Pixels:
+            return "pixels";
+        case ResourceLimit::Bytes:
+            return "bytes";
+        case ResourceLimit::Time:
+            return "time";
+        case ResourceLimit::Passes:
+            return "passes";
+        default:
+            return "-";
+        }
+    }
+
+    // Caps of one job, e.g. a file of a batch from an untrusted source, 0 means unlimited.
+    struct ResourceLimits {
+        uint64_t max_pixels{}; // per frame, checked against the header before decoding
+        uint64_t max_bytes{}; // decoded pixels of all frames and the scratch memory of bleeding them
+        std::chrono::milliseconds max_time{}; // bleeding all frames, checked after every pass
+        // on_pass calls per frame: passes row-major and frontier, rounds of bleeding_tile_passes tiled,
+        // steps jump flood
+        uint32_t max_passes{};
+        LimitAction on_limit{LimitAction::Abort};
+
+        [[nodiscard]] bool unlimited() const noexcept {
+            return max_pixels == 0 && max_bytes == 0 && max_time.count() == 0 && max_passes == 0;
+        }
+    };
+
+    // thrown when a job is aborted by one of its limits, the batch goes on with the next job
+    class ResourceLimitError : public std::runtime_error {
+    public:
+        ResourceLimitError(ResourceLimit const limit, std::string const& message) : std::runtime_error(message), m_limit(limit) {}
+
+        [[nodiscard]] ResourceLimit limit() const noexcept {
+            return m_limit;
+        }
+
+    private:
+        ResourceLimit m_limit;
+    };
+
+    // bytes of width * height pixels of pixel_size bytes, nullopt if the product overflows size_t
+    [[nodiscard]] constexpr std::optional<size_t> imageByteCount(
+        uint32_t const width, uint32_t const height, size_t const pixel_size
+    ) noexcept {
+        auto const pixel_count = static_cast<uint64_t>(width) * height;
+        if (pixel_size != 0 && pixel_count > std::numeric_limits<size_t>::max() / pixel_size) {
+            return std::nullopt;
+        }
+        return static_cast<size_t>(pixel_count) * pixel_size;
+    }
+
+    // Call before allocating a width * height image, used_bytes is what the job holds already. Throws ResourceLimitError
+    // if the image breaks max_pixels or max_bytes, returns the job's bytes with the image.
+    inline uint64_t checkImageSize(
+        ResourceLimits const& limits, uint32_t const width, uint32_t const height, size_t const pixel_size, uint64_t const used_bytes = 0
+    ) {
+        auto const size_text = std::to_string(width) + "x" + std::to_string(height);
+        auto const pixel_count = static_cast<uint64_t>(width) * height;
+        if (limits.max_pixels != 0 && pixel_count > limits.max_pixels) {
+            throw ResourceLimitError(
+                ResourceLimit::Pixels, "image of " + size_text + " pixels exceeds the limit of " + std::to_string(limits.max_pixels) + " pixels"
+            );
+        }
+        auto const bytes = imageByteCount(width, height, pixel_size);
+        if (!bytes) {
+            throw ResourceLimitError(ResourceLimit::Bytes, "image of " + size_text + " pixels does not fit in memory");
+        }
+        if (limits.max_bytes != 0 && (*bytes > limits.max_bytes || used_bytes > limits.max_bytes - *bytes)) {
+            throw ResourceLimitError(
+                ResourceLimit::Bytes, "image of " + size_text + " pixels exceeds the limit of " + std::to_string(limits.max_bytes) + " bytes"
+            );
+        }
+        return used_bytes + *bytes;
+    }
+}
@@ -0,0 +1,85 @@
+#include "image/ScratchArena.hpp"
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+namespace image {
+    uint64_t processPageFaultCount() noexcept {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters{};
+        counters.cb = sizeof(counters);
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return 0;
+        }
+        return counters.PageFaultCount;
+#else
+        rusage usage{};
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        return static_cast<uint64_t>(usage.ru_minflt) + static_cast<uint64_t>(usage.ru_majflt);
+#endif
+    }
+
+#ifdef _WIN32
+    void PageBlock::allocate(size_t size, bool const use_huge_pages) {
+        if (use_huge_pages) {
+            if (auto const large_page = GetLargePageMinimum(); large_page > 0) {
+                auto const rounded = (size + large_page - 1) / large_page * large_page;
+                m_data = static_cast<std::byte*>(VirtualAlloc(
+                    nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE
+                ));
+                if (m_data) {
+                    m_size = rounded;
+                    m_huge_pages = true;
+                    return;
+                }
+            }
+        }
+        m_data = static_cast<std::byte*>(VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+        if (!m_data) {
+            throw std::bad_alloc();
+        }
+        m_size = size;
+    }
+
+    void PageBlock::release() noexcept {
+        if (m_data) {
+            VirtualFree(m_data, 0, MEM_RELEASE);
+            m_data = nullptr;
+            m_size = 0;
+        }
+    }
+#else
+    void PageBlock::allocate(size_t size, bool const use_huge_pages) {
+        constexpr size_t huge_page_size = size_t{2} << 20;
+        if (use_huge_pages) {
+            size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+        }
+        auto const data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        m_data = static_cast<std::byte*>(data);
+        m_size = size;
+#ifdef MADV_HUGEPAGE
+        m_huge_pages = use_huge_pages && madvise(data, size, MADV_HUGEPAGE) == 0;
+#endif
+    }
+
+    void PageBlock::release() noexcept {
+        if (m_data) {
+            munmap(m_data, m_size);
+            m_data = nullptr;
+            m_size = 0;
+        }
+    }
+#endif
+}
@@ -0,0 +1,157 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+
+namespace image {
+    // page faults of the whole process so far, take the difference around a piece of work
+    [[nodiscard]] uint64_t processPageFaultCount() noexcept;
+
+    // Memory straight from the OS page allocator, optionally backed by huge pages.
+    // Windows large pages need SeLockMemoryPrivilege, Linux gets a transparent huge page hint,
+    // without either the block silently falls back to normal pages and hugePages() is false.
+    class PageBlock {
+    public:
+        PageBlock() = default;
+
+        PageBlock(size_t const size, bool const use_huge_pages) {
+            allocate(size, use_huge_pages);
+        }
+
+        PageBlock(PageBlock&& other) noexcept
+            : m_data(std::exchange(other.m_data, nullptr)),
+              m_size(std::exchange(other.m_size, 0)),
+              m_huge_pages(std::exchange(other.m_huge_pages, false)) {}
+
+        PageBlock& operator=(PageBlock&& other) noexcept {
+            if (this != &other) {
+                release();
+                m_data = std::exchange(other.m_data, nullptr);
+                m_size = std::exchange(other.m_size, 0);
+                m_huge_pages = std::exchange(other.m_huge_pages, false);
+            }
+            return *this;
+        }
+
+        PageBlock(PageBlock const&) = delete;
+        PageBlock& operator=(PageBlock const&) = delete;
+
+        ~PageBlock() {
+            release();
+        }
+
+        [[nodiscard]] std::byte* data() const noexcept {
+            return m_data;
+        }
+
+        [[nodiscard]] size_t size() const noexcept {
+            return m_size;
+        }
+
+        [[nodiscard]] bool hugePages() const noexcept {
+            return m_huge_pages;
+        }
+
+    private:
+        // in ScratchArena.cpp, the only place that includes the platform headers
+        void allocate(size_t size, bool use_huge_pages);
+        void release() noexcept;
+
+        std::byte* m_data{};
+        size_t m_size{};
+        bool m_huge_pages{};
+    };
+
+    struct ScratchArenaStats {
+        uint64_t acquire_count{};
+        uint64_t reused_count{}; // acquires served from memory the arena already owned
+        uint64_t grow_count{}; // times the block was replaced by a larger one
+        size_t reserved_bytes{}; // size of the block
+        size_t high_water_bytes{}; // most bytes in use between two resets
+        size_t last_used_bytes{}; // bytes in use before the last reset
+        bool huge_pages{};
+
+        [[nodiscard]] double reuseRate() const noexcept {
+            return acquire_count > 0 ? static_cast<double>(reused_count) / static_cast<double>(acquire_count) : 0.0;
+        }
+
+        // share of the block the last file did not use
+        [[nodiscard]] double fragmentation() const noexcept {
+            return reserved_bytes > 0 ? 1.0 - static_cast<double>(last_used_bytes) / static_cast<double>(reserved_bytes) : 0.0;
+        }
+    };
+
+    // Bump allocator for per-file scratch memory of one worker. Everything acquired stays valid until reset,
+    // which is called once a file is done. A file that needs more than the block gets overflow blocks, on the
+    // next reset they are replaced by one block of the high-water size, so a batch settles on a single block
+    // that is reused for every following file without touching the heap or faulting in new pages.
+    class ScratchArena {
+    public:
+        static constexpr size_t alignment{64};
+
+        explicit ScratchArena(bool const use_huge_pages = false) : m_use_huge_pages(use_huge_pages) {}
+
+        // uninitialized storage for count objects of a trivial type
+        template <typename T>
+        [[nodiscard]] std::span<T> acquire(size_t const count) {
+            static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>);
+            static_assert(alignof(T) <= alignment);
+            if (count > (SIZE_MAX - alignment) / sizeof(T)) {
+                throw std::bad_alloc();
+            }
+            auto const bytes = alignUp(count * sizeof(T));
+            ++m_stats.acquire_count;
+            m_used += bytes;
+            m_stats.high_water_bytes = std::max(m_stats.high_water_bytes, m_used);
+            if (m_offset + bytes <= m_block.size()) {
+                auto const data = m_block.data() + m_offset;
+                m_offset += bytes;
+                ++m_stats.reused_count;
+                return std::span<T>{reinterpret_cast<T*>(data), count};
+            }
+            auto& overflow = m_overflow.emplace_back(bytes, false);
+            return std::span<T>{reinterpret_cast<T*>(overflow.data()), count};
+        }
+
+        // releases everything acquired since the last reset
+        void reset() {
+            m_stats.last_used_bytes = m_used;
+            if (!m_overflow.empty()) {
+                m_overflow.clear();
+                m_block = PageBlock{};
+                m_block = PageBlock{m_stats.high_water_bytes, m_use_huge_pages};
+                ++m_stats.grow_count;
+                m_stats.reserved_bytes = m_block.size();
+                m_stats.huge_pages = m_block.hugePages();
+            }
+            m_offset = 0;
+            m_used = 0;
+        }
+
+        // bytes acquired since the last reset
+        [[nodiscard]] size_t usedBytes() const noexcept {
+            return m_used;
+        }
+
+        [[nodiscard]] ScratchArenaStats const& stats() const noexcept {
+            return m_stats;
+        }
+
+    private:
+        [[nodiscard]] static constexpr size_t alignUp(size_t const size) noexcept {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        PageBlock m_block;
+        std::vector<PageBlock> m_overflow;
+        size_t m_offset{};
+        size_t m_used{};
+        bool m_use_huge_pages{};
+        ScratchArenaStats m_stats;
+    };
+}
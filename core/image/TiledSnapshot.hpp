@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "image/Image2D.hpp"
+
+namespace image {
+    // Copy-on-write copy of an Image2D split into tiles. A snapshot captured on top of a previous one
+    // shares every tile that did not change by reference count, so its cost is proportional to the changed tiles.
+    template <typename Pixel>
+    class TiledSnapshot {
+    public:
+        static constexpr uint32_t tile_size{64};
+
+        using PixelType = Pixel;
+        using Tile = std::vector<Pixel>;
+
+        // changed limits the tiles compared against previous, pass nullptr to compare every tile
+        [[nodiscard]] static TiledSnapshot capture(
+            Image2D<Pixel> const& image, TiledSnapshot const* previous, DirtyRegion const* changed
+        ) {
+            TiledSnapshot snapshot;
+            snapshot.m_width = image.width();
+            snapshot.m_height = image.height();
+            snapshot.m_tiles_x = (image.width() + tile_size - 1) / tile_size;
+            snapshot.m_tiles_y = (image.height() + tile_size - 1) / tile_size;
+            snapshot.m_tiles.resize(static_cast<size_t>(snapshot.m_tiles_x) * snapshot.m_tiles_y);
+            if (previous && !previous->sameShape(snapshot)) {
+                previous = nullptr;
+            }
+            for (uint32_t tile_y = 0; tile_y < snapshot.m_tiles_y; ++tile_y) {
+                for (uint32_t tile_x = 0; tile_x < snapshot.m_tiles_x; ++tile_x) {
+                    auto const index = snapshot.tileIndex(tile_x, tile_y);
+                    auto const rect = snapshot.tileRect(tile_x, tile_y);
+                    if (previous) {
+                        auto const& shared = previous->m_tiles[index];
+                        if (changed && !intersects(*changed, rect)) {
+                            snapshot.m_tiles[index] = shared;
+                            continue;
+                        }
+                        if (equals(*shared, image, rect)) {
+                            snapshot.m_tiles[index] = shared;
+                            continue;
+                        }
+                    }
+                    auto tile = std::make_shared<Tile>(rect.area());
+                    copyRect(
+                        tile->data(), rect.width * sizeof(Pixel),
+                        &image.pixel(rect.x, rect.y), image.pitch(),
+                        Rect{0, 0, rect.width, rect.height}, sizeof(Pixel)
+                    );
+                    snapshot.m_tiles[index] = std::move(tile);
+                    ++snapshot.m_new_tile_count;
+                    snapshot.m_new_bytes += rect.area() * sizeof(Pixel);
+                }
+            }
+            return snapshot;
+        }
+
+        // writes this snapshot into image, with current being the snapshot image already matches only
+        // tiles that differ from it are copied, the copied tiles are marked dirty
+        void restore(Image2D<Pixel>& image, TiledSnapshot const* current) const {
+            if (image.width() != m_width || image.height() != m_height) {
+                image.resize(m_width, m_height);
+                current = nullptr;
+            }
+            if (current && !current->sameShape(*this)) {
+                current = nullptr;
+            }
+            for (uint32_t tile_y = 0; tile_y < m_tiles_y; ++tile_y) {
+                for (uint32_t tile_x = 0; tile_x < m_tiles_x; ++tile_x) {
+                    auto const index = tileIndex(tile_x, tile_y);
+                    if (current && current->m_tiles[index] == m_tiles[index]) {
+                        continue;
+                    }
+                    auto const rect = tileRect(tile_x, tile_y);
+                    copyRect(
+                        &image.pixel(rect.x, rect.y), image.pitch(),
+                        m_tiles[index]->data(), rect.width * sizeof(Pixel),
+                        Rect{0, 0, rect.width, rect.height}, sizeof(Pixel)
+                    );
+                    image.markDirty(rect);
+                }
+            }
+        }
+
+        // tiles not shared with other, cheap because shared tiles compare by pointer only
+        [[nodiscard]] DirtyRegion difference(TiledSnapshot const& other) const {
+            DirtyRegion region;
+            if (!sameShape(other)) {
+                region.add(Rect{0, 0, m_width, m_height});
+                return region;
+            }
+            for (uint32_t tile_y = 0; tile_y < m_tiles_y; ++tile_y) {
+                for (uint32_t tile_x = 0; tile_x < m_tiles_x; ++tile_x) {
+                    auto const index = tileIndex(tile_x, tile_y);
+                    if (m_tiles[index] != other.m_tiles[index]) {
+                        region.add(tileRect(tile_x, tile_y));
+                    }
+                }
+            }
+            return region;
+        }
+
+        [[nodiscard]] std::vector<std::shared_ptr<Tile const>> const& tiles() const noexcept {
+            return m_tiles;
+        }
+
+        // tiles and bytes this snapshot allocated itself instead of sharing with the previous one
+        [[nodiscard]] size_t newTileCount() const noexcept {
+            return m_new_tile_count;
+        }
+
+        [[nodiscard]] size_t newBytes() const noexcept {
+            return m_new_bytes;
+        }
+
+        [[nodiscard]] size_t fullBytes() const noexcept {
+            return static_cast<size_t>(m_width) * m_height * sizeof(Pixel);
+        }
+
+    private:
+        [[nodiscard]] bool sameShape(TiledSnapshot const& other) const noexcept {
+            return m_width == other.m_width && m_height == other.m_height;
+        }
+
+        [[nodiscard]] size_t tileIndex(uint32_t const tile_x, uint32_t const tile_y) const noexcept {
+            return static_cast<size_t>(tile_y) * m_tiles_x + tile_x;
+        }
+
+        [[nodiscard]] Rect tileRect(uint32_t const tile_x, uint32_t const tile_y) const noexcept {
+            auto const x = tile_x * tile_size;
+            auto const y = tile_y * tile_size;
+            return Rect{x, y, std::min(tile_size, m_width - x), std::min(tile_size, m_height - y)};
+        }
+
+        [[nodiscard]] static bool intersects(DirtyRegion const& region, Rect const& rect) noexcept {
+            return std::ranges::any_of(region.rects(), [&](Rect const& dirty) -> bool {
+                return dirty.x < rect.right() && rect.x < dirty.right() && dirty.y < rect.bottom() && rect.y < dirty.bottom();
+            });
+        }
+
+        [[nodiscard]] static bool equals(Tile const& tile, Image2D<Pixel> const& image, Rect const& rect) noexcept {
+            auto const row_size = rect.width * sizeof(Pixel);
+            for (uint32_t y = 0; y < rect.height; ++y) {
+                if (std::memcmp(tile.data() + y * rect.width, &image.pixel(rect.x, rect.y + y), row_size) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::vector<std::shared_ptr<Tile const>> m_tiles;
+        uint32_t m_width{};
+        uint32_t m_height{};
+        uint32_t m_tiles_x{};
+        uint32_t m_tiles_y{};
+        size_t m_new_tile_count{};
+        size_t m_new_bytes{};
+    };
+}
@@ -8,10 +8,16 @@
 
 #include <cmath>
 #include <stdexcept>
+#include <string>
 #include <vector>
+#include <optional>
 #include <ranges>
 #include <algorithm>
 #include "ext/convert.hpp"
+#include "image/AnyImage2D.hpp"
+#include "image/BleedingTask.hpp"
+#include "image/History.hpp"
+#include "image/ResourceLimits.hpp"
 
 #include "imgui.h"
 #include "imgui_impl_win32.h"
@@ -33,6 +39,7 @@
 #include <wil/com.h>
 #include <wil/result_macros.h>
 #include "win32/WindowTheme.hpp"
+#include "wic/ImageCodec.hpp"
 
 #define APP_GIT_URL "https://github.com/Legacy-LuaSTG-Engine/png-pixel-bleeding"
 #define APP_VERSION "0.3.0"
@@ -53,157 +60,16 @@ void CreateRenderTarget();
 void CleanupRenderTarget();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-struct Vector2i {
-    int32_t x{};
-    int32_t y{};
-};
-
-class BooleanMap2D {
-public:
-    [[nodiscard]] bool get(uint32_t const x, uint32_t const y) const {
-        return m_pixels.at(y * m_width + x);
-    }
-
-    void set(uint32_t const x, uint32_t const y) {
-        m_pixels.at(y * m_width + x) = true;
-    }
-
-    void resize(uint32_t const width, uint32_t const height) {
-        m_width = width;
-        m_height = height;
-        m_pixels.resize(width * height);
-    }
-
-private:
-    std::vector<bool> m_pixels;
-    uint32_t m_width{};
-    uint32_t m_height{};
-};
-
-class Image2D {
-public:
-    [[nodiscard]] uint32_t width() const noexcept {
-        return m_width;
-    }
-
-    [[nodiscard]] uint32_t pitch() const noexcept {
-        return static_cast<uint32_t>(m_width * sizeof(DirectX::PackedVector::XMCOLOR));
-    }
-
-    [[nodiscard]] uint32_t height() const noexcept {
-        return m_height;
-    }
-
-    [[nodiscard]] uint32_t size() const noexcept {
-        return static_cast<uint32_t>(m_pixels.size() * sizeof(DirectX::PackedVector::XMCOLOR));
-    }
-
-    template <typename T>
-    [[nodiscard]] T* buffer() noexcept {
-        return reinterpret_cast<T*>(m_pixels.data());
-    }
-
-    void clear() {
-        m_width = 0;
-        m_height = 0;
-        m_pixels.clear();
-        m_pixels.shrink_to_fit();
-    }
-
-    void resize(uint32_t const width, uint32_t const height) {
-        m_width = width;
-        m_height = height;
-        m_pixels.resize(width * height);
-    }
-
-    void fill(DirectX::PackedVector::XMCOLOR const color = {}) {
-        std::ranges::fill(m_pixels, color);
-    }
-
-    [[nodiscard]] DirectX::PackedVector::XMCOLOR const& pixel(uint32_t const x, uint32_t const y) const {
-        return m_pixels.at(y * m_width + x);
+static DXGI_FORMAT toDxgiFormat(image::PixelFormat const format) {
+    switch (format) {
+    case image::PixelFormat::RGBA16:
+        return DXGI_FORMAT_R16G16B16A16_UNORM;
+    case image::PixelFormat::RGBA32F:
+        return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    default:
+        return DXGI_FORMAT_B8G8R8A8_UNORM;
     }
-
-    [[nodiscard]] DirectX::PackedVector::XMCOLOR& pixel(uint32_t const x, uint32_t const y) {
-        return m_pixels.at(y * m_width + x);
-    }
-
-    [[nodiscard]] bool findNotTransparentNeighbors(
-        BooleanMap2D const& processed, uint32_t const x, uint32_t const y,
-        uint32_t& count, DirectX::PackedVector::XMCOLOR results[8]
-    ) const noexcept {
-        count = 0;
-        constexpr Vector2i offsets[8]{
-            Vector2i{1, 0},
-            Vector2i{0, 1},
-            Vector2i{-1, 0},
-            Vector2i{0, -1},
-            Vector2i{1, 1},
-            Vector2i{-1, 1},
-            Vector2i{-1, -1},
-            Vector2i{1, -1},
-        };
-        for (auto const& offset : offsets) {
-            if (offset.x == -1 && x == 0) {
-                continue; // out of bounds
-            }
-            if (offset.x == 1 && x == width() - 1) {
-                continue; // out of bounds
-            }
-            if (offset.y == -1 && y == 0) {
-                continue; // out of bounds
-            }
-            if (offset.y == 1 && y == height() - 1) {
-                continue; // out of bounds
-            }
-            auto const px = pixel(x + offset.x, y + offset.y);
-            if (!processed.get(x + offset.x, y + offset.y) && px.a == 0) {
-                continue; // ignore transparent pixel or not processed pixel
-            }
-            results[count] = px;
-            ++count;
-        }
-        return count > 0;
-    }
-
-    void doPixelBleeding() {
-        BooleanMap2D processed;
-        processed.resize(width(), height());
-        size_t miss_count{};
-        uint32_t count{};
-        DirectX::PackedVector::XMCOLOR results[8]{};
-        do {
-            miss_count = 0;
-            Image2D cache = *this;
-            BooleanMap2D processed_cache = processed;
-            for (uint32_t y = 0; y < height(); ++y) {
-                for (uint32_t x = 0; x < width(); ++x) {
-                    if (processed_cache.get(x, y)) {
-                        continue;
-                    }
-                    auto& color = pixel(x, y);
-                    if (color.a > 0) {
-                        processed.set(x, y);
-                        continue;
-                    }
-                    if (!cache.findNotTransparentNeighbors(processed_cache, x, y, count, results)) {
-                        ++miss_count;
-                        continue;
-                    }
-                    color = results[0];
-                    color.a = 0;
-                    processed.set(x, y);
-                }
-            }
-        }
-        while (miss_count > 0);
-    }
-
-private:
-    std::vector<DirectX::PackedVector::XMCOLOR> m_pixels;
-    uint32_t m_width{};
-    uint32_t m_height{};
-};
+}
 
 class Application {
 public:
@@ -349,33 +215,16 @@ public:
     }
 
     void saveFileAs(std::string const& path) {
-        if (!m_wic_factory) {
-            m_wic_factory = wil::CoCreateInstance<IWICImagingFactory>(CLSID_WICImagingFactory);
+        if (m_history.current() == 0) {
+            // still the pixels of the opened file, copy it instead of encoding it again
+            if (path != m_open_file_path) {
+                THROW_IF_WIN32_BOOL_FALSE(CopyFileW(
+                    ext::convert<std::wstring>(m_open_file_path).c_str(), ext::convert<std::wstring>(path).c_str(), FALSE
+                ));
+            }
+            return;
         }
-
-        wil::com_ptr<IWICStream> stream;
-        THROW_IF_FAILED(m_wic_factory->CreateStream(stream.put()));
-        auto const file_path = ext::convert<std::wstring>(path);
-        THROW_IF_FAILED(stream->InitializeFromFilename(file_path.c_str(), GENERIC_WRITE));
-
-        wil::com_ptr<IWICBitmapEncoder> encoder;
-        THROW_IF_FAILED(m_wic_factory->CreateEncoder(GUID_ContainerFormatPng, nullptr, encoder.put()));
-        THROW_IF_FAILED(encoder->Initialize(stream.get(), WICBitmapEncoderNoCache));
-
-        wil::com_ptr<IWICBitmapFrameEncode> encoder_frame;
-        wil::com_ptr<IPropertyBag2> props;
-        THROW_IF_FAILED(encoder->CreateNewFrame(encoder_frame.put(), props.put()));
-
-        THROW_IF_FAILED(encoder_frame->Initialize(props.get()));
-        THROW_IF_FAILED(encoder_frame->SetSize(m_image.width(), m_image.height()));
-        auto target_pixel_format{GUID_WICPixelFormat32bppBGRA};
-        THROW_IF_FAILED(encoder_frame->SetPixelFormat(&target_pixel_format));
-        THROW_IF_FAILED(encoder_frame->WritePixels(
-            m_image.height(), m_image.pitch(), m_image.size(), m_image.buffer<BYTE>()
-        ));
-
-        THROW_IF_FAILED(encoder_frame->Commit());
-        THROW_IF_FAILED(encoder->Commit());
+        m_codec.save(path, m_image);
     }
 
     void saveFileCommand() {
@@ -417,20 +266,25 @@ public:
         unloadImage();
     }
 
-    void createTextureResources(uint32_t const width, uint32_t const height) {
-        m_image.resize(width, height);
-        m_image.fill();
+    [[nodiscard]] static bool fitsTexture(uint32_t const width, uint32_t const height) noexcept {
+        return width <= D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION && height <= D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION;
+    }
 
+    void createTextureResources(image::PixelFormat const format, uint32_t const width, uint32_t const height) {
+        if (!fitsTexture(width, height)) {
+            throw std::length_error(
+                "texture of " + std::to_string(width) + "x" + std::to_string(height) + " pixels exceeds the D3D11 limit"
+            );
+        }
         D3D11_TEXTURE2D_DESC texture_info{};
         texture_info.Width = width;
         texture_info.Height = height;
         texture_info.MipLevels = 1;
         texture_info.ArraySize = 1;
-        texture_info.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        texture_info.Format = toDxgiFormat(format);
         texture_info.SampleDesc.Count = 1;
-        texture_info.Usage = D3D11_USAGE_DYNAMIC;
+        texture_info.Usage = D3D11_USAGE_DEFAULT; // updated per dirty rect, WRITE_DISCARD would force full uploads
         texture_info.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        texture_info.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
         THROW_IF_FAILED(g_pd3dDevice->CreateTexture2D(
             &texture_info, nullptr, m_opened_texture.put()
         ));
@@ -445,144 +299,195 @@ public:
         ));
     }
 
-    void uploadTextureData() {
-        D3D11_MAPPED_SUBRESOURCE mapped{};
-        THROW_IF_FAILED(g_pd3dDeviceContext->Map(
-            m_opened_texture.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped
-        ));
-        auto source = m_image.buffer<uint8_t>();
-        auto pointer = static_cast<uint8_t*>(mapped.pData);
-        for (uint32_t y = 0; y < m_image.height(); ++y) {
-            std::memcpy(pointer, source, m_image.pitch());
-            source += m_image.pitch();
-            pointer += mapped.RowPitch;
+    void uploadTextureData(image::AnyImage2D const& image, image::DirtyRegion const& region) {
+        for (auto const& rect : region.rects()) {
+            D3D11_BOX const box{
+                .left = rect.x,
+                .top = rect.y,
+                .front = 0,
+                .right = rect.right(),
+                .bottom = rect.bottom(),
+                .back = 1,
+            };
+            auto const source = image.buffer<uint8_t>()
+                + static_cast<size_t>(rect.y) * image.pitch()
+                + static_cast<size_t>(rect.x) * image.pixelSize();
+            g_pd3dDeviceContext->UpdateSubresource(m_opened_texture.get(), 0, &box, source, image.pitch(), 0);
         }
-        g_pd3dDeviceContext->Unmap(m_opened_texture.get(), 0);
+    }
+
+    void uploadTextureData() {
+        uploadTextureData(m_image, m_image.dirtyRegion());
+        m_image.clearDirtyRegion();
     }
 
     void loadImage() {
-        if (!m_wic_factory) {
-            m_wic_factory = wil::CoCreateInstance<IWICImagingFactory>(CLSID_WICImagingFactory);
+        // the header is checked before decoding, a file too large for a texture is refused like an unsupported one
+        try {
+            if (!m_codec.load(m_open_file_path, m_image, load_limits)) {
+                return;
+            }
+        }
+        catch (image::ResourceLimitError const&) {
+            m_image.releaseMemory();
+            return;
         }
+        if (!fitsTexture(m_image.width(), m_image.height())) {
+            m_image.releaseMemory();
+            return;
+        }
+        createTextureResources(m_image.format(), m_image.width(), m_image.height());
+        uploadTextureData(); // resize marked the whole image dirty
+        m_history.reset(m_image, "打开");
+    }
 
-        // create decoder
+    void startBleedingCommand() {
+        m_bleeding_task.start(m_image, image::BleedingOptions{
+            .alpha_threshold = m_alpha_threshold,
+            .kernel = m_bleeding_kernel,
+            .optimize_for_block_compression = m_optimize_for_block_compression,
+        });
+    }
 
-        wil::com_ptr<IWICBitmapDecoder> decoder;
-        auto const file_path = ext::convert<std::wstring>(m_open_file_path);
-        THROW_IF_FAILED(m_wic_factory->CreateDecoderFromFilename(
-            file_path.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnLoad, decoder.put()
-        ));
+    void pollBleedingTask() {
+        m_bleeding_task.uploadPreview([this](image::AnyImage2D const& image, image::DirtyRegion const& region) -> void {
+            uploadTextureData(image, region);
+        });
+        if (auto const result = m_bleeding_task.takeResult(m_image); result) {
+            if (result->completed) {
+                m_block_compression_stats = result->block_compression_stats;
+                if (!result->changed.empty()) {
+                    m_history.commit(m_image, "处理透明像素", &result->changed); // empty if the image was already bled
+                }
+            }
+            else {
+                // cancelled, show the original image again
+                m_image.markDirty(image::Rect{0, 0, m_image.width(), m_image.height()});
+                uploadTextureData();
+            }
+        }
+    }
 
-        // get first frame
-
-        wil::com_ptr<IWICBitmapFrameDecode> decoder_frame;
-        THROW_IF_FAILED(decoder->GetFrame(0, decoder_frame.put()));
-
-        //UINT color_context_count{};
-        //THROW_IF_FAILED(decoder_frame->GetColorContexts(
-        //    0, nullptr, &color_context_count
-        //));
-        //std::vector<IWICColorContext*> color_contexts(color_context_count);
-        //THROW_IF_FAILED(decoder_frame->GetColorContexts(
-        //    color_context_count, color_contexts.data(), &color_context_count
-        //));
-        //[[maybe_unused]] auto const auto_release_color_contexts = wil::scope_exit([&]() -> void {
-        //    for (auto const color_context : color_contexts) {
-        //        if (color_context) {
-        //            color_context->Release();
-        //        }
-        //    }
-        //    color_contexts.clear();
-        //});
-        //for (auto const color_context : color_contexts) {
-        //    WICColorContextType type{};
-        //    THROW_IF_FAILED(color_context->GetType(&type));
-        //    if (type == WICColorContextExifColorSpace) {
-        //        UINT color_space{};
-        //        THROW_IF_FAILED(color_context->GetExifColorSpace(&color_space));
-        //    }
-        //}
-
-        // convert
-
-        auto const target_pixel_format{GUID_WICPixelFormat32bppBGRA};
-        WICPixelFormatGUID pixel_format{};
-        THROW_IF_FAILED(decoder_frame->GetPixelFormat(&pixel_format));
-
-        auto decodeFrame = [&](IWICBitmapSource* bitmap) -> void {
-            UINT width{};
-            UINT height{};
-            THROW_IF_FAILED(bitmap->GetSize(&width, &height));
-
-            createTextureResources(width, height);
-
-            THROW_IF_FAILED(bitmap->CopyPixels(
-                nullptr, m_image.pitch(), m_image.size(), m_image.buffer<BYTE>()
-            ));
-
-            D3D11_MAPPED_SUBRESOURCE mapped{};
-            THROW_IF_FAILED(g_pd3dDeviceContext->Map(
-                m_opened_texture.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped
-            ));
-            THROW_IF_FAILED(bitmap->CopyPixels(
-                nullptr, mapped.RowPitch, mapped.RowPitch * height, static_cast<BYTE*>(mapped.pData)
-            ));
-            g_pd3dDeviceContext->Unmap(m_opened_texture.get(), 0);
-        };
+    void applyAlphaThresholdCommand() {
+        m_image.applyAlphaThreshold(m_alpha_threshold);
+        m_history.commit(m_image, "阈值裁剪透明度", &m_image.dirtyRegion());
+        uploadTextureData();
+    }
 
-        if (pixel_format != target_pixel_format) {
-            wil::com_ptr<IWICFormatConverter> format_converter;
-            THROW_IF_FAILED(m_wic_factory->CreateFormatConverter(format_converter.put()));
-            BOOL can_convert{FALSE};
-            THROW_IF_FAILED(format_converter->CanConvert(pixel_format, target_pixel_format, &can_convert));
-            if (can_convert) {
-                THROW_IF_FAILED(format_converter->Initialize(
-                    decoder_frame.get(), target_pixel_format,
-                    WICBitmapDitherTypeNone, nullptr, 0.0f, WICBitmapPaletteTypeCustom
-                ));
-                decodeFrame(format_converter.get());
-            }
+    void premultiplyAlphaCommand() {
+        m_image.premultiplyAlpha();
+        m_history.commit(m_image, "预乘透明度", &m_image.dirtyRegion());
+        uploadTextureData();
+    }
+
+    void undoCommand() {
+        if (m_history.undo(m_image)) {
+            m_block_compression_stats.reset();
+            uploadTextureData(); // only the tiles that differ between the two snapshots are dirty
         }
-        else {
-            decodeFrame(decoder_frame.get());
+    }
+
+    void redoCommand() {
+        if (m_history.redo(m_image)) {
+            m_block_compression_stats.reset();
+            uploadTextureData();
         }
     }
 
     void unloadImage() {
-        m_image_processed = false;
-        m_image.clear();
+        m_bleeding_task.reset();
+        m_history.clear();
+        m_block_compression_stats.reset();
+        m_image.releaseMemory();
         m_opened_texture.reset();
         m_opened_srv.reset();
     }
 
     void layoutMainMenu() {
         if (ImGui::BeginMenuBar()) {
+            auto const busy = m_bleeding_task.running();
             if (ImGui::BeginMenu("文件")) {
-                if (ImGui::MenuItem("打开")) {
+                if (ImGui::MenuItem("打开", nullptr, false, !busy)) {
                     openFileCommand();
                 }
-                if (ImGui::MenuItem("关闭", nullptr, false, m_opened)) {
+                if (ImGui::MenuItem("关闭", nullptr, false, m_opened && !busy)) {
                     closeFileCommand();
                 }
-                if (ImGui::MenuItem("保存", nullptr, false, m_opened)) {
+                if (ImGui::MenuItem("保存", nullptr, false, m_opened && !busy)) {
                     saveFileCommand();
                 }
-                if (ImGui::MenuItem("另存为", nullptr, false, m_opened)) {
+                if (ImGui::MenuItem("另存为", nullptr, false, m_opened && !busy)) {
                     saveFileAsCommand();
                 }
                 ImGui::EndMenu();
             }
             if (ImGui::BeginMenu("编辑")) {
-                if (ImGui::MenuItem("处理透明像素", nullptr, nullptr, !m_image_processed)) {
-                    m_image.doPixelBleeding();
-                    uploadTextureData();
-                    m_image_processed = true;
+                if (ImGui::MenuItem("撤销", nullptr, false, m_history.canUndo() && !busy)) {
+                    undoCommand();
+                }
+                if (ImGui::MenuItem("重做", nullptr, false, m_history.canRedo() && !busy)) {
+                    redoCommand();
+                }
+                ImGui::Separator();
+                if (ImGui::MenuItem("处理透明像素", nullptr, false, m_opened && !busy)) {
+                    startBleedingCommand();
+                }
+                if (ImGui::MenuItem("阈值裁剪透明度", nullptr, false, m_opened && !busy)) {
+                    applyAlphaThresholdCommand();
                 }
+                if (ImGui::MenuItem("预乘透明度", nullptr, false, m_opened && !busy)) {
+                    premultiplyAlphaCommand();
+                }
+                ImGui::SliderFloat("透明度阈值", &m_alpha_threshold, 0.0f, 1.0f, "%.3f");
+                if (ImGui::BeginMenu("邻域")) {
+                    if (ImGui::MenuItem("8 邻域", nullptr, m_bleeding_kernel.connectivity == image::BleedingConnectivity::Eight)) {
+                        m_bleeding_kernel.connectivity = image::BleedingConnectivity::Eight;
+                    }
+                    if (ImGui::MenuItem("4 邻域", nullptr, m_bleeding_kernel.connectivity == image::BleedingConnectivity::Four)) {
+                        m_bleeding_kernel.connectivity = image::BleedingConnectivity::Four;
+                    }
+                    ImGui::EndMenu();
+                }
+                if (ImGui::BeginMenu("遍历方式")) {
+                    if (ImGui::MenuItem("逐行", nullptr, m_bleeding_kernel.traversal == image::BleedingTraversal::RowMajor)) {
+                        m_bleeding_kernel.traversal = image::BleedingTraversal::RowMajor;
+                    }
+                    if (ImGui::MenuItem("分块", nullptr, m_bleeding_kernel.traversal == image::BleedingTraversal::Tiled)) {
+                        m_bleeding_kernel.traversal = image::BleedingTraversal::Tiled;
+                    }
+                    if (ImGui::MenuItem("沿边界推进（适合大片透明）", nullptr, m_bleeding_kernel.traversal == image::BleedingTraversal::Frontier)) {
+                        m_bleeding_kernel.traversal = image::BleedingTraversal::Frontier;
+                    }
+                    if (ImGui::MenuItem("跳跃泛洪（近似，可并行）", nullptr, m_bleeding_kernel.traversal == image::BleedingTraversal::JumpFlood)) {
+                        m_bleeding_kernel.traversal = image::BleedingTraversal::JumpFlood;
+                    }
+                    if (m_bleeding_kernel.traversal == image::BleedingTraversal::JumpFlood) {
+                        int corrections{m_bleeding_kernel.jump_flood_corrections};
+                        if (ImGui::SliderInt("校正次数", &corrections, 0, 2)) {
+                            m_bleeding_kernel.jump_flood_corrections = static_cast<uint8_t>(corrections);
+                        }
+                    }
+                    ImGui::EndMenu();
+                }
+                if (ImGui::BeginMenu("多个来源时")) {
+                    if (ImGui::MenuItem("取第一个", nullptr, m_bleeding_kernel.tie_break == image::BleedingTieBreak::FirstHit)) {
+                        m_bleeding_kernel.tie_break = image::BleedingTieBreak::FirstHit;
+                    }
+                    if (ImGui::MenuItem("取平均", nullptr, m_bleeding_kernel.tie_break == image::BleedingTieBreak::Average)) {
+                        m_bleeding_kernel.tie_break = image::BleedingTieBreak::Average;
+                    }
+                    if (ImGui::MenuItem("取透明度最高", nullptr, m_bleeding_kernel.tie_break == image::BleedingTieBreak::MaxAlpha)) {
+                        m_bleeding_kernel.tie_break = image::BleedingTieBreak::MaxAlpha;
+                    }
+                    ImGui::EndMenu();
+                }
+                ImGui::MenuItem("针对 BC3/BC7 块压缩优化", nullptr, &m_optimize_for_block_compression);
                 ImGui::EndMenu();
             }
             if (ImGui::BeginMenu("查看")) {
                 ImGui::MenuItem("预览透明度通道", nullptr, &m_preview_alpha);
                 ImGui::MenuItem("临近采样缩放", nullptr, &m_preview_point_scale);
+                ImGui::MenuItem("历史记录", nullptr, &m_show_history_window);
                 ImGui::EndMenu();
             }
             if (ImGui::BeginMenu("帮助")) {
@@ -616,12 +521,31 @@ public:
         ImGui::SetNextWindowPos(ImVec2());
         ImGui::SetNextWindowSize(size);
         if (ImGui::Begin("工作区", nullptr, ImGuiWindowFlags_MenuBar | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoBackground)) {
+            pollBleedingTask();
             layoutMainMenu();
             ImGui::Text("打开的文件：%s", m_open_file_path.c_str());
+            if (m_bleeding_task.running()) {
+                if (ImGui::Button("取消")) {
+                    m_bleeding_task.cancel();
+                }
+                ImGui::SameLine();
+                ImGui::ProgressBar(m_bleeding_task.progress(), ImVec2(-FLT_MIN, 0.0f), "正在处理透明像素");
+            }
             if (m_opened_texture) {
                 D3D11_TEXTURE2D_DESC texture_info{};
                 m_opened_texture->GetDesc(&texture_info);
                 ImGui::Text("图像尺寸：%u x %u", texture_info.Width, texture_info.Height);
+                if (m_block_compression_stats) {
+                    ImGui::SameLine();
+                    ImGui::Text(
+                        "4x4 块：%u（不透明 %u，透明 %u，混合 %u，调整像素 %u）",
+                        m_block_compression_stats->block_count,
+                        m_block_compression_stats->opaque_block_count,
+                        m_block_compression_stats->transparent_block_count,
+                        m_block_compression_stats->mixed_block_count,
+                        m_block_compression_stats->adjusted_texel_count
+                    );
+                }
 
                 ImGui::SameLine();
                 auto const slider_size = ImGui::GetContentRegionAvail();
@@ -653,6 +577,34 @@ public:
         ImGui::End();
     }
 
+    void layoutHistoryWindow() {
+        if (!m_show_history_window) {
+            return;
+        }
+        if (ImGui::Begin("历史记录", &m_show_history_window)) {
+            auto const usage = m_history.memoryUsage();
+            ImGui::Text(
+                "快照 %zu 个，区块 %zu 个，占用 %.2f MiB（完整复制需要 %.2f MiB）",
+                usage.snapshot_count, usage.tile_count,
+                static_cast<double>(usage.stored_bytes) / 1048576.0,
+                static_cast<double>(usage.full_copy_bytes) / 1048576.0
+            );
+            ImGui::Separator();
+            auto const& entries = m_history.entries();
+            for (size_t i = 0; i < entries.size(); ++i) {
+                std::visit([&](auto const& snapshot) -> void {
+                    ImGui::Text(
+                        "%s %s：新增区块 %zu / %zu（%.2f MiB）",
+                        i == m_history.current() ? ">" : " ", entries[i].label.c_str(),
+                        snapshot.newTileCount(), snapshot.tiles().size(),
+                        static_cast<double>(snapshot.newBytes()) / 1048576.0
+                    );
+                }, entries[i].snapshot);
+            }
+        }
+        ImGui::End();
+    }
+
     void layoutAboutWindow() {
         if (m_want_show_about_window) {
             m_want_show_about_window = false;
@@ -693,6 +645,7 @@ public:
         if (m_show_demo_window) {
             ImGui::ShowDemoWindow(&m_show_demo_window);
         }
+        layoutHistoryWindow();
         layoutAboutWindow();
         ImGui::EndFrame();
         ImGui::Render();
@@ -758,15 +711,26 @@ private:
     bool m_show_demo_window{false};
     bool m_want_show_about_window{false};
 
-    wil::com_ptr<IWICImagingFactory> m_wic_factory;
+    // no texture holds more pixels, which also bounds what a malformed header can make the decoder allocate
+    static constexpr image::ResourceLimits load_limits{
+        .max_pixels = uint64_t{D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION} * D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION,
+    };
+
+    wic::ImageCodec m_codec;
 
     wil::com_ptr<ID3D11SamplerState> m_sampler_state_point;
     wil::com_ptr<ID3D11BlendState> m_blend_state_one;
 
     bool m_opened{false};
-    bool m_image_processed{false};
     std::string m_open_file_path;
-    Image2D m_image;
+    image::AnyImage2D m_image;
+    image::BleedingTask m_bleeding_task;
+    image::History m_history;
+    bool m_show_history_window{false};
+    float m_alpha_threshold{0.0f};
+    image::BleedingKernel m_bleeding_kernel;
+    bool m_optimize_for_block_compression{false};
+    std::optional<image::BlockCompressionStats> m_block_compression_stats;
     wil::com_ptr<ID3D11Texture2D> m_opened_texture;
     wil::com_ptr<ID3D11ShaderResourceView> m_opened_srv;
 
@@ -0,0 +1,254 @@
+#pragma once
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "png/Apng.hpp"
+#include "Checks.hpp"
+#include "HistoryChecks.hpp"
+#include "PngDecoder.hpp"
+
+namespace regress {
+    namespace detail {
+        // an RGBA PNG of 8 or 16 bit channels, deflate in stored blocks and the image data split into IDAT chunks
+        // of idat_size bytes, so joining and splitting handle frames of several chunks
+        [[nodiscard]] inline std::vector<uint8_t> encodePng(image::AnyImage2D const& image, size_t const idat_size = 1000) {
+            std::vector<uint8_t> rows;
+            std::visit([&](auto const& pixels) -> void {
+                for (uint32_t y = 0; y < pixels.height(); ++y) {
+                    rows.push_back(0);
+                    for (uint32_t x = 0; x < pixels.width(); ++x) {
+                        auto const& pixel = pixels.pixel(x, y);
+                        for (auto const channel : {pixel.r, pixel.g, pixel.b, pixel.a}) {
+                            if constexpr (sizeof(channel) == 2) {
+                                png::detail::appendBigEndian16(rows, channel);
+                            }
+                            else {
+                                rows.push_back(static_cast<uint8_t>(channel));
+                            }
+                        }
+                    }
+                }
+            }, image.variant());
+
+            std::vector<uint8_t> zlib{0x78, 0x01};
+            for (size_t offset = 0; offset < rows.size(); offset += 65535) {
+                auto const length = static_cast<uint16_t>(std::min<size_t>(65535, rows.size() - offset));
+                zlib.push_back(offset + length == rows.size() ? 1 : 0);
+                zlib.insert(zlib.end(), {
+                    static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                    static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8),
+                });
+                zlib.insert(zlib.end(), rows.begin() + static_cast<ptrdiff_t>(offset), rows.begin() + static_cast<ptrdiff_t>(offset + length));
+            }
+            uint32_t a = 1;
+            uint32_t b = 0;
+            for (auto const byte : rows) {
+                a = (a + byte) % 65521;
+                b = (b + a) % 65521;
+            }
+            png::detail::appendBigEndian32(zlib, b << 16 | a);
+
+            std::vector<uint8_t> file(png::signature.begin(), png::signature.end());
+            std::vector<uint8_t> header;
+            png::detail::appendBigEndian32(header, image.width());
+            png::detail::appendBigEndian32(header, image.height());
+            header.insert(header.end(), {static_cast<uint8_t>(image.format() == image::PixelFormat::RGBA16 ? 16 : 8), 6, 0, 0, 0});
+            png::detail::appendChunk(file, "IHDR", header);
+            for (size_t offset = 0; offset < zlib.size(); offset += idat_size) {
+                png::detail::appendChunk(file, "IDAT", std::span{zlib}.subspan(offset, std::min(idat_size, zlib.size() - offset)));
+            }
+            png::detail::appendChunk(file, "IEND", {});
+            return file;
+        }
+
+        // the chunks of file written again, edit changes their data and drops those it returns false for
+        [[nodiscard]] inline std::vector<uint8_t> editChunks(
+            std::vector<uint8_t> const& file, std::function<bool(std::string_view type, std::vector<uint8_t>& data)> const& edit
+        ) {
+            std::vector<uint8_t> edited(png::signature.begin(), png::signature.end());
+            for (auto const& chunk : png::detail::readChunks(file)) {
+                std::vector<uint8_t> data(chunk.data.begin(), chunk.data.end());
+                if (edit(chunk.type, data)) {
+                    png::detail::appendChunk(edited, chunk.type, data);
+                }
+            }
+            return edited;
+        }
+
+        [[nodiscard]] inline bool sameControl(png::FrameControl const& a, png::FrameControl const& b) noexcept {
+            return a.width == b.width && a.height == b.height && a.x == b.x && a.y == b.y
+                && a.delay.numerator == b.delay.numerator && a.delay.denominator == b.delay.denominator
+                && a.dispose == b.dispose && a.blend == b.blend;
+        }
+
+        [[nodiscard]] inline bool throws(std::function<void()> const& action) {
+            try {
+                action();
+            }
+            catch (std::runtime_error const&) {
+                return true;
+            }
+            return false;
+        }
+    }
+
+    // APNG frames survive joinAnimation and splitAnimation, the split streams decode as plain PNG and AnimationCanvas
+    // composites them by their dispose and blend ops like a straightforward reference does. Malformed files are rejected.
+    inline void checkApng(CheckLog& log) {
+        using namespace image;
+        uint32_t const width = 40;
+        uint32_t const height = 30;
+        std::vector<png::FrameControl> const controls{
+            {width, height, 0, 0, png::Delay{1, 10}, png::DisposeOp::None, png::BlendOp::Source},
+            {10, 8, 5, 4, png::Delay{3, 100}, png::DisposeOp::Background, png::BlendOp::Over},
+            {12, 12, 20, 10, png::Delay{0, 0}, png::DisposeOp::Previous, png::BlendOp::Source},
+            {8, 8, 0, 0, png::Delay{1, 1}, png::DisposeOp::None, png::BlendOp::Over},
+            {40, 2, 0, 28, png::Delay{2, 10}, png::DisposeOp::Previous, png::BlendOp::Over},
+        };
+
+        for (auto const format : {PixelFormat::BGRA8, PixelFormat::RGBA16}) {
+            auto const name = std::string("apng/") + (format == PixelFormat::BGRA8 ? "bgra8" : "rgba16");
+            std::vector<AnyImage2D> frames;
+            std::vector<std::vector<uint8_t>> streams;
+            for (size_t i = 0; i < controls.size(); ++i) {
+                auto& frame = frames.emplace_back();
+                frame.resize(format, controls[i].width, controls[i].height);
+                detail::fill(frame, Rect{0, 0, frame.width(), frame.height()}, static_cast<uint32_t>(i + 1) * 0x1234567u);
+                streams.push_back(detail::encodePng(frame));
+            }
+            auto const file = png::joinAnimation(streams, controls, 3);
+
+            auto const animation = png::splitAnimation(file);
+            auto same = animation && animation->width == width && animation->height == height && animation->play_count == 3
+                && animation->controls.size() == controls.size() && animation->frames.size() == controls.size();
+            for (size_t i = 0; same && i < controls.size(); ++i) {
+                same = detail::sameControl(animation->controls[i], controls[i]) && detail::sameImage(decodePng(animation->frames[i]), frames[i]);
+            }
+            log.expect(same, name + " join and split round trip");
+            log.expect(!png::splitAnimation(streams.front()), name + " plain PNG is no animation");
+            if (!animation) {
+                continue;
+            }
+
+            // the reference composites pixel by pixel, the frames have only transparent and opaque pixels
+            AnyImage2D expected;
+            expected.resize(format, width, height);
+            png::AnimationCanvas canvas;
+            canvas.reset(format, width, height);
+            auto composited = true;
+            std::optional<png::FrameControl> last;
+            AnyImage2D previous;
+            for (size_t i = 0; i < controls.size(); ++i) {
+                auto const& control = controls[i];
+                std::visit([&](auto& target) -> void {
+                    using Image = std::decay_t<decltype(target)>;
+                    if (last && last->dispose != png::DisposeOp::None) {
+                        auto const& before = std::get<Image>(previous.variant());
+                        for (uint32_t y = last->y; y < last->y + last->height; ++y) {
+                            for (uint32_t x = last->x; x < last->x + last->width; ++x) {
+                                target.pixel(x, y) = last->dispose == png::DisposeOp::Background ? typename Image::PixelType{} : before.pixel(x, y);
+                            }
+                        }
+                    }
+                    previous = expected;
+                    auto const& source = std::get<Image>(frames[i].variant());
+                    for (uint32_t y = 0; y < control.height; ++y) {
+                        for (uint32_t x = 0; x < control.width; ++x) {
+                            auto const& pixel = source.pixel(x, y);
+                            if (control.blend == png::BlendOp::Source || pixel.a != 0) {
+                                target.pixel(control.x + x, control.y + y) = pixel;
+                            }
+                        }
+                    }
+                }, expected.variant());
+                last = control;
+                auto const& rendered = canvas.render(decodePng(animation->frames[i]), animation->controls[i]);
+                composited = composited && detail::sameImage(rendered, expected);
+            }
+            log.expect(composited, name + " frames composited by their dispose and blend ops");
+        }
+
+        // partly transparent pixels blend like the APNG spec shows
+        {
+            PixelBGRA8 target{0, 0, 100, 255};
+            png::detail::blendOver(target, PixelBGRA8{0, 0, 200, 128});
+            PixelBGRA8 clear{};
+            png::detail::blendOver(clear, PixelBGRA8{10, 20, 30, 128});
+            log.expect(target.r == 150 && target.a == 255 && clear.r == 30 && clear.b == 10 && clear.a == 128, "apng/blend over");
+        }
+
+        std::vector<AnyImage2D> frames(2);
+        frames[0].resize(PixelFormat::BGRA8, 16, 16);
+        frames[1].resize(PixelFormat::BGRA8, 8, 8);
+        detail::fill(frames[0], Rect{0, 0, 16, 16}, 11);
+        detail::fill(frames[1], Rect{0, 0, 8, 8}, 12);
+        std::vector<std::vector<uint8_t>> const streams{detail::encodePng(frames[0]), detail::encodePng(frames[1], 64)};
+        std::vector<png::FrameControl> const controls_16{
+            {16, 16, 0, 0, png::Delay{}, png::DisposeOp::None, png::BlendOp::Source},
+            {8, 8, 4, 6, png::Delay{}, png::DisposeOp::None, png::BlendOp::Over},
+        };
+        auto const file = png::joinAnimation(streams, controls_16, 0);
+
+        // a default image without a fcTL is shown by plain decoders only, the animation starts with the next frame
+        auto const hidden_default = detail::editChunks(file, [](std::string_view const type, std::vector<uint8_t>& data) -> bool {
+            if (type == "fcTL" || type == "fdAT") {
+                auto const sequence = png::detail::readBigEndian32(data.data());
+                if (sequence == 0) {
+                    return false;
+                }
+                std::vector<uint8_t> renumbered;
+                png::detail::appendBigEndian32(renumbered, sequence - 1);
+                std::copy(renumbered.begin(), renumbered.end(), data.begin());
+            }
+            if (type == "acTL") {
+                data[3] = 1;
+            }
+            return true;
+        });
+        auto const hidden = png::splitAnimation(hidden_default);
+        log.expect(hidden && hidden->controls.size() == 1 && detail::sameControl(hidden->controls.front(), controls_16[1])
+            && detail::sameImage(decodePng(hidden->frames.front()), frames[1]), "apng/default image left out of the animation");
+
+        auto const rejects = [&](std::vector<uint8_t> const& malformed) -> bool {
+            return detail::throws([&]() -> void { static_cast<void>(png::splitAnimation(malformed)); });
+        };
+        log.expect(rejects(detail::editChunks(file, [](std::string_view const type, std::vector<uint8_t>& data) -> bool {
+            if (type == "acTL") {
+                data[3] = 3;
+            }
+            return true;
+        })), "apng/rejects a frame count other than acTL's");
+        log.expect(rejects(detail::editChunks(file, [](std::string_view const type, std::vector<uint8_t>& data) -> bool {
+            if (type == "fcTL" && data[3] == 1) {
+                data[15] = 9; // x of 9 puts the 8 pixels wide frame past the 16 pixels wide canvas
+            }
+            return true;
+        })), "apng/rejects a frame leaving the canvas");
+        log.expect(rejects(detail::editChunks(file, [](std::string_view const type, std::vector<uint8_t>&) -> bool {
+            return type != "fcTL";
+        })), "apng/rejects frames without fcTL");
+        log.expect(rejects(detail::editChunks(file, [](std::string_view const type, std::vector<uint8_t>& data) -> bool {
+            if (type == "fdAT" && png::detail::readBigEndian32(data.data()) == 3) {
+                data[3] = 7;
+            }
+            return true;
+        })), "apng/rejects fdAT out of sequence");
+        auto corrupted = file;
+        corrupted[corrupted.size() - 20] ^= 0x40;
+        log.expect(rejects(corrupted), "apng/rejects a chunk failing its checksum");
+
+        // the streams of one APNG must share their pixel format, the first covers the canvas
+        AnyImage2D wide;
+        wide.resize(PixelFormat::RGBA16, 8, 8);
+        std::vector<std::vector<uint8_t>> const mixed{streams[0], detail::encodePng(wide)};
+        log.expect(detail::throws([&]() -> void { static_cast<void>(png::joinAnimation(mixed, controls_16, 0)); }),
+            "apng/join rejects frames of another pixel format");
+        std::vector<png::FrameControl> offset = controls_16;
+        offset[0].x = 1;
+        log.expect(detail::throws([&]() -> void { static_cast<void>(png::joinAnimation(streams, offset, 0)); }),
+            "apng/join rejects a first frame off the canvas");
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <chrono>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "image/BleedingTask.hpp"
+#include "Checks.hpp"
+#include "Corpus.hpp"
+#include "DirtyRegionChecks.hpp"
+
+namespace regress {
+    namespace detail {
+        // polls like the UI does: uploads every staged preview into texture until the run's result is available
+        inline image::BleedingResult finishTask(image::BleedingTask& task, image::AnyImage2D& target, image::BleedingTask::UploadCallback const& upload) {
+            for (;;) {
+                task.uploadPreview(upload);
+                if (auto result = task.takeResult(target); result) {
+                    return *result;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+        }
+
+        [[nodiscard]] inline bool sameBytes(image::AnyImage2D const& a, image::AnyImage2D const& b) {
+            return a.format() == b.format() && a.width() == b.width() && a.height() == b.height()
+                && std::memcmp(a.buffer<uint8_t>(), b.buffer<uint8_t>(), a.size()) == 0;
+        }
+
+        // every pixel of staged is the pixel of before or of after, bleeding sets each transparent pixel only once
+        [[nodiscard]] inline bool between(image::AnyImage2D const& staged, image::AnyImage2D const& before, image::AnyImage2D const& after) {
+            auto const pixel_size = staged.pixelSize();
+            for (size_t offset = 0; offset < staged.size(); offset += pixel_size) {
+                auto const* const pixel = staged.buffer<uint8_t>() + offset;
+                if (std::memcmp(pixel, before.buffer<uint8_t>() + offset, pixel_size) != 0
+                    && std::memcmp(pixel, after.buffer<uint8_t>() + offset, pixel_size) != 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    // BleedingTask without a UI: a completed run gives the pixels of doPixelBleeding, a cancelled run leaves the
+    // target alone and the texture the previews are uploaded into always matches the staged image
+    inline void checkBleedingTask(CheckLog& log) {
+        using namespace image;
+        BleedingTask task;
+        auto const ignore = [](AnyImage2D const&, DirtyRegion const&) -> void {};
+
+        for (auto const& entry : generateCorpus()) {
+            if (entry.frames.size() != 1) {
+                continue;
+            }
+            auto const& source = entry.frames.front();
+            for (auto const traversal : {BleedingTraversal::RowMajor, BleedingTraversal::Frontier, BleedingTraversal::JumpFlood}) {
+                for (bool const block_compression : {false, true}) {
+                    BleedingOptions const options{entry.alpha_threshold, BleedingKernel{.traversal = traversal}, block_compression};
+                    auto expected = source;
+                    expected.doPixelBleeding(options.alpha_threshold, options.kernel, {});
+                    if (block_compression) {
+                        expected.optimizeForBlockCompression(options.alpha_threshold);
+                    }
+                    auto target = source;
+                    task.start(source, options);
+                    auto const result = detail::finishTask(task, target, ignore);
+                    auto const name = "task/" + entry.name + " " + std::to_string(static_cast<int>(traversal)) + (block_compression ? "+bc" : "");
+                    log.expect(result.completed && detail::sameBytes(target, expected), name + " equals doPixelBleeding");
+                    log.expect(result.block_compression_stats.has_value() == block_compression, name + " block stats");
+                    auto covered = true;
+                    for (uint32_t y = 0; y < source.height(); ++y) {
+                        for (uint32_t x = 0; x < source.width(); ++x) {
+                            auto const offset = static_cast<size_t>(y) * source.pitch() + static_cast<size_t>(x) * source.pixelSize();
+                            covered = covered && (std::memcmp(source.buffer<uint8_t>() + offset, target.buffer<uint8_t>() + offset, source.pixelSize()) == 0
+                                || detail::covers(result.changed, x, y));
+                        }
+                    }
+                    log.expect(covered, name + " changed region");
+                }
+            }
+        }
+
+        // a run of seconds, cancelled right away
+        {
+            auto const sheet = generateSpriteSheet(PixelFormat::BGRA8, 1024, 1024);
+            AnyImage2D sentinel;
+            sentinel.resize(PixelFormat::RGBA16, 3, 2);
+            auto target = sentinel;
+            task.start(sheet, BleedingOptions{0.0f, BleedingKernel{.traversal = BleedingTraversal::RowMajor}, false});
+            task.cancel();
+            auto const result = detail::finishTask(task, target, ignore);
+            log.expect(!result.completed && detail::sameBytes(target, sentinel) && !task.running(), "task/cancel leaves the target alone");
+            log.expect(!task.takeResult(target).has_value(), "task/result taken once");
+        }
+
+        // the texture starts as the source and gets the staged image's rects of every upload. After each upload it
+        // equals the staged image, which lies between the source and the bled image. The second run reuses staging
+        // buffers that hold the pixels of the first, with every other row made transparent, the third changes the format.
+        for (uint32_t run = 0; run < 3; ++run) {
+            auto source = generateSpriteSheet(run == 2 ? PixelFormat::RGBA16 : PixelFormat::BGRA8, 512, 384);
+            if (run == 1) {
+                std::visit([](auto& pixels) -> void {
+                    for (uint32_t y = 0; y < pixels.height(); y += 2) {
+                        for (uint32_t x = 0; x < pixels.width(); ++x) {
+                            pixels.pixel(x, y).a = {};
+                        }
+                    }
+                }, source.variant());
+            }
+            BleedingOptions const options{0.0f, BleedingKernel{.traversal = BleedingTraversal::RowMajor}, false};
+            auto expected = source;
+            expected.doPixelBleeding(options.alpha_threshold, options.kernel, {});
+            auto texture = source;
+            size_t upload_count{};
+            auto consistent = true;
+            task.start(source, options);
+            auto target = source;
+            auto const result = detail::finishTask(task, target, [&](AnyImage2D const& staged, DirtyRegion const& region) -> void {
+                ++upload_count;
+                copyRegion(texture.buffer<uint8_t>(), texture.pitch(), staged.buffer<uint8_t>(), staged.pitch(), region, staged.pixelSize());
+                consistent = consistent && detail::sameBytes(texture, staged) && detail::between(staged, source, expected);
+            });
+            auto const name = "task/preview run " + std::to_string(run);
+            log.expect(upload_count > 0 && consistent, name + " texture matches the staged image");
+            log.expect(result.completed && detail::sameBytes(texture, expected) && detail::sameBytes(target, expected), name + " final preview");
+        }
+    }
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "image/AnyImage2D.hpp"
+
+// A stand-in for the BC3/BC7 encoders bled textures go to: the color half of a BC3 block, two RGB565 endpoints
+// and a 2 bit index per texel. Endpoints start on the principal axis of the 16 texels and are refit by least
+// squares until the error stops falling, the way cluster fits of real encoders work. Like those it sees every
+// texel's color, alpha is a separate block in BC3 and left out. Only opaque texels count towards the error.
+namespace regress {
+    struct BlockEncoding {
+        uint64_t block_count{};
+        uint64_t refit_count{}; // least squares refits over all blocks, the part of the time that depends on the colors
+        uint64_t opaque_texel_count{};
+        double opaque_squared_error{}; // over the color channels of opaque texels, in 8 bit steps
+
+        [[nodiscard]] double opaqueRmse() const noexcept {
+            return opaque_texel_count > 0 ? std::sqrt(opaque_squared_error / static_cast<double>(opaque_texel_count * 3)) : 0.0;
+        }
+    };
+
+    namespace detail {
+        struct Rgb {
+            float r{};
+            float g{};
+            float b{};
+        };
+
+        [[nodiscard]] inline Rgb mix(Rgb const& a, Rgb const& b, float const t) noexcept {
+            return Rgb{a.r + (b.r - a.r) * t, a.g + (b.g - a.g) * t, a.b + (b.b - a.b) * t};
+        }
+
+        [[nodiscard]] inline float distance2(Rgb const& a, Rgb const& b) noexcept {
+            return (a.r - b.r) * (a.r - b.r) + (a.g - b.g) * (a.g - b.g) + (a.b - b.b) * (a.b - b.b);
+        }
+
+        // the closest color an RGB565 endpoint can hold
+        [[nodiscard]] inline Rgb quantize565(Rgb const& color) noexcept {
+            auto const channel = [](float const value, float const levels) -> float {
+                auto const step = std::round(std::clamp(value, 0.0f, 255.0f) * levels / 255.0f);
+                return step * 255.0f / levels;
+            };
+            return Rgb{channel(color.r, 31.0f), channel(color.g, 63.0f), channel(color.b, 31.0f)};
+        }
+
+        struct ColorBlock {
+            std::array<Rgb, 16> colors{};
+            std::array<bool, 16> opaque{};
+            uint32_t count{};
+        };
+
+        // weight of the second endpoint for each index, BC1 order: e0, e1, 2/3 e0 + 1/3 e1, 1/3 e0 + 2/3 e1
+        inline constexpr float index_weights[4]{0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+
+        // picks the nearest palette entry for every texel, returns the summed error of all texels
+        inline float assignIndices(ColorBlock const& block, Rgb const& e0, Rgb const& e1, std::array<uint8_t, 16>& indices) noexcept {
+            Rgb palette[4];
+            for (int i = 0; i < 4; ++i) {
+                palette[i] = mix(e0, e1, index_weights[i]);
+            }
+            float error{};
+            for (uint32_t i = 0; i < block.count; ++i) {
+                auto best = distance2(block.colors[i], palette[0]);
+                indices[i] = 0;
+                for (uint8_t index = 1; index < 4; ++index) {
+                    if (auto const d = distance2(block.colors[i], palette[index]); d < best) {
+                        best = d;
+                        indices[i] = index;
+                    }
+                }
+                error += best;
+            }
+            return error;
+        }
+
+        inline void encodeBlock(ColorBlock const& block, BlockEncoding& encoding) {
+            Rgb mean{};
+            for (uint32_t i = 0; i < block.count; ++i) {
+                mean.r += block.colors[i].r;
+                mean.g += block.colors[i].g;
+                mean.b += block.colors[i].b;
+            }
+            auto const n = static_cast<float>(block.count);
+            mean = Rgb{mean.r / n, mean.g / n, mean.b / n};
+            float covariance[6]{};
+            for (uint32_t i = 0; i < block.count; ++i) {
+                auto const r = block.colors[i].r - mean.r;
+                auto const g = block.colors[i].g - mean.g;
+                auto const b = block.colors[i].b - mean.b;
+                covariance[0] += r * r;
+                covariance[1] += r * g;
+                covariance[2] += r * b;
+                covariance[3] += g * g;
+                covariance[4] += g * b;
+                covariance[5] += b * b;
+            }
+            Rgb axis{1.0f, 1.0f, 1.0f};
+            for (int iteration = 0; iteration < 8; ++iteration) {
+                Rgb const next{
+                    covariance[0] * axis.r + covariance[1] * axis.g + covariance[2] * axis.b,
+                    covariance[1] * axis.r + covariance[3] * axis.g + covariance[4] * axis.b,
+                    covariance[2] * axis.r + covariance[4] * axis.g + covariance[5] * axis.b,
+                };
+                auto const length = std::sqrt(next.r * next.r + next.g * next.g + next.b * next.b);
+                if (length < 1e-6f) {
+                    break;
+                }
+                axis = Rgb{next.r / length, next.g / length, next.b / length};
+            }
+            auto t_min = 0.0f;
+            auto t_max = 0.0f;
+            for (uint32_t i = 0; i < block.count; ++i) {
+                auto const t = (block.colors[i].r - mean.r) * axis.r + (block.colors[i].g - mean.g) * axis.g + (block.colors[i].b - mean.b) * axis.b;
+                t_min = std::min(t_min, t);
+                t_max = std::max(t_max, t);
+            }
+            auto e0 = quantize565(Rgb{mean.r + axis.r * t_min, mean.g + axis.g * t_min, mean.b + axis.b * t_min});
+            auto e1 = quantize565(Rgb{mean.r + axis.r * t_max, mean.g + axis.g * t_max, mean.b + axis.b * t_max});
+            std::array<uint8_t, 16> indices{};
+            auto error = assignIndices(block, e0, e1, indices);
+
+            for (int refit = 0; refit < 8 && error > 0.0f; ++refit) {
+                ++encoding.refit_count;
+                float aa{};
+                float ab{};
+                float bb{};
+                Rgb x{};
+                Rgb y{};
+                for (uint32_t i = 0; i < block.count; ++i) {
+                    auto const t = index_weights[indices[i]];
+                    auto const s = 1.0f - t;
+                    aa += s * s;
+                    ab += s * t;
+                    bb += t * t;
+                    x = Rgb{x.r + s * block.colors[i].r, x.g + s * block.colors[i].g, x.b + s * block.colors[i].b};
+                    y = Rgb{y.r + t * block.colors[i].r, y.g + t * block.colors[i].g, y.b + t * block.colors[i].b};
+                }
+                auto const determinant = aa * bb - ab * ab;
+                if (std::abs(determinant) < 1e-6f) {
+                    break;
+                }
+                auto const solve = [&](float const xc, float const yc) -> std::pair<float, float> {
+                    return {(bb * xc - ab * yc) / determinant, (aa * yc - ab * xc) / determinant};
+                };
+                auto const [r0, r1] = solve(x.r, y.r);
+                auto const [g0, g1] = solve(x.g, y.g);
+                auto const [b0, b1] = solve(x.b, y.b);
+                auto const f0 = quantize565(Rgb{r0, g0, b0});
+                auto const f1 = quantize565(Rgb{r1, g1, b1});
+                std::array<uint8_t, 16> refit_indices{};
+                auto const refit_error = assignIndices(block, f0, f1, refit_indices);
+                if (refit_error >= error) {
+                    break;
+                }
+                e0 = f0;
+                e1 = f1;
+                indices = refit_indices;
+                error = refit_error;
+            }
+
+            for (uint32_t i = 0; i < block.count; ++i) {
+                if (block.opaque[i]) {
+                    ++encoding.opaque_texel_count;
+                    encoding.opaque_squared_error += distance2(block.colors[i], mix(e0, e1, index_weights[indices[i]]));
+                }
+            }
+            ++encoding.block_count;
+        }
+    }
+
+    [[nodiscard]] inline BlockEncoding encodeColorBlocks(image::AnyImage2D const& image, float const alpha_threshold) {
+        BlockEncoding encoding;
+        std::visit([&](auto const& pixels) -> void {
+            using Pixel = typename std::decay_t<decltype(pixels)>::PixelType;
+            using Traits = image::PixelTraits<Pixel>;
+            auto const cutoff = Traits::alphaCutoff(alpha_threshold);
+            auto const to8 = [](typename Traits::Channel const value) -> float {
+                return static_cast<float>(value) * 255.0f / static_cast<float>(Traits::alpha_max);
+            };
+            detail::ColorBlock block;
+            for (uint32_t y0 = 0; y0 < pixels.height(); y0 += 4) {
+                for (uint32_t x0 = 0; x0 < pixels.width(); x0 += 4) {
+                    block.count = 0;
+                    for (uint32_t y = y0; y < std::min(y0 + 4, pixels.height()); ++y) {
+                        for (uint32_t x = x0; x < std::min(x0 + 4, pixels.width()); ++x) {
+                            auto const& pixel = pixels.pixel(x, y);
+                            block.colors[block.count] = detail::Rgb{to8(pixel.r), to8(pixel.g), to8(pixel.b)};
+                            block.opaque[block.count] = image::isOpaque(pixel, cutoff);
+                            ++block.count;
+                        }
+                    }
+                    detail::encodeBlock(block, encoding);
+                }
+            }
+        }, image.variant());
+        return encoding;
+    }
+}
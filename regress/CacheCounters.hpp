@@ -0,0 +1,93 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace regress {
+    struct CacheMisses {
+        uint64_t l1d_read{}; // level 1 data cache read misses
+        uint64_t last_level{}; // last level cache misses, the ones that go to memory
+    };
+
+    // Hardware cache miss counters of the calling thread through perf_event_open, Linux only. Worker threads of the
+    // parallel passes are not counted, run pinned to one core (taskset -c 0) to keep all work on this thread.
+    // Without the system call, e.g. in containers or with perf_event_paranoid above 2, stop returns nullopt.
+    class CacheCounters {
+    public:
+        CacheCounters() {
+#ifdef __linux__
+            m_l1d_read = openCounter(
+                PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+            );
+            m_last_level = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+        }
+
+        CacheCounters(CacheCounters const&) = delete;
+        CacheCounters& operator=(CacheCounters const&) = delete;
+
+        ~CacheCounters() {
+#ifdef __linux__
+            for (auto const fd : {m_l1d_read, m_last_level}) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        [[nodiscard]] bool available() const noexcept {
+            return m_l1d_read >= 0 && m_last_level >= 0;
+        }
+
+        void start() noexcept {
+#ifdef __linux__
+            if (available()) {
+                for (auto const fd : {m_l1d_read, m_last_level}) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+#endif
+        }
+
+        [[nodiscard]] std::optional<CacheMisses> stop() noexcept {
+#ifdef __linux__
+            if (available()) {
+                for (auto const fd : {m_l1d_read, m_last_level}) {
+                    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                }
+                CacheMisses misses;
+                if (read(m_l1d_read, &misses.l1d_read, sizeof(uint64_t)) == sizeof(uint64_t)
+                    && read(m_last_level, &misses.last_level, sizeof(uint64_t)) == sizeof(uint64_t)) {
+                    return misses;
+                }
+            }
+#endif
+            return std::nullopt;
+        }
+
+    private:
+#ifdef __linux__
+        [[nodiscard]] static int openCounter(uint32_t const type, uint64_t const config) noexcept {
+            perf_event_attr attributes{};
+            attributes.size = sizeof(attributes);
+            attributes.type = type;
+            attributes.config = config;
+            attributes.disabled = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+        }
+#endif
+
+        int m_l1d_read{-1};
+        int m_last_level{-1};
+    };
+}
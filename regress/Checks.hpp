@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace regress {
+    // Results of the self checks, which cover components without an output image of their own, e.g. the
+    // protocol or the dirty region. A failed expectation prints a CHECK line and fails the run like a mismatch.
+    // Checks may run in parallel.
+    class CheckLog {
+    public:
+        void expect(bool const condition, std::string_view const name) {
+            std::scoped_lock lock(m_mutex);
+            ++m_count;
+            if (!condition) {
+                ++m_failures;
+                std::printf("CHECK    %.*s\n", static_cast<int>(name.size()), name.data());
+            }
+        }
+
+        [[nodiscard]] size_t count() const noexcept {
+            return m_count;
+        }
+
+        [[nodiscard]] size_t failures() const noexcept {
+            return m_failures;
+        }
+
+    private:
+        std::mutex m_mutex;
+        size_t m_count{};
+        size_t m_failures{};
+    };
+}
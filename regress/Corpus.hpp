@@ -0,0 +1,180 @@
+#pragma once
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "image/AnyImage2D.hpp"
+
+// Generated regression images. Everything is derived from std::mt19937, whose output the standard fixes,
+// and from integer arithmetic only, so every platform and standard library builds the same pixels.
+namespace regress {
+    struct CorpusImage {
+        std::string name;
+        float alpha_threshold{0.0f};
+        std::vector<image::AnyImage2D> frames; // more than one runs through image::bleedFrames
+    };
+
+    namespace detail {
+        template <typename Pixel>
+        [[nodiscard]] typename image::PixelTraits<Pixel>::Channel channel(uint32_t const value) {
+            using Traits = image::PixelTraits<Pixel>;
+            if constexpr (Traits::format == image::PixelFormat::RGBA32F) {
+                return static_cast<float>(value & 0xff) / 255.0f;
+            }
+            else if constexpr (Traits::format == image::PixelFormat::RGBA16) {
+                return static_cast<uint16_t>((value & 0xff) * 257);
+            }
+            else {
+                return static_cast<uint8_t>(value & 0xff);
+            }
+        }
+
+        template <typename Pixel>
+        void setPixel(Pixel& pixel, uint32_t const rgb, uint32_t const alpha) {
+            pixel.r = channel<Pixel>(rgb >> 16);
+            pixel.g = channel<Pixel>(rgb >> 8);
+            pixel.b = channel<Pixel>(rgb);
+            pixel.a = channel<Pixel>(alpha);
+        }
+
+        // fill(x, y) returns {rgb, alpha 0..255}
+        template <typename Pixel, typename Fill>
+        [[nodiscard]] image::AnyImage2D generate(uint32_t const width, uint32_t const height, Fill&& fill) {
+            image::Image2D<Pixel> pixels;
+            pixels.resize(width, height);
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    auto const [rgb, alpha] = fill(x, y);
+                    setPixel(pixels.pixel(x, y), rgb, alpha);
+                }
+            }
+            image::AnyImage2D image;
+            image.variant() = std::move(pixels);
+            return image;
+        }
+
+        struct Texel {
+            uint32_t rgb;
+            uint32_t alpha;
+        };
+    }
+
+    // A sprite sheet for the benchmark reports, larger than the corpus images: a disc of random radius with an
+    // antialiased rim in every 128x128 cell, transparent around it. The same pixels in every format.
+    [[nodiscard]] inline image::AnyImage2D generateSpriteSheet(image::PixelFormat const format, uint32_t const width, uint32_t const height) {
+        using detail::Texel;
+        constexpr uint32_t cell{128};
+        struct Disc {
+            int32_t x;
+            int32_t y;
+            int32_t radius;
+        };
+        auto const cells_x = (width + cell - 1) / cell;
+        auto const cells_y = (height + cell - 1) / cell;
+        std::mt19937 rng(3);
+        std::vector<Disc> discs(static_cast<size_t>(cells_x) * cells_y);
+        for (auto& disc : discs) {
+            disc.radius = static_cast<int32_t>(8 + rng() % 40);
+            disc.x = static_cast<int32_t>(disc.radius + rng() % (cell - 2 * disc.radius));
+            disc.y = static_cast<int32_t>(disc.radius + rng() % (cell - 2 * disc.radius));
+        }
+        auto const fill = [&](uint32_t const x, uint32_t const y) -> Texel {
+            auto const& disc = discs[static_cast<size_t>(y / cell) * cells_x + x / cell];
+            auto const dx = static_cast<int32_t>(x % cell) - disc.x;
+            auto const dy = static_cast<int32_t>(y % cell) - disc.y;
+            auto const d2 = dx * dx + dy * dy;
+            auto const inner = (disc.radius - 2) * (disc.radius - 2);
+            auto const outer = disc.radius * disc.radius;
+            auto const alpha = d2 < inner ? 255u : d2 < outer ? static_cast<uint32_t>((outer - d2) * 255 / (outer - inner)) : 0u;
+            return {x * 0x010203u ^ y * 0x030102u, alpha};
+        };
+        switch (format) {
+        case image::PixelFormat::RGBA16:
+            return detail::generate<image::PixelRGBA16>(width, height, fill);
+        case image::PixelFormat::RGBA32F:
+            return detail::generate<image::PixelRGBA32F>(width, height, fill);
+        default:
+            return detail::generate<image::PixelBGRA8>(width, height, fill);
+        }
+    }
+
+    [[nodiscard]] inline std::vector<CorpusImage> generateCorpus() {
+        using namespace image;
+        using detail::Texel;
+        std::vector<CorpusImage> corpus;
+        auto add = [&](std::string name, float const alpha_threshold, image::AnyImage2D image) -> void {
+            auto& entry = corpus.emplace_back(CorpusImage{std::move(name), alpha_threshold, {}});
+            entry.frames.push_back(std::move(image));
+        };
+
+        // few opaque pixels far apart, many passes over mostly transparent pixels
+        {
+            std::mt19937 rng(1);
+            std::vector<uint8_t> dots(160 * 160);
+            for (int i = 0; i < 20; ++i) {
+                dots[rng() % dots.size()] = 1;
+            }
+            add("sparse-dots-bgra8", 0.0f, detail::generate<PixelBGRA8>(160, 160, [&](uint32_t x, uint32_t y) -> Texel {
+                return {x * 977 + y * 131, dots[y * 160 + x] ? 255u : 0u};
+            }));
+        }
+        // a sprite: opaque disc with an antialiased rim, colors vary across the disc
+        add("sprite-disc-rgba16", 0.0f, detail::generate<PixelRGBA16>(120, 90, [](uint32_t x, uint32_t y) -> Texel {
+            auto const dx = static_cast<int>(x) - 60;
+            auto const dy = static_cast<int>(y) - 45;
+            auto const d2 = dx * dx + dy * dy;
+            auto const alpha = d2 < 30 * 30 ? 255u : d2 < 34 * 34 ? static_cast<uint32_t>((34 * 34 - d2) * 255 / (34 * 34 - 30 * 30)) : 0u;
+            return {(x * 3) << 16 | (y * 5) << 8 | ((x + y) & 0xff), alpha};
+        }));
+        // random alpha with a threshold, odd size that leaves partial tiles on both axes
+        {
+            std::mt19937 rng(2);
+            add("noise-rgba32f", 0.3f, detail::generate<PixelRGBA32F>(257, 129, [&](uint32_t, uint32_t) -> Texel {
+                auto const value = static_cast<uint32_t>(rng());
+                return {value & 0xffffff, value % 7 == 0 ? 255u : (value >> 24) % 96};
+            }));
+        }
+        // one pixel wide strokes, ties between diagonal and edge neighbors everywhere
+        add("thin-lines-bgra8", 0.0f, detail::generate<PixelBGRA8>(512, 64, [](uint32_t x, uint32_t y) -> Texel {
+            auto const on = (x + y) % 37 == 0 || (x % 97 == 0 && y % 2 == 0);
+            return {x * 0x010203u + y * 0x030201u, on ? 255u : 0u};
+        }));
+        // one source for the whole image, the longest run of passes
+        add("single-pixel-rgba16", 0.0f, detail::generate<PixelRGBA16>(64, 48, [](uint32_t x, uint32_t y) -> Texel {
+            return {0x4080c0, x == 47 && y == 9 ? 255u : 0u};
+        }));
+        // degenerate shapes, every pixel is on the border
+        add("column-bgra8", 0.0f, detail::generate<PixelBGRA8>(1, 300, [](uint32_t, uint32_t y) -> Texel {
+            return {y * 0x050505u, y % 61 == 3 ? 255u : 0u};
+        }));
+        add("row-rgba32f", 0.0f, detail::generate<PixelRGBA32F>(300, 1, [](uint32_t x, uint32_t) -> Texel {
+            return {x * 0x030507u, x % 45 == 44 ? 255u : 0u};
+        }));
+        // alpha ramp cut by the threshold, half transparent pixels keep their alpha
+        add("alpha-ramp-bgra8", 0.5f, detail::generate<PixelBGRA8>(160, 120, [](uint32_t x, uint32_t y) -> Texel {
+            return {(x ^ y) * 0x010101u, (x * 255 / 159 + y * 3) & 0xff};
+        }));
+        // nothing to bleed
+        add("opaque-rgba16", 0.0f, detail::generate<PixelRGBA16>(128, 128, [](uint32_t x, uint32_t y) -> Texel {
+            return {x << 16 | y, 255u};
+        }));
+        // nothing to bleed from, every pixel is at or below the threshold
+        add("transparent-rgba16", 0.5f, detail::generate<PixelRGBA16>(96, 80, [](uint32_t x, uint32_t y) -> Texel {
+            return {x * 0x020406u + y, (x * 7 + y * 3) % 128};
+        }));
+
+        // an animation: a fixed silhouette with changing colors, then a frame that moves it
+        {
+            CorpusImage animation{"animation-bgra8", 0.0f, {}};
+            for (uint32_t frame = 0; frame < 5; ++frame) {
+                auto const shift = frame < 4 ? 0u : 9u;
+                animation.frames.push_back(detail::generate<PixelBGRA8>(128, 96, [=](uint32_t x, uint32_t y) -> Texel {
+                    auto const inside = (x + shift) % 48 < 16 && y % 32 < 20;
+                    return {(x + frame * 40) << 16 | (y + frame * 17) << 8 | frame * 50, inside ? 255u : 0u};
+                }));
+            }
+            corpus.push_back(std::move(animation));
+        }
+        return corpus;
+    }
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "image/AnyImage2D.hpp"
+#include "Checks.hpp"
+#include "Corpus.hpp"
+
+namespace regress {
+    namespace detail {
+        [[nodiscard]] inline bool sameRects(image::DirtyRegion const& region, std::vector<image::Rect> const& expected) {
+            return region.rects().size() == expected.size() && std::ranges::equal(region.rects(), expected, [](image::Rect const& a, image::Rect const& b) -> bool {
+                return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+            });
+        }
+
+        [[nodiscard]] inline bool covers(image::DirtyRegion const& region, uint32_t const x, uint32_t const y) {
+            return std::ranges::any_of(region.rects(), [&](image::Rect const& rect) -> bool {
+                return rect.contains(image::Rect{x, y, 1, 1});
+            });
+        }
+
+        // every pixel whose bytes differ from before is inside a dirty rect, every rect lies inside the image
+        [[nodiscard]] inline bool dirtyCoversChanges(image::AnyImage2D const& image, std::vector<uint8_t> const& before) {
+            auto const& region = image.dirtyRegion();
+            image::Rect const all{0, 0, image.width(), image.height()};
+            if (!std::ranges::all_of(region.rects(), [&](image::Rect const& rect) -> bool { return all.contains(rect); })) {
+                return false;
+            }
+            auto const pixel_size = image.pixelSize();
+            for (uint32_t y = 0; y < image.height(); ++y) {
+                for (uint32_t x = 0; x < image.width(); ++x) {
+                    auto const offset = static_cast<size_t>(y) * image.pitch() + static_cast<size_t>(x) * pixel_size;
+                    if (std::memcmp(image.buffer<uint8_t>() + offset, before.data() + offset, pixel_size) != 0 && !covers(region, x, y)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        [[nodiscard]] inline std::vector<uint8_t> bytesOf(image::AnyImage2D const& image) {
+            return {image.buffer<uint8_t>(), image.buffer<uint8_t>() + image.size()};
+        }
+    }
+
+    // merging rules of DirtyRegion, the rects every processing step reports and copyRect at the edges of an image
+    inline void checkDirtyRegion(CheckLog& log) {
+        using image::Rect;
+        using image::DirtyRegion;
+
+        {
+            DirtyRegion region;
+            region.add(Rect{3, 4, 0, 5});
+            region.add(Rect{3, 4, 5, 0});
+            log.expect(region.empty(), "dirty/empty rects ignored");
+            region.add(Rect{0, 0, 8, 8});
+            region.add(Rect{2, 2, 3, 3});
+            log.expect(detail::sameRects(region, {{0, 0, 8, 8}}), "dirty/contained rect ignored");
+            region.add(Rect{8, 0, 4, 8});
+            log.expect(detail::sameRects(region, {{0, 0, 12, 8}}), "dirty/adjacent rects merged");
+            region.add(Rect{12, 8, 2, 2});
+            log.expect(detail::sameRects(region, {{0, 0, 14, 10}}), "dirty/corner touching rects merged");
+            region.add(Rect{20, 20, 2, 2});
+            log.expect(detail::sameRects(region, {{0, 0, 14, 10}, {20, 20, 2, 2}}), "dirty/separate rects kept");
+            region.add(Rect{13, 9, 8, 12});
+            log.expect(detail::sameRects(region, {{0, 0, 22, 22}}), "dirty/bridging rect merges all it grows into");
+            log.expect(region.bounds().area() == 22u * 22u, "dirty/bounds");
+            region.clear();
+            log.expect(region.empty() && region.bounds().empty(), "dirty/clear");
+        }
+        {
+            DirtyRegion region;
+            for (uint32_t i = 0; i < DirtyRegion::max_rect_count; ++i) {
+                region.add(Rect{i * 3, i * 2, 1, 1});
+            }
+            log.expect(region.rects().size() == DirtyRegion::max_rect_count, "dirty/max rect count kept");
+            region.add(Rect{100, 1, 1, 1});
+            log.expect(detail::sameRects(region, {{0, 0, 101, (DirtyRegion::max_rect_count - 1) * 2 + 1}}), "dirty/collapse into bounds");
+        }
+        {
+            // random rects: the region covers each of them, its rects are pairwise apart and cover nothing outside the bounds
+            std::mt19937 rng(29);
+            DirtyRegion region;
+            std::vector<Rect> added;
+            for (int i = 0; i < 12; ++i) {
+                Rect const rect{static_cast<uint32_t>(rng() % 200), static_cast<uint32_t>(rng() % 200), static_cast<uint32_t>(rng() % 9), static_cast<uint32_t>(rng() % 9)};
+                region.add(rect);
+                added.push_back(rect);
+            }
+            auto const covered = std::ranges::all_of(added, [&](Rect const& rect) -> bool {
+                return rect.empty() || std::ranges::any_of(region.rects(), [&](Rect const& dirty) -> bool { return dirty.contains(rect); });
+            });
+            auto apart = true;
+            for (size_t i = 0; i < region.rects().size(); ++i) {
+                for (size_t j = i + 1; j < region.rects().size(); ++j) {
+                    apart = apart && !region.rects()[i].touches(region.rects()[j]);
+                }
+            }
+            log.expect(covered && apart, "dirty/random rects covered and apart");
+        }
+
+        {
+            image::AnyImage2D image;
+            image.resize(image::PixelFormat::BGRA8, 10, 6);
+            log.expect(detail::sameRects(image.dirtyRegion(), {{0, 0, 10, 6}}), "dirty/resize marks the whole image");
+            image.clearDirtyRegion();
+            image.markDirty(Rect{8, 4, 10, 10});
+            log.expect(detail::sameRects(image.dirtyRegion(), {{8, 4, 2, 2}}), "dirty/mark clipped to the image");
+            image.clearDirtyRegion();
+            image.markDirty(Rect{10, 0, 3, 3});
+            image.markDirty(Rect{0, 6, 3, 3});
+            log.expect(image.dirtyRegion().empty(), "dirty/mark outside the image ignored");
+            image.applyAlphaThreshold(0.5f);
+            log.expect(image.dirtyRegion().empty(), "dirty/unchanged image stays clean");
+        }
+
+        // every processing step marks at least the pixels it changed, nothing outside the image
+        for (auto const& entry : generateCorpus()) {
+            for (auto const& source : entry.frames) {
+                auto const check = [&](std::string const& step, auto&& process, image::AnyImage2D const& input) -> void {
+                    auto frame = input;
+                    frame.clearDirtyRegion();
+                    auto const before = detail::bytesOf(frame);
+                    process(frame);
+                    log.expect(detail::dirtyCoversChanges(frame, before), "dirty/" + step + " of " + entry.name);
+                };
+                for (auto const traversal : {
+                    image::BleedingTraversal::RowMajor, image::BleedingTraversal::Tiled,
+                    image::BleedingTraversal::Frontier, image::BleedingTraversal::JumpFlood,
+                }) {
+                    image::BleedingKernel const kernel{.traversal = traversal};
+                    check("bleed " + std::to_string(static_cast<int>(traversal)), [&](image::AnyImage2D& frame) -> void {
+                        frame.doPixelBleeding(entry.alpha_threshold, kernel, {});
+                    }, source);
+                }
+                auto bled = source;
+                bled.doPixelBleeding(entry.alpha_threshold);
+                check("block compression", [&](image::AnyImage2D& frame) -> void {
+                    frame.optimizeForBlockCompression(entry.alpha_threshold);
+                }, bled);
+                check("fill", [&](image::AnyImage2D& frame) -> void { frame.fillTransparentPixels(entry.alpha_threshold); }, source);
+                check("threshold", [&](image::AnyImage2D& frame) -> void { frame.applyAlphaThreshold(entry.alpha_threshold); }, source);
+                check("premultiply", [](image::AnyImage2D& frame) -> void { frame.premultiplyAlpha(); }, source);
+                break; // the frames of the animation differ in colors only
+            }
+        }
+
+        // copyRect moves exactly the rect between images of different pitches, also along the last row and column
+        {
+            constexpr uint32_t width{7};
+            constexpr uint32_t height{5};
+            constexpr size_t pixel_size{4};
+            constexpr size_t source_pitch{width * pixel_size};
+            constexpr size_t target_pitch{width * pixel_size + 12};
+            std::vector<uint8_t> source(source_pitch * height);
+            for (size_t i = 0; i < source.size(); ++i) {
+                source[i] = static_cast<uint8_t>(i * 7 + 1);
+            }
+            for (auto const& rect : {
+                Rect{0, 0, width, height}, Rect{0, 0, 1, 1}, Rect{width - 1, height - 1, 1, 1},
+                Rect{width - 1, 0, 1, height}, Rect{0, height - 1, width, 1}, Rect{2, 1, 3, 3}, Rect{4, 2, 0, 2},
+            }) {
+                std::vector<uint8_t> target(target_pitch * height, 0xcd);
+                image::copyRect(target.data(), target_pitch, source.data(), source_pitch, rect, pixel_size);
+                auto exact = true;
+                for (uint32_t y = 0; y < height; ++y) {
+                    for (uint32_t x = 0; x < width; ++x) {
+                        auto const inside = rect.contains(Rect{x, y, 1, 1});
+                        for (size_t byte = 0; byte < pixel_size; ++byte) {
+                            auto const value = target[y * target_pitch + x * pixel_size + byte];
+                            exact = exact && value == (inside ? source[y * source_pitch + x * pixel_size + byte] : 0xcd);
+                        }
+                    }
+                    // the padding past the last pixel of a row is never written
+                    exact = exact && std::all_of(target.begin() + static_cast<ptrdiff_t>(y * target_pitch + source_pitch),
+                        target.begin() + static_cast<ptrdiff_t>((y + 1) * target_pitch), [](uint8_t const value) -> bool { return value == 0xcd; });
+                }
+                log.expect(exact, "dirty/copy rect " + std::to_string(rect.x) + "," + std::to_string(rect.y) + " "
+                    + std::to_string(rect.width) + "x" + std::to_string(rect.height));
+            }
+
+            // copyRegion of a clipped region stays inside the image
+            image::AnyImage2D image;
+            image.resize(image::PixelFormat::BGRA8, width, height);
+            image.clearDirtyRegion();
+            image.markDirty(Rect{5, 3, 100, 100});
+            std::vector<uint8_t> target(target_pitch * height, 0xcd);
+            image::copyRegion(target.data(), target_pitch, source.data(), source_pitch, image.dirtyRegion(), pixel_size);
+            log.expect(target[4 * target_pitch + 6 * pixel_size] == source[4 * source_pitch + 6 * pixel_size]
+                && target[4 * target_pitch + source_pitch] == 0xcd && target[3 * target_pitch + 4 * pixel_size] == 0xcd,
+                "dirty/copy of a clipped region");
+        }
+    }
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "image/History.hpp"
+#include "Checks.hpp"
+#include "Corpus.hpp"
+
+namespace regress {
+    namespace detail {
+        // fills rect with colors from seed, every fourth pixel transparent
+        inline void fill(image::AnyImage2D& frame, image::Rect const& rect, uint32_t const seed) {
+            std::visit([&](auto& pixels) -> void {
+                for (uint32_t y = rect.y; y < rect.bottom(); ++y) {
+                    for (uint32_t x = rect.x; x < rect.right(); ++x) {
+                        setPixel(pixels.pixel(x, y), (x * 0x010307u + y * 0x070301u) ^ seed, (x + y + seed) % 4 == 0 ? 0u : 255u);
+                    }
+                }
+            }, frame.variant());
+            frame.markDirty(rect);
+        }
+
+        [[nodiscard]] inline bool sameImage(image::AnyImage2D const& a, image::AnyImage2D const& b) {
+            return a.format() == b.format() && a.width() == b.width() && a.height() == b.height()
+                && std::memcmp(a.buffer<uint8_t>(), b.buffer<uint8_t>(), a.size()) == 0;
+        }
+
+        // bytes of the tiles of a width x height image that rect touches
+        template <typename Pixel>
+        [[nodiscard]] size_t touchedTileBytes(uint32_t const width, uint32_t const height, image::Rect const& rect) {
+            constexpr auto tile_size = image::TiledSnapshot<Pixel>::tile_size;
+            size_t bytes{};
+            for (uint32_t y = 0; y < height; y += tile_size) {
+                for (uint32_t x = 0; x < width; x += tile_size) {
+                    image::Rect const tile{x, y, std::min(tile_size, width - x), std::min(tile_size, height - y)};
+                    if (tile.x < rect.right() && rect.x < tile.right() && tile.y < rect.bottom() && rect.y < tile.bottom()) {
+                        bytes += tile.area() * sizeof(Pixel);
+                    }
+                }
+            }
+            return bytes;
+        }
+    }
+
+    // undo and redo of History restore every state exactly, captures share the tiles an edit did not touch and
+    // the memory usage grows by the touched tiles only
+    inline void checkHistory(CheckLog& log) {
+        using namespace image;
+
+        // round trips through pixel edits, a resize and a change of the pixel format
+        {
+            AnyImage2D image;
+            image.resize(PixelFormat::BGRA8, 150, 100);
+            detail::fill(image, Rect{0, 0, 150, 100}, 1);
+            std::vector<AnyImage2D> states{image};
+            History history;
+            history.reset(image, "open");
+
+            image.clearDirtyRegion();
+            detail::fill(image, Rect{70, 20, 30, 50}, 2);
+            history.commit(image, "paint", &image.dirtyRegion());
+            states.push_back(image);
+
+            image.resize(PixelFormat::BGRA8, 200, 65);
+            detail::fill(image, Rect{0, 0, 200, 65}, 3);
+            history.commit(image, "resize", &image.dirtyRegion());
+            states.push_back(image);
+
+            image.resize(PixelFormat::RGBA16, 200, 65);
+            detail::fill(image, Rect{0, 0, 200, 65}, 3);
+            history.commit(image, "to rgba16");
+            states.push_back(image);
+
+            image.clearDirtyRegion();
+            detail::fill(image, Rect{190, 60, 10, 5}, 4);
+            history.commit(image, "paint corner", &image.dirtyRegion());
+            states.push_back(image);
+
+            auto round_trip = history.entries().size() == states.size() && history.current() == states.size() - 1;
+            for (auto i = states.size() - 1; i > 0; --i) {
+                round_trip = round_trip && history.undo(image) && detail::sameImage(image, states[i - 1]);
+            }
+            log.expect(round_trip && !history.canUndo() && !history.undo(image), "history/undo to the first state");
+            round_trip = true;
+            for (size_t i = 1; i < states.size(); ++i) {
+                round_trip = round_trip && history.redo(image) && detail::sameImage(image, states[i]);
+            }
+            log.expect(round_trip && !history.canRedo() && !history.redo(image), "history/redo to the last state");
+
+            history.undo(image);
+            history.undo(image);
+            image.clearDirtyRegion();
+            detail::fill(image, Rect{0, 0, 5, 5}, 5);
+            history.commit(image, "paint after undo", &image.dirtyRegion());
+            auto const edited = image;
+            log.expect(!history.canRedo() && history.entries().size() == 4 && history.entries().back().label == "paint after undo",
+                "history/commit drops the redo entries");
+            log.expect(history.undo(image) && detail::sameImage(image, states[2]) && history.redo(image) && detail::sameImage(image, edited),
+                "history/round trip after dropping redo entries");
+        }
+
+        // a capture with a changed region shares exactly the tiles the edit did not touch
+        {
+            using Snapshot = TiledSnapshot<PixelRGBA16>;
+            constexpr auto tile_size = Snapshot::tile_size;
+            AnyImage2D image;
+            image.resize(PixelFormat::RGBA16, 3 * tile_size + 10, 2 * tile_size + 7);
+            detail::fill(image, Rect{0, 0, image.width(), image.height()}, 6);
+            auto const& pixels = std::get<Image2D<PixelRGBA16>>(image.variant());
+            auto const first = Snapshot::capture(pixels, nullptr, nullptr);
+
+            // touches the tiles (1, 0), (2, 0), (1, 1) and (2, 1), the region also covers the last column without changing it
+            Rect const edit{tile_size + 5, tile_size - 3, tile_size, 6};
+            image.clearDirtyRegion();
+            detail::fill(image, edit, 7);
+            DirtyRegion changed = image.dirtyRegion();
+            changed.add(Rect{3 * tile_size, tile_size, 10, tile_size + 7});
+            auto const second = Snapshot::capture(pixels, &first, &changed);
+            auto exact = second.tiles().size() == first.tiles().size() && second.newTileCount() == 4;
+            for (uint32_t tile_y = 0; tile_y < 3; ++tile_y) {
+                for (uint32_t tile_x = 0; tile_x < 4; ++tile_x) {
+                    Rect const tile{tile_x * tile_size, tile_y * tile_size, tile_size, tile_size};
+                    auto const touched = tile.x < edit.right() && edit.x < tile.right() && tile.y < edit.bottom() && edit.y < tile.bottom();
+                    auto const index = static_cast<size_t>(tile_y) * 4 + tile_x;
+                    exact = exact && (second.tiles()[index] == first.tiles()[index]) != touched;
+                }
+            }
+            log.expect(exact, "history/capture shares the untouched tiles");
+            log.expect(second.difference(first).bounds().area() == 2u * tile_size * 2u * tile_size, "history/difference of the captures");
+
+            // restoring the first snapshot over the second copies back only the touched tiles
+            auto restored = pixels;
+            restored.clearDirtyRegion();
+            first.restore(restored, &second);
+            auto const original = Snapshot::capture(restored, &first, nullptr);
+            log.expect(original.newTileCount() == 0 && restored.dirtyRegion().bounds().area() == 2u * tile_size * 2u * tile_size,
+                "history/restore copies the differing tiles");
+        }
+
+        // the stored bytes grow by the tiles an edit touched, the dropped redo entries give theirs back
+        {
+            AnyImage2D image;
+            image.resize(PixelFormat::RGBA32F, 300, 130);
+            detail::fill(image, Rect{0, 0, 300, 130}, 8);
+            History history;
+            history.reset(image, "open");
+            auto const initial = history.memoryUsage();
+            log.expect(initial.stored_bytes == image.size() && initial.full_copy_bytes == image.size(), "history/initial state stored once");
+
+            Rect const edit{120, 60, 20, 10};
+            image.clearDirtyRegion();
+            detail::fill(image, edit, 9);
+            history.commit(image, "paint", &image.dirtyRegion());
+            auto const painted = history.memoryUsage();
+            auto const edit_bytes = detail::touchedTileBytes<PixelRGBA32F>(300, 130, edit);
+            log.expect(painted.stored_bytes == initial.stored_bytes + edit_bytes && painted.tile_count == initial.tile_count + 4
+                && painted.full_copy_bytes == 2 * image.size(), "history/stored bytes grow by the touched tiles");
+
+            // without a changed region every tile is compared, unchanged ones are still shared
+            Rect const corner{290, 125, 10, 5};
+            image.clearDirtyRegion();
+            detail::fill(image, corner, 10);
+            history.commit(image, "paint corner");
+            auto const cornered = history.memoryUsage();
+            log.expect(cornered.stored_bytes == painted.stored_bytes + detail::touchedTileBytes<PixelRGBA32F>(300, 130, corner),
+                "history/stored bytes grow by the compared tiles");
+
+            history.undo(image);
+            history.commit(image, "same again", &image.dirtyRegion());
+            log.expect(history.memoryUsage().stored_bytes == painted.stored_bytes, "history/dropped redo entries free their tiles");
+        }
+    }
+}
@@ -0,0 +1,408 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "image/AnyImage2D.hpp"
+
+// A PNG decoder for the sample images in samples/, so real sprites run through the jobs on every platform, not only
+// where WIC decodes them. Every color type and bit depth of non-interlaced images, with tRNS. 16 bit images give
+// RGBA16, all others BGRA8. Checksums are not verified, the samples are checked in and covered by golden hashes.
+namespace regress {
+    namespace detail {
+        // inflate of RFC 1951, canonical Huffman codes decoded bit by bit
+        class Inflater {
+        public:
+            explicit Inflater(std::span<uint8_t const> const input) : m_input(input) {}
+
+            [[nodiscard]] std::vector<uint8_t> run() {
+                for (auto last = false; !last;) {
+                    last = bits(1) != 0;
+                    switch (bits(2)) {
+                    case 0:
+                        stored();
+                        break;
+                    case 1:
+                        fixed();
+                        break;
+                    case 2:
+                        dynamic();
+                        break;
+                    default:
+                        throw std::runtime_error("invalid deflate block type");
+                    }
+                }
+                return std::move(m_output);
+            }
+
+        private:
+            struct Huffman {
+                std::array<uint16_t, 16> counts{}; // codes per length
+                std::vector<uint16_t> symbols; // ordered by code
+            };
+
+            uint32_t bits(uint32_t const count) {
+                auto value = m_bit_buffer;
+                while (m_bit_count < count) {
+                    if (m_position == m_input.size()) {
+                        throw std::runtime_error("truncated deflate stream");
+                    }
+                    value |= static_cast<uint32_t>(m_input[m_position++]) << m_bit_count;
+                    m_bit_count += 8;
+                }
+                m_bit_buffer = value >> count;
+                m_bit_count -= count;
+                return value & ((1u << count) - 1);
+            }
+
+            static Huffman build(std::span<uint8_t const> const lengths) {
+                Huffman huffman;
+                huffman.symbols.resize(lengths.size());
+                for (auto const length : lengths) {
+                    ++huffman.counts[length];
+                }
+                std::array<uint16_t, 16> offsets{};
+                for (size_t length = 1; length < 15; ++length) {
+                    offsets[length + 1] = static_cast<uint16_t>(offsets[length] + huffman.counts[length]);
+                }
+                for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+                    if (lengths[symbol] != 0) {
+                        huffman.symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+                    }
+                }
+                return huffman;
+            }
+
+            uint32_t decode(Huffman const& huffman) {
+                int32_t code{};
+                int32_t first{};
+                int32_t index{};
+                for (size_t length = 1; length < 16; ++length) {
+                    code |= static_cast<int32_t>(bits(1));
+                    auto const count = static_cast<int32_t>(huffman.counts[length]);
+                    if (code - count < first) {
+                        return huffman.symbols[static_cast<size_t>(index + code - first)];
+                    }
+                    index += count;
+                    first = (first + count) << 1;
+                    code <<= 1;
+                }
+                throw std::runtime_error("invalid Huffman code");
+            }
+
+            void stored() {
+                m_bit_buffer = 0;
+                m_bit_count = 0;
+                if (m_input.size() - m_position < 4) {
+                    throw std::runtime_error("truncated deflate stream");
+                }
+                auto const length = static_cast<size_t>(m_input[m_position] | m_input[m_position + 1] << 8);
+                m_position += 4;
+                if (m_input.size() - m_position < length) {
+                    throw std::runtime_error("truncated deflate stream");
+                }
+                m_output.insert(m_output.end(), m_input.begin() + static_cast<ptrdiff_t>(m_position),
+                    m_input.begin() + static_cast<ptrdiff_t>(m_position + length));
+                m_position += length;
+            }
+
+            void fixed() {
+                std::array<uint8_t, 288> lengths{};
+                std::fill(lengths.begin(), lengths.begin() + 144, uint8_t{8});
+                std::fill(lengths.begin() + 144, lengths.begin() + 256, uint8_t{9});
+                std::fill(lengths.begin() + 256, lengths.begin() + 280, uint8_t{7});
+                std::fill(lengths.begin() + 280, lengths.end(), uint8_t{8});
+                std::array<uint8_t, 30> distance_lengths{};
+                distance_lengths.fill(5);
+                codes(build(lengths), build(distance_lengths));
+            }
+
+            void dynamic() {
+                auto const length_count = bits(5) + 257;
+                auto const distance_count = bits(5) + 1;
+                auto const code_count = bits(4) + 4;
+                static constexpr uint8_t order[19]{16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+                std::array<uint8_t, 19> code_lengths{};
+                for (uint32_t i = 0; i < code_count; ++i) {
+                    code_lengths[order[i]] = static_cast<uint8_t>(bits(3));
+                }
+                auto const code_huffman = build(code_lengths);
+                std::vector<uint8_t> lengths(length_count + distance_count);
+                for (size_t i = 0; i < lengths.size();) {
+                    auto const symbol = decode(code_huffman);
+                    if (symbol < 16) {
+                        lengths[i++] = static_cast<uint8_t>(symbol);
+                        continue;
+                    }
+                    uint8_t repeated{};
+                    uint32_t repeat{};
+                    if (symbol == 16) {
+                        if (i == 0) {
+                            throw std::runtime_error("invalid deflate code lengths");
+                        }
+                        repeated = lengths[i - 1];
+                        repeat = 3 + bits(2);
+                    }
+                    else {
+                        repeat = symbol == 17 ? 3 + bits(3) : 11 + bits(7);
+                    }
+                    if (i + repeat > lengths.size()) {
+                        throw std::runtime_error("invalid deflate code lengths");
+                    }
+                    std::fill_n(lengths.begin() + static_cast<ptrdiff_t>(i), repeat, repeated);
+                    i += repeat;
+                }
+                codes(build(std::span{lengths}.first(length_count)), build(std::span{lengths}.subspan(length_count)));
+            }
+
+            void codes(Huffman const& lengths, Huffman const& distances) {
+                static constexpr uint16_t length_base[29]{
+                    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+                };
+                static constexpr uint8_t length_extra[29]{0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+                static constexpr uint16_t distance_base[30]{
+                    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                    8193, 12289, 16385, 24577,
+                };
+                static constexpr uint8_t distance_extra[30]{
+                    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+                };
+                for (;;) {
+                    auto symbol = decode(lengths);
+                    if (symbol < 256) {
+                        m_output.push_back(static_cast<uint8_t>(symbol));
+                        continue;
+                    }
+                    if (symbol == 256) {
+                        return;
+                    }
+                    symbol -= 257;
+                    if (symbol >= 29) {
+                        throw std::runtime_error("invalid deflate length");
+                    }
+                    auto const length = length_base[symbol] + bits(length_extra[symbol]);
+                    auto const distance_symbol = decode(distances);
+                    if (distance_symbol >= 30) {
+                        throw std::runtime_error("invalid deflate distance");
+                    }
+                    auto const distance = distance_base[distance_symbol] + bits(distance_extra[distance_symbol]);
+                    if (distance > m_output.size()) {
+                        throw std::runtime_error("deflate distance before the start of the output");
+                    }
+                    for (uint32_t i = 0; i < length; ++i) {
+                        m_output.push_back(m_output[m_output.size() - distance]);
+                    }
+                }
+            }
+
+            std::span<uint8_t const> m_input;
+            size_t m_position{};
+            uint32_t m_bit_buffer{};
+            uint32_t m_bit_count{};
+            std::vector<uint8_t> m_output;
+        };
+
+        [[nodiscard]] inline uint32_t readBigEndian(uint8_t const* const data) noexcept {
+            return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16 | static_cast<uint32_t>(data[2]) << 8 | data[3];
+        }
+
+        [[nodiscard]] inline uint8_t paeth(uint8_t const a, uint8_t const b, uint8_t const c) noexcept {
+            auto const p = a + b - c;
+            auto const pa = p > a ? p - a : a - p;
+            auto const pb = p > b ? p - b : b - p;
+            auto const pc = p > c ? p - c : c - p;
+            return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+        }
+    }
+
+    [[nodiscard]] inline image::AnyImage2D decodePng(std::span<uint8_t const> const file) {
+        static constexpr uint8_t signature[8]{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        if (file.size() < 8 || !std::equal(std::begin(signature), std::end(signature), file.begin())) {
+            throw std::runtime_error("not a PNG file");
+        }
+        uint32_t width{};
+        uint32_t height{};
+        uint32_t bit_depth{};
+        uint32_t color_type{};
+        std::vector<uint8_t> palette; // RGBA per entry
+        std::array<uint16_t, 3> color_key{};
+        auto has_color_key = false;
+        std::vector<uint8_t> compressed;
+        for (size_t position = 8; position + 12 <= file.size();) {
+            auto const length = detail::readBigEndian(&file[position]);
+            std::string const type(reinterpret_cast<char const*>(&file[position + 4]), 4);
+            if (file.size() - position - 12 < length) {
+                throw std::runtime_error("truncated PNG chunk " + type);
+            }
+            auto const data = file.subspan(position + 8, length);
+            position += 12 + static_cast<size_t>(length);
+            if (type == "IHDR" && length >= 13) {
+                width = detail::readBigEndian(&data[0]);
+                height = detail::readBigEndian(&data[4]);
+                bit_depth = data[8];
+                color_type = data[9];
+                if (data[12] != 0) {
+                    throw std::runtime_error("interlaced PNG files are not supported");
+                }
+            }
+            else if (type == "PLTE") {
+                for (size_t i = 0; i + 3 <= data.size(); i += 3) {
+                    palette.insert(palette.end(), {data[i], data[i + 1], data[i + 2], 255});
+                }
+            }
+            else if (type == "tRNS") {
+                if (color_type == 3) {
+                    for (size_t i = 0; i < data.size() && i * 4 < palette.size(); ++i) {
+                        palette[i * 4 + 3] = data[i];
+                    }
+                }
+                else {
+                    for (size_t i = 0; i < 3 && i * 2 + 1 < data.size(); ++i) {
+                        color_key[i] = static_cast<uint16_t>(data[i * 2] << 8 | data[i * 2 + 1]);
+                    }
+                    has_color_key = true;
+                }
+            }
+            else if (type == "IDAT") {
+                compressed.insert(compressed.end(), data.begin(), data.end());
+            }
+            else if (type == "IEND") {
+                break;
+            }
+        }
+        static constexpr uint32_t channels_of[7]{1, 0, 3, 1, 2, 0, 4};
+        auto const channels = color_type < 7 ? channels_of[color_type] : 0;
+        if (width == 0 || height == 0 || channels == 0 || (bit_depth != 16 && (bit_depth == 0 || 8 % bit_depth != 0))
+            || (color_type == 3 && (palette.empty() || bit_depth == 16)) || static_cast<uint64_t>(width) * height > (uint64_t{1} << 26)) {
+            throw std::runtime_error("unsupported PNG header");
+        }
+        if (compressed.size() < 2 || (compressed[0] & 0x0f) != 8 || (compressed[1] & 0x20) != 0) {
+            throw std::runtime_error("unsupported zlib stream");
+        }
+
+        // undo the row filters, bytes of the left neighbor are at least one byte back
+        auto const pixel_bytes = std::max<size_t>(1, channels * bit_depth / 8);
+        auto const row_bytes = (static_cast<size_t>(width) * channels * bit_depth + 7) / 8;
+        auto raw = detail::Inflater(std::span{compressed}.subspan(2)).run();
+        if (raw.size() < (row_bytes + 1) * height) {
+            throw std::runtime_error("truncated PNG image data");
+        }
+        std::vector<uint8_t> rows(row_bytes * height);
+        for (size_t y = 0; y < height; ++y) {
+            auto const filter = raw[y * (row_bytes + 1)];
+            auto const* const source = &raw[y * (row_bytes + 1) + 1];
+            auto* const row = &rows[y * row_bytes];
+            auto const* const above = y > 0 ? row - row_bytes : nullptr;
+            for (size_t i = 0; i < row_bytes; ++i) {
+                uint8_t const a = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+                uint8_t const b = above ? above[i] : 0;
+                uint8_t const c = above && i >= pixel_bytes ? above[i - pixel_bytes] : 0;
+                uint8_t predicted{};
+                switch (filter) {
+                case 0:
+                    break;
+                case 1:
+                    predicted = a;
+                    break;
+                case 2:
+                    predicted = b;
+                    break;
+                case 3:
+                    predicted = static_cast<uint8_t>((a + b) / 2);
+                    break;
+                case 4:
+                    predicted = detail::paeth(a, b, c);
+                    break;
+                default:
+                    throw std::runtime_error("invalid PNG row filter");
+                }
+                row[i] = static_cast<uint8_t>(source[i] + predicted);
+            }
+        }
+
+        // channel c of pixel x in row y at the file's bit depth
+        auto const sample = [&](uint32_t const x, uint32_t const y, uint32_t const c) -> uint32_t {
+            auto const* const row = &rows[static_cast<size_t>(y) * row_bytes];
+            if (bit_depth == 16) {
+                auto const offset = (static_cast<size_t>(x) * channels + c) * 2;
+                return static_cast<uint32_t>(row[offset] << 8 | row[offset + 1]);
+            }
+            auto const bit = (static_cast<size_t>(x) * channels + c) * bit_depth;
+            return (row[bit / 8] >> (8 - bit_depth - bit % 8)) & ((1u << bit_depth) - 1);
+        };
+        auto const rgba = [&](uint32_t const x, uint32_t const y) -> std::array<uint32_t, 4> {
+            auto const max = (1u << bit_depth) - 1;
+            switch (color_type) {
+            case 0: {
+                auto const gray = sample(x, y, 0);
+                return {gray, gray, gray, has_color_key && gray == color_key[0] ? 0 : max};
+            }
+            case 2: {
+                auto const r = sample(x, y, 0);
+                auto const g = sample(x, y, 1);
+                auto const b = sample(x, y, 2);
+                return {r, g, b, has_color_key && r == color_key[0] && g == color_key[1] && b == color_key[2] ? 0 : max};
+            }
+            case 3: {
+                auto const index = static_cast<size_t>(sample(x, y, 0)) * 4;
+                if (index >= palette.size()) {
+                    throw std::runtime_error("PNG palette index out of range");
+                }
+                return {palette[index], palette[index + 1], palette[index + 2], palette[index + 3]};
+            }
+            case 4:
+                return {sample(x, y, 0), sample(x, y, 0), sample(x, y, 0), sample(x, y, 1)};
+            default:
+                return {sample(x, y, 0), sample(x, y, 1), sample(x, y, 2), sample(x, y, 3)};
+            }
+        };
+
+        image::AnyImage2D result;
+        if (bit_depth == 16) {
+            image::Image2D<image::PixelRGBA16> pixels;
+            pixels.resize(width, height);
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    auto const [r, g, b, a] = rgba(x, y);
+                    pixels.pixel(x, y) = image::PixelRGBA16{static_cast<uint16_t>(r), static_cast<uint16_t>(g), static_cast<uint16_t>(b), static_cast<uint16_t>(a)};
+                }
+            }
+            result.variant() = std::move(pixels);
+        }
+        else {
+            // palette entries are 8 bit already, gray levels of low bit depths are scaled up
+            auto const scale = color_type == 3 ? 1u : 255u / ((1u << bit_depth) - 1);
+            image::Image2D<image::PixelBGRA8> pixels;
+            pixels.resize(width, height);
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    auto const [r, g, b, a] = rgba(x, y);
+                    pixels.pixel(x, y) = image::PixelBGRA8{
+                        static_cast<uint8_t>(b * scale), static_cast<uint8_t>(g * scale), static_cast<uint8_t>(r * scale), static_cast<uint8_t>(a * scale),
+                    };
+                }
+            }
+            result.variant() = std::move(pixels);
+        }
+        return result;
+    }
+
+    [[nodiscard]] inline image::AnyImage2D loadPng(std::string const& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("can't read " + path);
+        }
+        std::vector<uint8_t> const bytes{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        try {
+            return decodePng(bytes);
+        }
+        catch (std::runtime_error const& e) {
+            throw std::runtime_error(path + ": " + e.what());
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include "Protocol.hpp"
+#include "Checks.hpp"
+
+namespace regress {
+    // every request option and response field survives formatRequest/parseRequest and formatResponse/parseResponse,
+    // lines of older clients still parse
+    inline void checkProtocol(CheckLog& log) {
+        using namespace image;
+        ResourceLimits limit_sets[3]{};
+        limit_sets[1] = ResourceLimits{1000, 1u << 20, std::chrono::milliseconds{250}, 7, LimitAction::ConstantFill};
+        limit_sets[2] = ResourceLimits{0, 0, std::chrono::milliseconds{1}, 0, LimitAction::RadiusLimit};
+        for (auto const connectivity : {BleedingConnectivity::Eight, BleedingConnectivity::Four}) {
+            for (auto const tie_break : {BleedingTieBreak::FirstHit, BleedingTieBreak::Average, BleedingTieBreak::MaxAlpha}) {
+                for (auto const traversal : {
+                    BleedingTraversal::RowMajor, BleedingTraversal::Tiled, BleedingTraversal::Frontier, BleedingTraversal::JumpFlood,
+                }) {
+                    for (uint8_t corrections = 0; corrections <= 2; ++corrections) {
+                        for (auto const& limits : limit_sets) {
+                            protocol::Request request;
+                            request.input = "in put.png";
+                            request.output = "out.tiff";
+                            request.alpha_threshold = 0.25f;
+                            request.optimize_for_block_compression = corrections == 1;
+                            request.kernel = BleedingKernel{connectivity, tie_break, traversal, corrections};
+                            request.limits = limits;
+                            auto const line = protocol::formatRequest(request);
+                            auto const parsed = protocol::parseRequest(line);
+                            auto const expected_corrections = traversal == BleedingTraversal::JumpFlood
+                                ? corrections : BleedingKernel{}.jump_flood_corrections;
+                            log.expect(parsed
+                                && parsed->input == request.input && parsed->output == request.output
+                                && parsed->alpha_threshold == request.alpha_threshold
+                                && parsed->optimize_for_block_compression == request.optimize_for_block_compression
+                                && parsed->kernel.connectivity == connectivity
+                                && parsed->kernel.tie_break == tie_break
+                                && parsed->kernel.traversal == traversal
+                                && parsed->kernel.jump_flood_corrections == expected_corrections
+                                && parsed->limits.max_pixels == limits.max_pixels
+                                && parsed->limits.max_bytes == limits.max_bytes
+                                && parsed->limits.max_time == limits.max_time
+                                && parsed->limits.max_passes == limits.max_passes
+                                && parsed->limits.on_limit == limits.on_limit,
+                                "protocol/request round trip: " + line);
+                        }
+                    }
+                }
+            }
+        }
+
+        auto const kernel_only = protocol::parseRequest("bleed\ta.png\tb.png\t0\t0\t4\taverage\tfrontier");
+        log.expect(kernel_only && kernel_only->kernel.connectivity == BleedingConnectivity::Four
+            && kernel_only->kernel.tie_break == BleedingTieBreak::Average
+            && kernel_only->kernel.traversal == BleedingTraversal::Frontier
+            && kernel_only->limits.unlimited(), "protocol/request without limits");
+        auto const minimal = protocol::parseRequest("bleed\ta.png\tb.png\t0.5\t1");
+        log.expect(minimal && minimal->alpha_threshold == 0.5f && minimal->optimize_for_block_compression
+            && minimal->kernel.traversal == BleedingTraversal::RowMajor, "protocol/request without kernel");
+        log.expect(!protocol::parseRequest("bleed\ta\tb\t0\t0\t8\tfirst\trows\t1\t2\t-3\t4\tfill"), "protocol/negative time rejected");
+        log.expect(!protocol::parseRequest("bleed\ta\tb\t0\t0\t8\tfirst\trows\t1\t2\t3\t4\tstop"), "protocol/unknown action rejected");
+        log.expect(!protocol::parseRequest("bleed\ta\tb\t0\t0\t8\tfirst\trows+1"), "protocol/corrections only for jump flood");
+        log.expect(!protocol::parseRequest("bleed\ta\tb\t0\t0\t8\tfirst"), "protocol/field count");
+
+        protocol::Response response;
+        response.ok = true;
+        response.decode_us = 1;
+        response.bleed_us = 2;
+        response.encode_us = 3;
+        response.total_us = 6;
+        response.page_faults = 7;
+        response.scratch_reused = true;
+        response.scratch_reserved_bytes = 4096;
+        response.scratch_high_water_bytes = 2048;
+        response.skip = protocol::SkipReason::AlreadyBled;
+        response.frame_count = 3;
+        response.reused_frame_count = 2;
+        response.frame_bleed_us = {10, 20, 30};
+        response.limit = ResourceLimit::Passes;
+        auto const ok = protocol::parseResponse(protocol::formatResponse(response));
+        log.expect(ok && ok->ok && ok->decode_us == 1 && ok->bleed_us == 2 && ok->encode_us == 3 && ok->total_us == 6
+            && ok->page_faults == 7 && ok->scratch_reused && ok->scratch_reserved_bytes == 4096
+            && ok->scratch_high_water_bytes == 2048 && ok->skip == protocol::SkipReason::AlreadyBled
+            && ok->frame_count == 3 && ok->reused_frame_count == 2 && ok->frame_bleed_us == response.frame_bleed_us
+            && ok->limit == ResourceLimit::Passes, "protocol/ok response round trip");
+
+        protocol::Response error;
+        error.message = "too\tlarge";
+        error.limit = ResourceLimit::Pixels;
+        auto const aborted = protocol::parseResponse(protocol::formatResponse(error));
+        log.expect(aborted && !aborted->ok && aborted->message == "too large" && aborted->limit == ResourceLimit::Pixels,
+            "protocol/aborted response round trip");
+        auto const failed = protocol::parseResponse("error\tno such file");
+        log.expect(failed && !failed->ok && failed->limit == ResourceLimit::None, "protocol/error response without limit");
+    }
+}
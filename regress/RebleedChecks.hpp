@@ -0,0 +1,130 @@
+#pragma once
+#include <cstring>
+#include <execution>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "image/AnyImage2D.hpp"
+#include "Checks.hpp"
+#include "Corpus.hpp"
+
+namespace regress {
+    namespace detail {
+        // paints rect with random colors, roughly every third pixel opaque
+        inline void paint(image::AnyImage2D& frame, image::Rect const& rect, std::mt19937& rng) {
+            std::visit([&](auto& pixels) -> void {
+                for (uint32_t y = rect.y; y < rect.bottom(); ++y) {
+                    for (uint32_t x = rect.x; x < rect.right(); ++x) {
+                        auto const value = static_cast<uint32_t>(rng());
+                        setPixel(pixels.pixel(x, y), value & 0xffffff, value % 3 == 0 ? 255u : 0u);
+                    }
+                }
+            }, frame.variant());
+        }
+
+        // makes every opaque pixel transparent, returns their bounds
+        inline image::Rect removeOpaquePixels(image::AnyImage2D& frame, float const alpha_threshold) {
+            image::Rect bounds;
+            std::visit([&](auto& pixels) -> void {
+                using Traits = typename std::decay_t<decltype(pixels)>::Traits;
+                auto const cutoff = Traits::alphaCutoff(alpha_threshold);
+                for (uint32_t y = 0; y < pixels.height(); ++y) {
+                    for (uint32_t x = 0; x < pixels.width(); ++x) {
+                        if (isOpaque(pixels.pixel(x, y), cutoff)) {
+                            pixels.pixel(x, y).a = {};
+                            bounds = bounds.united(image::Rect{x, y, 1, 1});
+                        }
+                    }
+                }
+            }, frame.variant());
+            return bounds;
+        }
+
+        [[nodiscard]] inline bool samePixels(image::AnyImage2D const& a, image::AnyImage2D const& b) {
+            return a.size() == b.size() && std::memcmp(a.buffer<uint8_t>(), b.buffer<uint8_t>(), a.size()) == 0;
+        }
+
+        // entries of the exact traversals may name different sources at the same distance, e.g. for Average
+        [[nodiscard]] inline bool samePasses(
+            std::vector<uint32_t> const& a, std::vector<uint32_t> const& b, uint32_t const width, image::BleedingConnectivity const connectivity
+        ) {
+            for (size_t i = 0; i < a.size(); ++i) {
+                if ((a[i] == image::no_bleeding_source) != (b[i] == image::no_bleeding_source)) {
+                    return false;
+                }
+                if (a[i] == image::no_bleeding_source) {
+                    continue;
+                }
+                auto const distance = [&](uint32_t const origin) -> uint32_t {
+                    auto const x = static_cast<uint32_t>(i % width);
+                    auto const y = static_cast<uint32_t>(i / width);
+                    auto const dx = x > origin % width ? x - origin % width : origin % width - x;
+                    auto const dy = y > origin / width ? y - origin / width : origin / width - y;
+                    return connectivity == image::BleedingConnectivity::Eight ? std::max(dx, dy) : dx + dy;
+                };
+                if (distance(a[i]) != distance(b[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }
+
+    // rebleedPixels after random local edits gives the pixels and pass distances of a full bleed of the edited image,
+    // for every kernel. The edits start with removing every opaque pixel and adding one back.
+    inline void checkRebleed(CheckLog& log) {
+        using namespace image;
+        auto const corpus = generateCorpus();
+        std::for_each(std::execution::par, corpus.begin(), corpus.end(), [&](CorpusImage const& entry) -> void {
+            auto const& source = entry.frames.front();
+            auto const width = source.width();
+            auto const height = source.height();
+            for (auto const connectivity : {BleedingConnectivity::Eight, BleedingConnectivity::Four}) {
+                for (auto const tie_break : {BleedingTieBreak::FirstHit, BleedingTieBreak::Average, BleedingTieBreak::MaxAlpha}) {
+                    for (auto const traversal : {
+                        BleedingTraversal::RowMajor, BleedingTraversal::Tiled, BleedingTraversal::Frontier, BleedingTraversal::JumpFlood,
+                    }) {
+                        BleedingKernel const kernel{connectivity, tie_break, traversal};
+                        auto const name = "rebleed/" + entry.name + " " + std::to_string(static_cast<int>(connectivity)) + "-"
+                            + std::to_string(static_cast<int>(tie_break)) + "-" + std::to_string(static_cast<int>(traversal));
+                        std::mt19937 rng(40);
+                        auto frame = source;
+                        std::vector<uint32_t> map(static_cast<size_t>(width) * height);
+                        frame.doPixelBleeding(entry.alpha_threshold, kernel, {}, {}, {}, map);
+
+                        auto const edit = [&](std::string const& step, Rect const& rect, auto&& paint) -> void {
+                            paint(frame, rect);
+                            auto full = frame;
+                            std::vector<uint32_t> full_map(map.size());
+                            full.doPixelBleeding(entry.alpha_threshold, kernel, {}, {}, {}, full_map);
+                            frame.clearDirtyRegion();
+                            frame.rebleedPixels(rect, entry.alpha_threshold, kernel, map);
+                            log.expect(detail::samePixels(frame, full), name + " pixels after " + step);
+                            log.expect(detail::samePasses(map, full_map, width, connectivity), name + " map after " + step);
+                        };
+                        // a full bleed leaves an image without opaque pixels as it is, so the bled colors stay
+                        auto removed = frame;
+                        auto const opaque_bounds = detail::removeOpaquePixels(removed, entry.alpha_threshold);
+                        edit("removing every opaque pixel", opaque_bounds, [&](AnyImage2D& target, Rect const&) -> void {
+                            target = removed;
+                        });
+                        log.expect(std::ranges::all_of(map, [](uint32_t const origin) -> bool { return origin == no_bleeding_source; }),
+                            name + " map without opaque pixels");
+                        edit("adding an opaque pixel", Rect{width / 2, height / 2, 1, 1}, [&](AnyImage2D& target, Rect const& area) -> void {
+                            std::visit([&](auto& pixels) -> void { detail::setPixel(pixels.pixel(area.x, area.y), 0x102030u, 255u); }, target.variant());
+                        });
+                        for (int i = 0; i < 4; ++i) {
+                            auto const x = static_cast<uint32_t>(rng() % width);
+                            auto const y = static_cast<uint32_t>(rng() % height);
+                            Rect const rect{x, y, std::min<uint32_t>(1 + rng() % 12, width - x), std::min<uint32_t>(1 + rng() % 12, height - y)};
+                            edit("edit " + std::to_string(i), rect, [&](AnyImage2D& target, Rect const& area) -> void {
+                                detail::paint(target, area, rng);
+                            });
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
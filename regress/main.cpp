@@ -0,0 +1,769 @@
+// png_pixel_bleed_regress: output and performance regression runner for the bleed kernels
+//
+//   png_pixel_bleed_regress [--update-golden] [--update-baseline] [--check-baseline] [--tolerance <fraction>]
+//                           [--repeat <count>] [--filter <substring>] [--no-perf] [--data <directory>] [--jump-flood-report]
+//                           [--format-report] [--block-compression-report] [--kernel-report]
+//                           [--traversal-report]
+//
+// Every generated corpus image and every PNG in samples/ runs through every kernel variant, with and without the
+// block compression pass, through the core, the C API and, for animations, image::bleedFrames. Jobs run in
+// parallel, each output is hashed and compared with golden.txt. Then every job is timed on its own, best of --repeat runs, and the sums per
+// image and engine are compared with baseline.txt, a sum above baseline * (1 + tolerance) is reported as slower.
+// Exits with 1 on any mismatch, missing golden hash or failed self check. Timings depend on the machine, they only
+// fail the run with --check-baseline, on the machine that recorded baseline.txt. The --update options rewrite the
+// files from this run instead.
+// Limit jobs run images through image::bleedFrames with one resource limit each, their output and the limit
+// they report are compared, they are not timed.
+// Self checks of the parts without an output image of their own run after the jobs, --filter picks them by group name.
+// --format-report only times bleeding and the block compression pass of a generated 1024x1024 sprite sheet in
+// every pixel format.
+// --block-compression-report only encodes every bled single frame image and a sprite sheet with a stand-in BC3
+// color encoder, without and with the block compression pass: the block stats of the pass, the encoder's time,
+// its least squares refits and the RMSE of opaque texels.
+// --kernel-report only times every kernel variant on a generated 1024x1024 sprite sheet.
+// --traversal-report only times the traversals on a 1024x1024 and a 16384x64 sprite sheet and counts their
+// cache misses per pixel where Linux perf events are available, see CacheCounters.hpp.
+// --jump-flood-report only compares the jump flood with its correction passes against the exact traversals on every
+// single frame image: the share of pixels colored from an opaque pixel farther than the nearest, and the timings.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include "png_pixel_bleed.h"
+#include "image/FrameBleeding.hpp"
+#include "Corpus.hpp"
+#include "PngDecoder.hpp"
+#include "BlockEncoder.hpp"
+#include "CacheCounters.hpp"
+#include "Checks.hpp"
+#include "ProtocolChecks.hpp"
+#include "DirtyRegionChecks.hpp"
+#include "RebleedChecks.hpp"
+#include "HistoryChecks.hpp"
+#include "BleedingTaskChecks.hpp"
+#include "ApngChecks.hpp"
+
+namespace {
+    enum class Engine {
+        Core, // AnyImage2D::doPixelBleeding per frame
+        CApi, // ppb_bleed on a padded copy of every frame with caller scratch
+        Frames, // image::bleedFrames over all frames
+    };
+
+    struct Job {
+        std::string name;
+        regress::CorpusImage const* image{};
+        Engine engine{};
+        image::BleedingOptions options;
+        // Frames jobs with limits first check every frame like a decoder would, then bleed, they are not timed
+        image::ResourceLimits limits;
+        image::ResourceLimit expected_limit{image::ResourceLimit::None};
+        bool deterministic{true}; // false if the output depends on when max_time ran out, only the limit is compared
+        uint64_t hash{};
+        image::ResourceLimit limit{image::ResourceLimit::None};
+        double best_ms{};
+    };
+
+    // groups faster than this never count as regressions, their timings are mostly noise
+    constexpr double timing_floor_ms{5.0};
+
+    [[nodiscard]] std::string_view kernelName(image::BleedingKernel const& kernel) {
+        // the jump flood runs with its default corrections and ignores the tie break
+        static constexpr std::string_view names[2][3][4]{
+            {
+                {"8-first-rows", "8-first-tiles", "8-first-frontier", "8-jump-flood+1"},
+                {"8-average-rows", "8-average-tiles", "8-average-frontier", "8-jump-flood+1"},
+                {"8-max-alpha-rows", "8-max-alpha-tiles", "8-max-alpha-frontier", "8-jump-flood+1"},
+            },
+            {
+                {"4-first-rows", "4-first-tiles", "4-first-frontier", "4-jump-flood+1"},
+                {"4-average-rows", "4-average-tiles", "4-average-frontier", "4-jump-flood+1"},
+                {"4-max-alpha-rows", "4-max-alpha-tiles", "4-max-alpha-frontier", "4-jump-flood+1"},
+            },
+        };
+        return names[static_cast<int>(kernel.connectivity)][static_cast<int>(kernel.tie_break)][static_cast<int>(kernel.traversal)];
+    }
+
+    // FNV-1a over format, size and pixels of every frame
+    [[nodiscard]] uint64_t hashFrames(std::span<image::AnyImage2D const> const frames) {
+        uint64_t hash{0xcbf29ce484222325};
+        auto const add = [&](void const* data, size_t const size) -> void {
+            for (auto const byte : std::span{static_cast<uint8_t const*>(data), size}) {
+                hash = (hash ^ byte) * 0x100000001b3;
+            }
+        };
+        for (auto const& frame : frames) {
+            uint32_t const header[3]{static_cast<uint32_t>(frame.format()), frame.width(), frame.height()};
+            add(header, sizeof(header));
+            add(frame.buffer<uint8_t>(), frame.size());
+        }
+        return hash;
+    }
+
+    [[nodiscard]] ppb_pixel_format toPpbFormat(image::PixelFormat const format) {
+        switch (format) {
+        case image::PixelFormat::RGBA16:
+            return PPB_PIXEL_FORMAT_RGBA16;
+        case image::PixelFormat::RGBA32F:
+            return PPB_PIXEL_FORMAT_RGBA32F;
+        default:
+            return PPB_PIXEL_FORMAT_BGRA8;
+        }
+    }
+
+    // the C API bleeds a buffer with padded rows, the result is copied back tightly packed for hashing
+    void bleedThroughCApi(image::AnyImage2D& frame, image::BleedingOptions const& options) {
+        constexpr size_t padding{16};
+        auto const stride = static_cast<size_t>(frame.pitch()) + padding;
+        std::vector<uint8_t> buffer(stride * frame.height());
+        for (uint32_t y = 0; y < frame.height(); ++y) {
+            std::memcpy(buffer.data() + y * stride, frame.buffer<uint8_t>() + static_cast<size_t>(y) * frame.pitch(), frame.pitch());
+        }
+        ppb_image const target{buffer.data(), frame.width(), frame.height(), stride, toPpbFormat(frame.format())};
+        ppb_options ppb{};
+        ppb_default_options(&ppb);
+        ppb.alpha_threshold = options.alpha_threshold;
+        ppb.flags = (options.optimize_for_block_compression ? PPB_FLAG_OPTIMIZE_FOR_BLOCK_COMPRESSION : 0u)
+            | (options.kernel.traversal == image::BleedingTraversal::Tiled ? PPB_FLAG_TILED_TRAVERSAL : 0u)
+            | (options.kernel.traversal == image::BleedingTraversal::Frontier ? PPB_FLAG_FRONTIER_TRAVERSAL : 0u)
+            | (options.kernel.traversal == image::BleedingTraversal::JumpFlood ? PPB_FLAG_JUMP_FLOOD_TRAVERSAL : 0u);
+        ppb.connectivity = options.kernel.connectivity == image::BleedingConnectivity::Four ? PPB_CONNECTIVITY_4 : PPB_CONNECTIVITY_8;
+        ppb.tie_break = static_cast<ppb_tie_break>(options.kernel.tie_break);
+        // caller scratch of ppb_options_scratch_size, the jump flood takes its seeds from it instead of allocating
+        std::vector<uint64_t> scratch(ppb_options_scratch_size(frame.width(), frame.height(), &ppb) / sizeof(uint64_t));
+        if (auto const result = ppb_bleed(&target, &ppb, scratch.data(), scratch.size() * sizeof(uint64_t)); result != PPB_OK) {
+            throw std::runtime_error(ppb_result_string(result));
+        }
+        for (uint32_t y = 0; y < frame.height(); ++y) {
+            std::memcpy(frame.buffer<uint8_t>() + static_cast<size_t>(y) * frame.pitch(), buffer.data() + y * stride, frame.pitch());
+        }
+    }
+
+    // bleeds a fresh copy of the job's frames, returns the milliseconds spent in the engine, limit receives the
+    // limit the job ran into
+    double run(Job const& job, std::vector<image::AnyImage2D>& frames, image::ResourceLimit& limit) {
+        frames = job.image->frames;
+        auto const begin = std::chrono::steady_clock::now();
+        switch (job.engine) {
+        case Engine::Core:
+            for (auto& frame : frames) {
+                frame.doPixelBleeding(job.options.alpha_threshold, job.options.kernel, {});
+                if (job.options.optimize_for_block_compression) {
+                    frame.optimizeForBlockCompression(job.options.alpha_threshold);
+                }
+            }
+            break;
+        case Engine::CApi:
+            for (auto& frame : frames) {
+                bleedThroughCApi(frame, job.options);
+            }
+            break;
+        case Engine::Frames: {
+            image::ScratchArena arena;
+            try {
+                uint64_t used_bytes{};
+                for (auto const& frame : frames) {
+                    used_bytes = image::checkImageSize(job.limits, frame.width(), frame.height(), frame.pixelSize(), used_bytes);
+                }
+                for (auto const& report : image::bleedFrames(frames, job.options, arena, job.limits)) {
+                    limit = limit == image::ResourceLimit::None ? report.limit : limit;
+                }
+            }
+            catch (image::ResourceLimitError const& e) {
+                limit = e.limit();
+            }
+            break;
+        }
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    }
+
+    [[nodiscard]] std::vector<Job> makeJobs(std::vector<regress::CorpusImage> const& corpus, std::string_view const filter) {
+        std::vector<Job> jobs;
+        for (auto const& image : corpus) {
+            auto const engines = image.frames.size() > 1
+                ? std::vector<std::pair<Engine, std::string_view>>{{Engine::Core, "core"}, {Engine::Frames, "frames"}}
+                : std::vector<std::pair<Engine, std::string_view>>{{Engine::Core, "core"}, {Engine::CApi, "capi"}};
+            for (auto const& [engine, engine_name] : engines) {
+                for (int connectivity = 0; connectivity < 2; ++connectivity) {
+                    for (int tie_break = 0; tie_break < 3; ++tie_break) {
+                        for (int traversal = 0; traversal < 4; ++traversal) {
+                            if (static_cast<image::BleedingTraversal>(traversal) == image::BleedingTraversal::JumpFlood && tie_break != 0) {
+                                continue;
+                            }
+                            for (bool const block_compression : {false, true}) {
+                                image::BleedingKernel const kernel{
+                                    static_cast<image::BleedingConnectivity>(connectivity),
+                                    static_cast<image::BleedingTieBreak>(tie_break),
+                                    static_cast<image::BleedingTraversal>(traversal),
+                                };
+                                auto name = image.name + "/" + std::string(engine_name) + "/" + std::string(kernelName(kernel))
+                                    + (block_compression ? "+bc" : "");
+                                if (name.find(filter) == std::string::npos) {
+                                    continue;
+                                }
+                                jobs.push_back(Job{
+                                    std::move(name), &image, engine,
+                                    image::BleedingOptions{image.alpha_threshold, kernel, block_compression},
+                                    image::ResourceLimits{},
+                                });
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return jobs;
+    }
+
+    // the PNG files in samples/, real sprites next to the generated images, named after the file and the format it decodes to
+    [[nodiscard]] std::vector<regress::CorpusImage> loadSampleCorpus(std::string const& directory) {
+        std::vector<std::filesystem::path> paths;
+        for (auto const& entry : std::filesystem::directory_iterator(directory)) {
+            if (entry.path().extension() == ".png") {
+                paths.push_back(entry.path());
+            }
+        }
+        std::ranges::sort(paths);
+        std::vector<regress::CorpusImage> corpus;
+        for (auto const& path : paths) {
+            auto& entry = corpus.emplace_back();
+            entry.frames.push_back(regress::loadPng(path.string()));
+            entry.name = "sample-" + path.stem().string() + (entry.frames.front().format() == image::PixelFormat::RGBA16 ? "-rgba16" : "-bgra8");
+        }
+        return corpus;
+    }
+
+    // one image that takes seconds to bleed row by row, so a limit of 1 ms always runs out
+    [[nodiscard]] std::vector<regress::CorpusImage> generateLimitCorpus() {
+        image::Image2D<image::PixelBGRA8> pixels;
+        pixels.resize(1024, 1024);
+        for (uint32_t y = 0; y < pixels.height(); ++y) {
+            for (uint32_t x = 0; x < pixels.width(); ++x) {
+                pixels.pixel(x, y) = image::PixelBGRA8{static_cast<uint8_t>(x), static_cast<uint8_t>(y), 0x80, 0};
+            }
+        }
+        pixels.pixel(3, 5).a = 255;
+        std::vector<regress::CorpusImage> corpus(1);
+        corpus.front().name = "limits-time-bgra8";
+        corpus.front().frames.emplace_back().variant() = std::move(pixels);
+        return corpus;
+    }
+
+    // every limit with every action it supports, on a single frame and an animation
+    [[nodiscard]] std::vector<Job> makeLimitJobs(
+        std::vector<regress::CorpusImage> const& corpus, std::vector<regress::CorpusImage> const& limit_corpus, std::string_view const filter
+    ) {
+        using image::LimitAction;
+        using image::ResourceLimit;
+        using namespace std::chrono_literals;
+        std::vector<Job> jobs;
+        auto const add = [&](regress::CorpusImage const& image, std::string_view const name, image::BleedingTraversal const traversal,
+            image::ResourceLimits const& limits, ResourceLimit const expected, bool const deterministic = true) -> void {
+            auto job_name = image.name + "/limits/" + std::string(name);
+            if (job_name.find(filter) == std::string::npos) {
+                return;
+            }
+            jobs.push_back(Job{
+                std::move(job_name), &image, Engine::Frames,
+                image::BleedingOptions{image.alpha_threshold, image::BleedingKernel{.traversal = traversal}, false},
+                limits, expected, deterministic,
+            });
+        };
+        for (auto const& image : corpus) {
+            if (image.name != "sparse-dots-bgra8" && image.name != "animation-bgra8") {
+                continue;
+            }
+            auto const& frame = image.frames.front();
+            auto const pixel_count = static_cast<uint64_t>(frame.width()) * frame.height();
+            uint64_t frame_bytes{};
+            uint64_t row_major_bytes{};
+            for (auto const& each : image.frames) {
+                frame_bytes += each.size();
+                row_major_bytes += image::bleedingScratchWordCount(each.width(), each.height(), image::BleedingTraversal::RowMajor) * sizeof(uint64_t);
+            }
+            auto const rows = image::BleedingTraversal::RowMajor;
+            add(image, "pixels-abort", rows, {.max_pixels = pixel_count - 1}, ResourceLimit::Pixels);
+            add(image, "pixels-fit", rows, {.max_pixels = pixel_count}, ResourceLimit::None);
+            add(image, "decode-bytes-abort", rows, {.max_bytes = frame_bytes - 1}, ResourceLimit::Bytes);
+            // the tiled traversal gives way to the row-major one, same output
+            add(image, "bytes-row-major", image::BleedingTraversal::Tiled, {.max_bytes = frame_bytes + row_major_bytes}, ResourceLimit::None);
+            add(image, "bytes-abort", rows, {.max_bytes = frame_bytes + 1}, ResourceLimit::Bytes);
+            add(image, "bytes-fill", rows, {.max_bytes = frame_bytes + 1, .on_limit = LimitAction::ConstantFill}, ResourceLimit::Bytes);
+            // once one frame aborts the others stop wherever they are
+            add(image, "passes-abort", rows, {.max_passes = 3}, ResourceLimit::Passes, false);
+            for (auto const traversal : {rows, image::BleedingTraversal::Frontier, image::BleedingTraversal::JumpFlood}) {
+                image::BleedingKernel const kernel{.traversal = traversal};
+                add(image, "passes-radius-" + std::string(kernelName(kernel)), traversal,
+                    {.max_passes = 3, .on_limit = LimitAction::RadiusLimit}, ResourceLimit::Passes);
+                add(image, "passes-fill-" + std::string(kernelName(kernel)), traversal,
+                    {.max_passes = 3, .on_limit = LimitAction::ConstantFill}, ResourceLimit::Passes);
+            }
+        }
+        for (auto const& image : limit_corpus) {
+            auto const rows = image::BleedingTraversal::RowMajor;
+            add(image, "time-abort", rows, {.max_time = 1ms}, ResourceLimit::Time, false);
+            add(image, "time-radius", rows, {.max_time = 1ms, .on_limit = LimitAction::RadiusLimit}, ResourceLimit::Time, false);
+            // the fill recolors every transparent pixel, however far bleeding got
+            add(image, "time-fill", rows, {.max_time = 1ms, .on_limit = LimitAction::ConstantFill}, ResourceLimit::Time);
+        }
+        return jobs;
+    }
+
+    // lines of "name <tab> value", '#' starts a comment line
+    [[nodiscard]] std::map<std::string, std::string> readTable(std::string const& path) {
+        std::map<std::string, std::string> table;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            auto const tab = line.find('\t');
+            if (line.empty() || line.front() == '#' || tab == std::string::npos) {
+                continue;
+            }
+            table.emplace(line.substr(0, tab), line.substr(tab + 1));
+        }
+        return table;
+    }
+
+    void writeTable(std::string const& path, std::string_view const header, std::map<std::string, std::string> const& table) {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error("can't write " + path);
+        }
+        file << header;
+        for (auto const& [name, value] : table) {
+            file << name << '\t' << value << '\n';
+        }
+    }
+
+    [[nodiscard]] std::string hexHash(uint64_t const hash) {
+        char text[17]{};
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+        return text;
+    }
+
+    // milliseconds of the fastest of repeat bleeds of a copy of frame, source_map receives the origins if not empty
+    double timeBleed(
+        image::AnyImage2D const& frame, float const alpha_threshold, image::BleedingKernel const& kernel,
+        int const repeat, std::span<uint32_t> const source_map = {}
+    ) {
+        double best_ms{};
+        for (int i = 0; i < repeat; ++i) {
+            auto copy = frame;
+            auto const begin = std::chrono::steady_clock::now();
+            copy.doPixelBleeding(alpha_threshold, kernel, {}, {}, {}, source_map);
+            auto const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            best_ms = i == 0 ? ms : std::min(best_ms, ms);
+        }
+        return best_ms;
+    }
+
+    // milliseconds of the fastest of repeat calls of run
+    template <typename Run>
+    double bestMs(int const repeat, Run&& run) {
+        double best_ms{};
+        for (int i = 0; i < repeat; ++i) {
+            auto const begin = std::chrono::steady_clock::now();
+            run();
+            auto const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            best_ms = i == 0 ? ms : std::min(best_ms, ms);
+        }
+        return best_ms;
+    }
+
+    [[nodiscard]] double megapixelsPerSecond(image::AnyImage2D const& frame, double const ms) {
+        return ms > 0.0 ? static_cast<double>(frame.width()) * frame.height() / (ms * 1000.0) : 0.0;
+    }
+
+    void reportFormats(int const repeat) {
+        std::printf("%-8s %11s %9s %8s %9s %8s\n", "format", "size", "bleed ms", "MPix/s", "bc ms", "MPix/s");
+        for (auto const& [format, name] : {
+            std::pair{image::PixelFormat::BGRA8, "bgra8"}, std::pair{image::PixelFormat::RGBA16, "rgba16"},
+            std::pair{image::PixelFormat::RGBA32F, "rgba32f"},
+        }) {
+            auto const sheet = regress::generateSpriteSheet(format, 1024, 1024);
+            auto const bleed_ms = timeBleed(sheet, 0.0f, {}, repeat);
+            auto bled = sheet;
+            bled.doPixelBleeding();
+            auto const block_compression_ms = bestMs(repeat, [&]() -> void {
+                auto copy = bled;
+                copy.optimizeForBlockCompression();
+            });
+            auto const size = std::to_string(sheet.width()) + "x" + std::to_string(sheet.height());
+            std::printf("%-8s %11s %9.3f %8.1f %9.3f %8.1f\n", name, size.c_str(),
+                bleed_ms, megapixelsPerSecond(sheet, bleed_ms), block_compression_ms, megapixelsPerSecond(sheet, block_compression_ms));
+        }
+    }
+
+    // the traversals on a square and a wide sprite sheet of the same pixel count, with the cache misses of the fastest run
+    void reportTraversals(int const repeat) {
+        regress::CacheCounters counters;
+        std::printf("%-12s %-9s %9s %8s %12s %12s\n", "size", "traversal", "ms", "MPix/s", "L1D miss/px", "LLC miss/px");
+        for (auto const& [width, height] : {std::pair{1024u, 1024u}, std::pair{16384u, 64u}}) {
+            auto const sheet = regress::generateSpriteSheet(image::PixelFormat::BGRA8, width, height);
+            auto const pixel_count = static_cast<double>(width) * height;
+            auto const size = std::to_string(width) + "x" + std::to_string(height);
+            for (auto const& [traversal, name] : {
+                std::pair{image::BleedingTraversal::RowMajor, "rows"}, std::pair{image::BleedingTraversal::Tiled, "tiles"},
+                std::pair{image::BleedingTraversal::Frontier, "frontier"}, std::pair{image::BleedingTraversal::JumpFlood, "jump-flood"},
+            }) {
+                image::BleedingKernel const kernel{.traversal = traversal};
+                double best_ms{};
+                std::optional<regress::CacheMisses> best_misses;
+                for (int i = 0; i < repeat; ++i) {
+                    auto copy = sheet;
+                    counters.start();
+                    auto const begin = std::chrono::steady_clock::now();
+                    copy.doPixelBleeding(0.0f, kernel, {});
+                    auto const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                    auto const misses = counters.stop();
+                    if (i == 0 || ms < best_ms) {
+                        best_ms = ms;
+                        best_misses = misses;
+                    }
+                }
+                std::printf("%-12s %-9s %9.3f %8.1f", size.c_str(), name, best_ms, megapixelsPerSecond(sheet, best_ms));
+                if (best_misses) {
+                    std::printf(" %12.3f %12.3f\n",
+                        static_cast<double>(best_misses->l1d_read) / pixel_count, static_cast<double>(best_misses->last_level) / pixel_count);
+                }
+                else {
+                    std::printf(" %12s %12s\n", "n/a", "n/a");
+                }
+            }
+        }
+    }
+
+    // every compiled kernel variant on the same sprite sheet, --filter picks variants by name
+    void reportKernels(std::string_view const filter, int const repeat) {
+        auto const sheet = regress::generateSpriteSheet(image::PixelFormat::BGRA8, 1024, 1024);
+        std::printf("%-20s %9s %8s\n", "kernel", "ms", "MPix/s");
+        for (int connectivity = 0; connectivity < 2; ++connectivity) {
+            for (int traversal = 0; traversal < 4; ++traversal) {
+                for (int tie_break = 0; tie_break < 3; ++tie_break) {
+                    image::BleedingKernel const kernel{
+                        static_cast<image::BleedingConnectivity>(connectivity),
+                        static_cast<image::BleedingTieBreak>(tie_break),
+                        static_cast<image::BleedingTraversal>(traversal),
+                    };
+                    auto const name = kernelName(kernel);
+                    if ((kernel.traversal == image::BleedingTraversal::JumpFlood && tie_break != 0) || name.find(filter) == std::string_view::npos) {
+                        continue;
+                    }
+                    auto const ms = timeBleed(sheet, 0.0f, kernel, repeat);
+                    std::printf("%-20.*s %9.3f %8.1f\n", static_cast<int>(name.size()), name.data(), ms, megapixelsPerSecond(sheet, ms));
+                }
+            }
+        }
+    }
+
+    // every bled single frame image and a sprite sheet through the stand-in encoder, before and after the block
+    // compression pass, which is timed on its own
+    void reportBlockCompression(std::vector<regress::CorpusImage> const& corpus, std::string_view const filter, int const repeat) {
+        std::printf("%-22s %7s %7s %8s | %8s %7s %6s | %7s | %8s %7s %6s\n", "image", "blocks", "mixed", "adjusted",
+            "enc ms", "refits", "rmse", "bc ms", "enc ms", "refits", "rmse");
+        std::vector<regress::CorpusImage> images;
+        for (auto const& entry : corpus) {
+            if (entry.frames.size() == 1) {
+                images.push_back(entry);
+            }
+        }
+        images.push_back(regress::CorpusImage{"sprite-sheet-bgra8", 0.0f, {}});
+        images.back().frames.push_back(regress::generateSpriteSheet(image::PixelFormat::BGRA8, 1024, 1024));
+        for (auto const& entry : images) {
+            if (entry.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            auto bled = entry.frames.front();
+            bled.doPixelBleeding(entry.alpha_threshold);
+            regress::BlockEncoding plain;
+            auto const plain_ms = bestMs(repeat, [&]() -> void { plain = regress::encodeColorBlocks(bled, entry.alpha_threshold); });
+            auto optimized = bled;
+            auto const stats = optimized.optimizeForBlockCompression(entry.alpha_threshold);
+            auto const block_compression_ms = bestMs(repeat, [&]() -> void {
+                auto copy = bled;
+                copy.optimizeForBlockCompression(entry.alpha_threshold);
+            });
+            regress::BlockEncoding snapped;
+            auto const snapped_ms = bestMs(repeat, [&]() -> void { snapped = regress::encodeColorBlocks(optimized, entry.alpha_threshold); });
+            std::printf("%-22s %7u %7u %8u | %8.3f %7llu %6.3f | %7.3f | %8.3f %7llu %6.3f\n", entry.name.c_str(),
+                stats.block_count, stats.mixed_block_count, stats.adjusted_texel_count,
+                plain_ms, static_cast<unsigned long long>(plain.refit_count), plain.opaqueRmse(), block_compression_ms,
+                snapped_ms, static_cast<unsigned long long>(snapped.refit_count), snapped.opaqueRmse());
+        }
+    }
+
+    void reportJumpFlood(std::vector<regress::CorpusImage> const& corpus, std::string_view const filter, int const repeat) {
+        using image::BleedingTraversal;
+        std::printf("%-22s %4s %9s %9s %9s %8s %9s %8s %9s %8s\n",
+            "image", "conn", "rows ms", "front ms", "jfa ms", "farther", "jfa+1 ms", "farther", "jfa+2 ms", "farther");
+        for (auto const& entry : corpus) {
+            if (entry.frames.size() != 1 || entry.name.find(filter) == std::string::npos) {
+                continue;
+            }
+            auto const& frame = entry.frames.front();
+            auto const width = frame.width();
+            auto const pixel_count = static_cast<size_t>(width) * frame.height();
+            for (auto const connectivity : {image::BleedingConnectivity::Eight, image::BleedingConnectivity::Four}) {
+                // passes in the metric of the kernel, which every exact traversal reaches a pixel in
+                auto const passes = [&](uint32_t const index, uint32_t const origin) -> uint32_t {
+                    auto const dx = std::abs(static_cast<int64_t>(index % width) - static_cast<int64_t>(origin % width));
+                    auto const dy = std::abs(static_cast<int64_t>(index / width) - static_cast<int64_t>(origin / width));
+                    return static_cast<uint32_t>(connectivity == image::BleedingConnectivity::Eight ? std::max(dx, dy) : dx + dy);
+                };
+                std::vector<uint32_t> exact(pixel_count);
+                std::vector<uint32_t> approximate(pixel_count);
+                auto const rows_ms = timeBleed(frame, entry.alpha_threshold, {connectivity}, repeat);
+                auto const frontier_ms = timeBleed(
+                    frame, entry.alpha_threshold, {connectivity, {}, BleedingTraversal::Frontier}, repeat, exact
+                );
+                std::printf("%-22s %4s %9.3f %9.3f", entry.name.c_str(),
+                    connectivity == image::BleedingConnectivity::Eight ? "8" : "4", rows_ms, frontier_ms);
+                for (uint8_t corrections = 0; corrections <= 2; ++corrections) {
+                    auto const jump_flood_ms = timeBleed(
+                        frame, entry.alpha_threshold, {connectivity, {}, BleedingTraversal::JumpFlood, corrections}, repeat, approximate
+                    );
+                    size_t bled{};
+                    size_t farther{};
+                    for (uint32_t i = 0; i < pixel_count; ++i) {
+                        if (exact[i] == i || exact[i] == image::no_bleeding_source) {
+                            continue;
+                        }
+                        ++bled;
+                        farther += passes(i, approximate[i]) > passes(i, exact[i]) ? 1 : 0;
+                    }
+                    std::printf(" %9.3f %7.3f%%", jump_flood_ms, bled > 0 ? 100.0 * static_cast<double>(farther) / static_cast<double>(bled) : 0.0);
+                }
+                std::printf("\n");
+            }
+        }
+    }
+
+    int printUsage() {
+        std::fprintf(stderr,
+            "usage: png_pixel_bleed_regress [--update-golden] [--update-baseline] [--check-baseline] [--tolerance <fraction>]\n"
+            "                               [--repeat <count>] [--filter <substring>] [--no-perf] [--data <directory>] [--jump-flood-report]\n"
+            "                               [--format-report] [--block-compression-report] [--kernel-report]\n"
+            "                               [--traversal-report]\n"
+        );
+        return 2;
+    }
+}
+
+int main(int const argc, char const* const* const argv) {
+    bool update_golden{false};
+    bool update_baseline{false};
+    bool check_baseline{false};
+    bool measure{true};
+    bool jump_flood_report{false};
+    bool format_report{false};
+    bool block_compression_report{false};
+    bool kernel_report{false};
+    bool traversal_report{false};
+    double tolerance{0.25};
+    int repeat{5};
+    std::string filter;
+    std::string data_directory{REGRESS_DATA_DIR};
+    for (int i = 1; i < argc; ++i) {
+        std::string_view const arg{argv[i]};
+        if (arg == "--update-golden") {
+            update_golden = true;
+        }
+        else if (arg == "--update-baseline") {
+            update_baseline = true;
+        }
+        else if (arg == "--check-baseline") {
+            check_baseline = true;
+        }
+        else if (arg == "--no-perf") {
+            measure = false;
+        }
+        else if (arg == "--jump-flood-report") {
+            jump_flood_report = true;
+        }
+        else if (arg == "--format-report") {
+            format_report = true;
+        }
+        else if (arg == "--block-compression-report") {
+            block_compression_report = true;
+        }
+        else if (arg == "--kernel-report") {
+            kernel_report = true;
+        }
+        else if (arg == "--traversal-report") {
+            traversal_report = true;
+        }
+        else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::strtod(argv[++i], nullptr);
+        }
+        else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        }
+        else if (arg == "--data" && i + 1 < argc) {
+            data_directory = argv[++i];
+        }
+        else {
+            return printUsage();
+        }
+    }
+    auto const golden_path = data_directory + "/golden.txt";
+    auto const baseline_path = data_directory + "/baseline.txt";
+
+    try {
+        auto corpus = regress::generateCorpus();
+        std::ranges::move(loadSampleCorpus(data_directory + "/samples"), std::back_inserter(corpus));
+        if (jump_flood_report) {
+            reportJumpFlood(corpus, filter, repeat);
+            return 0;
+        }
+        if (format_report) {
+            reportFormats(repeat);
+            return 0;
+        }
+        if (block_compression_report) {
+            reportBlockCompression(corpus, filter, repeat);
+            return 0;
+        }
+        if (kernel_report) {
+            reportKernels(filter, repeat);
+            return 0;
+        }
+        if (traversal_report) {
+            reportTraversals(repeat);
+            return 0;
+        }
+        auto const limit_corpus = generateLimitCorpus();
+        auto jobs = makeJobs(corpus, filter);
+        auto limit_jobs = makeLimitJobs(corpus, limit_corpus, filter);
+        std::ranges::move(limit_jobs, std::back_inserter(jobs));
+
+        std::for_each(std::execution::par, jobs.begin(), jobs.end(), [](Job& job) -> void {
+            std::vector<image::AnyImage2D> frames;
+            run(job, frames, job.limit);
+            job.hash = hashFrames(frames);
+        });
+
+        int exit_code{0};
+        auto golden = readTable(golden_path);
+        size_t mismatches{};
+        for (auto const& job : jobs) {
+            if (job.limit != job.expected_limit) {
+                std::printf("LIMIT    %s expected %s, got %s\n", job.name.c_str(),
+                    std::string(image::resourceLimitName(job.expected_limit)).c_str(), std::string(image::resourceLimitName(job.limit)).c_str());
+                ++mismatches;
+            }
+            if (!job.deterministic) {
+                continue;
+            }
+            auto const hash = hexHash(job.hash);
+            if (update_golden) {
+                golden[job.name] = hash;
+                continue;
+            }
+            auto const expected = golden.find(job.name);
+            if (expected == golden.end()) {
+                std::printf("MISSING  %s %s\n", job.name.c_str(), hash.c_str());
+                ++mismatches;
+            }
+            else if (expected->second != hash) {
+                std::printf("MISMATCH %s expected %s, got %s\n", job.name.c_str(), expected->second.c_str(), hash.c_str());
+                ++mismatches;
+            }
+        }
+        if (update_golden) {
+            writeTable(golden_path, "# output hashes of png_pixel_bleed_regress, regenerate with --update-golden\n", golden);
+        }
+        std::printf("%zu jobs, %zu output mismatches\n", jobs.size(), mismatches);
+        exit_code |= mismatches > 0 ? 1 : 0;
+
+        regress::CheckLog checks;
+        auto const check = [&](std::string_view const group, auto&& run_checks) -> void {
+            if (group.find(filter) != std::string_view::npos) {
+                run_checks(checks);
+            }
+        };
+        check("protocol", regress::checkProtocol);
+        check("dirty", regress::checkDirtyRegion);
+        check("rebleed", regress::checkRebleed);
+        check("history", regress::checkHistory);
+        check("task", regress::checkBleedingTask);
+        check("apng", regress::checkApng);
+        std::printf("%zu checks, %zu failed\n", checks.count(), checks.failures());
+        exit_code |= checks.failures() > 0 ? 1 : 0;
+
+        if (measure) {
+            // single jobs take a few ms and jitter by more than any sensible tolerance,
+            // so timings are compared per group of all kernels of one image and engine
+            std::map<std::string, double> group_ms;
+            for (auto& job : jobs) {
+                if (!job.limits.unlimited()) {
+                    continue;
+                }
+                std::vector<image::AnyImage2D> frames;
+                image::ResourceLimit limit{};
+                job.best_ms = run(job, frames, limit);
+                for (int i = 1; i < repeat; ++i) {
+                    job.best_ms = std::min(job.best_ms, run(job, frames, limit));
+                }
+                group_ms[job.name.substr(0, job.name.rfind('/'))] += job.best_ms;
+            }
+            auto baseline = readTable(baseline_path);
+            size_t regressions{};
+            double total_ms{};
+            double baseline_total_ms{};
+            for (auto const& [group, ms] : group_ms) {
+                total_ms += ms;
+                if (update_baseline) {
+                    std::ostringstream value;
+                    value.precision(3);
+                    value << std::fixed << ms;
+                    baseline[group] = value.str();
+                    continue;
+                }
+                auto const expected = baseline.find(group);
+                if (expected == baseline.end()) {
+                    continue;
+                }
+                auto const expected_ms = std::strtod(expected->second.c_str(), nullptr);
+                baseline_total_ms += expected_ms;
+                if (ms > timing_floor_ms && ms > expected_ms * (1.0 + tolerance)) {
+                    std::printf("SLOWER   %s %.3f ms, baseline %.3f ms\n", group.c_str(), ms, expected_ms);
+                    ++regressions;
+                }
+            }
+            if (update_baseline) {
+                writeTable(baseline_path, "# ms per image and engine, sum of the best of --repeat runs of every kernel, regenerate with --update-baseline on the reference machine\n", baseline);
+            }
+            std::printf(
+                "%.1f ms total, baseline %.1f ms, %zu regressions beyond %.0f%%%s\n",
+                total_ms, baseline_total_ms, regressions, tolerance * 100.0, regressions > 0 && !check_baseline ? ", not failing the run without --check-baseline" : ""
+            );
+            if (check_baseline) {
+                exit_code |= regressions > 0 ? 1 : 0;
+            }
+        }
+        return exit_code;
+    }
+    catch (std::exception const& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}